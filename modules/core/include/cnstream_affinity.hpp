@@ -0,0 +1,109 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef CNSTREAM_AFFINITY_HPP_
+#define CNSTREAM_AFFINITY_HPP_
+
+/**
+ * @file cnstream_affinity.hpp
+ *
+ * This file contains functions to place threads and host memory on CPUs and NUMA nodes.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * Parses a CPU list string in the format of the Linux sysfs, for example "0-3,8,10-11".
+ *
+ * @return Returns the CPU indexes. Returns an empty vector if the string is invalid.
+ */
+std::vector<int> ParseCpuList(const std::string& cpu_list);
+
+/**
+ * Gets the number of NUMA nodes.
+ *
+ * @return Returns the number of NUMA nodes. Returns 1 if NUMA is not supported.
+ */
+int GetNumaNodeCount();
+
+/**
+ * Gets the CPUs of a NUMA node.
+ *
+ * @return Returns the CPU indexes of the node. Returns an empty vector if the node does not exist.
+ */
+std::vector<int> GetNumaNodeCpus(int node);
+
+/**
+ * Binds a thread to CPUs.
+ *
+ * @param cpus The CPU indexes.
+ * @param thread The thread to be bound, the calling thread by default.
+ *
+ * @return Returns true if this function has run successfully. Otherwise, returns false.
+ */
+bool SetThreadAffinity(const std::vector<int>& cpus, pthread_t thread = pthread_self());
+
+/**
+ * Sets the NUMA node on which the host memory allocated by the calling thread is placed.
+ *
+ * @param node The NUMA node. -1 means the memory is placed by the system, usually on the node of the CPU that
+ *             first touches it.
+ *
+ * @see CNStreamMallocHost.
+ */
+void SetThreadMemoryNode(int node);
+
+/**
+ * Gets the NUMA node on which the host memory allocated by the calling thread is placed.
+ *
+ * @return Returns the NUMA node. Returns -1 if it is not set.
+ */
+int GetThreadMemoryNode();
+
+/**
+ * Sets the preferred NUMA node of the pages of host memory, before they are touched.
+ *
+ * @param ptr The start address of the memory. It must be aligned to page size.
+ * @param size The size of the memory.
+ * @param node The NUMA node.
+ *
+ * @return Returns true if this function has run successfully. Otherwise, returns false.
+ */
+bool BindHostMemory(void* ptr, size_t size, int node);
+
+/**
+ * Gets the NUMA node of a stream for stream-to-socket placement, see Pipeline::SetStreamNumaPlacement.
+ *
+ * @param stream_idx The stream index.
+ *
+ * @return Returns the NUMA node of the stream.
+ */
+int GetStreamNumaNode(uint32_t stream_idx);
+
+}  // namespace cnstream
+
+#endif  // CNSTREAM_AFFINITY_HPP_
@@ -299,7 +299,10 @@ inline void SetThreadName(const std::string& name, pthread_t thread = invalid_pt
 
 /*pipeline capacities*/
 const size_t INVALID_MODULE_ID = (size_t)(-1);
+/* the maximum number of modules in a pipeline, module IDs are allocated per pipeline */
 uint32_t GetMaxModuleNumber();
+/* the maximum number of upstream modules of a module */
+const uint32_t MAX_UPSTREAM_MODULE_NUM = 64;
 
 const uint32_t INVALID_STREAM_IDX = (uint32_t)(-1);
 uint32_t GetMaxStreamNumber();
@@ -307,11 +310,29 @@ uint32_t GetMaxStreamNumber();
 /**
  * Limit the resource for each stream,
  * there will be no more than "parallelism" frames simultaneously.
+ * It is the default limit of the streams added to the source modules, see SourceModule::SetStreamParallelism.
  * Disabled by default.
  */
 void SetParallelism(int parallelism);
 int GetParallelism();
 
+/**
+ * The queue used by conveyors to buffer data between modules.
+ */
+enum ConveyorQueueType {
+  QUEUE_MUTEX = 0,  ///< std::queue guarded by a mutex and condition variable.
+  QUEUE_LOCKFREE,   ///< Bounded lock-free ring buffer.
+  QUEUE_FAIR,       ///< One queue per stream guarded by a mutex, served by deficit round-robin of the stream weights.
+};
+
+/**
+ * The way the streams are assigned to the input conveyors of a module.
+ */
+enum ConveyorAssignPolicy {
+  ASSIGN_BY_STREAM_INDEX = 0,  ///< A stream goes to the conveyor of index stream_index % parallelism.
+  ASSIGN_LEAST_LOADED,         ///< A new stream goes to the conveyor with the lowest recent load.
+};
+
 }  // namespace cnstream
 
 #endif  // CNSTREAM_COMMON_HPP_
@@ -30,6 +30,9 @@
 #include "opencv2/opencv.hpp"
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -55,7 +58,9 @@ typedef enum {
   CN_PIXEL_FORMAT_YUV420_NV21 = 0,  ///< This frame is in the YUV420SP(NV21) format.
   CN_PIXEL_FORMAT_YUV420_NV12,      ///< This frame is in the YUV420sp(NV12) format.
   CN_PIXEL_FORMAT_BGR24,            ///< This frame is in the BGR24 format.
-  CN_PIXEL_FORMAT_RGB24             ///< This frame is in the RGB24 format.
+  CN_PIXEL_FORMAT_RGB24,            ///< This frame is in the RGB24 format.
+  CN_PIXEL_FORMAT_YUV420P,          ///< This frame is in the YUV420P(I420) format, Y, U and V in three planes.
+  CN_PIXEL_FORMAT_GRAY8             ///< This frame is in the GRAY8 format, luma only.
 } CNDataFormat;
 
 /**
@@ -93,10 +98,13 @@ inline int CNGetPlanes(CNDataFormat fmt) {
   switch (fmt) {
     case CN_PIXEL_FORMAT_BGR24:
     case CN_PIXEL_FORMAT_RGB24:
+    case CN_PIXEL_FORMAT_GRAY8:
       return 1;
     case CN_PIXEL_FORMAT_YUV420_NV12:
     case CN_PIXEL_FORMAT_YUV420_NV21:
       return 2;
+    case CN_PIXEL_FORMAT_YUV420P:
+      return 3;
     default:
       return 0;
   }
@@ -104,7 +112,7 @@ inline int CNGetPlanes(CNDataFormat fmt) {
 }
 
 /**
- * Dedicated deallocator the CNDecoder buffer.
+ * Dedicated deallocator the decoder buffer (CNDecoder buffer or FFmpeg AVFrame buffer).
  */
 class IDataDeallocator {
  public:
@@ -198,9 +206,23 @@ struct CNDataFrame {
 
   /**
    * Syncronizes the source-data to CNSyncedMemory.
+   *
+   * @note When ``deAllocator_`` is set, the planes are referenced instead of copied. The buffers pointed by
+   * ``ptr_mlu`` (or ``ptr_cpu`` for DevContext::CPU) must stay valid until ``deAllocator_`` is released.
    */
   void CopyToSyncMem();
 
+  /**
+   * Allocates the memory of the planes on the device of ``ctx`` and sets up ``data`` on it, for the producers
+   * writing the planes by themselves instead of copying them by CopyToSyncMem(). The size of each plane is
+   * computed from ``fmt``, ``height`` and ``stride``.
+   *
+   * The planes are written through ``data[i]->GetMutableCpuData()`` or ``data[i]->GetMutableMluData()``.
+   * When the frame is recycled by the frame pool (see CNFrameInfo::Create), the memory and the synced memory
+   * of the previous frame are reused.
+   */
+  void AllocSyncMem();
+
  public:
   void* cpu_data = nullptr;  ///< CPU data pointer. You need to allocate it by calling CNStreamMallocHost().
   void* mlu_data = nullptr;  ///< A pointer to the MLU data.
@@ -225,18 +247,49 @@ struct CNDataFrame {
    * The below methods and members are used by the framework.
    */
   friend class Pipeline;
-  uint64_t SetModuleMask(Module* module, Module* current);  // return changed mask
+  friend class PipelinePrivate;
+  friend struct CNFrameInfo;
+  /* releases the data of the frame and keeps the reusable storage, used when the frame is recycled */
+  void Reset();
+  /*
+    hands the memory of the frame over to the planes referenced elsewhere, so that it is released by the last owner
+    instead of being freed or reused with the frame, returns false if no plane is referenced elsewhere
+   */
+  bool HandOverSharedPlanes();
+  /* allocates the masks for the modules of a pipeline, called once when the frame enters the pipeline */
+  void InitModuleMasks(size_t module_num);
+  bool HasModuleMasks() const { return 0 != module_num_; }
+  /* marks the data processed by the upstream module of parent_mask (see Module::GetParentMask), returns the mask */
+  uint64_t SetModuleMask(Module* module, uint64_t parent_mask);
   uint64_t GetModulesMask(Module* module);
   void ClearModuleMask(Module* module);
-  uint64_t AddEOSMask(Module* module);
+  /* returns true if the frame has been received by all modules of the pipeline with this call */
+  bool AddEOSMask(Module* module);
 
  private:
-  CNSpinLock mask_lock_;
-  /*The mask map of the module. It identifies which modules the data can already be processed by.*/
-  std::map<unsigned int, uint64_t> module_mask_map_;
-
-  CNSpinLock eos_lock_;
-  uint64_t eos_mask = 0;
+  /*
+    The masks of the modules, indexed by module ID. The mask of a module identifies which of its upstream modules
+    the data has already been processed by, see Module::GetParentMask. They are followed by the EOS bitset of all
+    modules, indexed by module ID.
+   */
+  std::unique_ptr<std::atomic<uint64_t>[]> module_masks_;
+  size_t module_masks_capacity_ = 0;
+  size_t module_num_ = 0;
+  std::atomic<size_t> eos_num_{0};
+  /*
+    The storage kept by Reset for the next frame: the host and MLU buffers allocated by AllocSyncMem and the
+    synced memory helpers that are not referenced elsewhere.
+   */
+  void* cached_cpu_data_ = nullptr;
+  size_t cached_cpu_bytes_ = 0;
+  size_t cpu_data_bytes_ = 0;
+  void* cached_mlu_data_ = nullptr;
+  DevContext cached_mlu_ctx_;
+  size_t cached_mlu_bytes_ = 0;
+  size_t mlu_data_bytes_ = 0;
+  void ReleaseCachedMluData();
+  std::shared_ptr<CNSyncedMemory> cached_data_[CN_MAX_PLANES];
+  std::shared_ptr<CNSyncedMemory> AcquireSyncedMemory(int plane_idx, size_t size, int dev_id = 0, int ddr_chn = 0);
 };  // struct CNDataFrame
 
 /**
@@ -375,6 +428,8 @@ struct CNInferObject {
   std::mutex feature_mutex_;
 };
 
+class CNStreamAdmission;
+
 /**
  *  A structure holding the information of a frame.
  */
@@ -382,6 +437,8 @@ struct CNFrameInfo {
   /**
    * Creates a CNFrameInfo instance.
    *
+   * The number of frames created by this function is not limited, see the overload taking a CNStreamAdmission.
+   *
    * @param stream_id The data stream alias. Identifies which data stream the frame data comes from.
    * @param eos If true, CNDataFrame::flags will be set to ``CN_FRAME_FLAG_EOS``. Then, the modules
    *            do not have permission to process this frame. This frame should be handed over to the pipeline
@@ -390,21 +447,196 @@ struct CNFrameInfo {
    * @return Returns ``shared_ptr`` of ``CNFrameInfo`` if this function has run successfully. Otherwise, returns NULL.
    */
   static std::shared_ptr<CNFrameInfo> Create(const std::string& stream_id, bool eos = false);
+  /**
+   * Creates a CNFrameInfo instance admitted by the admission of its stream.
+   *
+   * The frame takes a slot of the admission until it is released, and is drawn from the frame pool of the admission.
+   *
+   * @param stream_id The data stream alias. Identifies which data stream the frame data comes from.
+   * @param admission The admission of the stream.
+   * @param block If true, waits for a slot when the frames of the stream in flight reach the limit. Otherwise,
+   *              returns NULL at once.
+   *
+   * @return Returns ``shared_ptr`` of ``CNFrameInfo`` if this function has run successfully. Otherwise, returns NULL.
+   */
+  static std::shared_ptr<CNFrameInfo> Create(const std::string& stream_id,
+                                             const std::shared_ptr<CNStreamAdmission>& admission, bool block = true);
   uint32_t channel_idx = INVALID_STREAM_IDX;              ///< The index of the channel, stream_index
   CNDataFrame frame;                                      ///< The data of the frame.
   ThreadSafeVector<std::shared_ptr<CNInferObject>> objs;  ///< Structured information of the objects for this frame.
+  /**
+   * The scaled renditions of ``frame`` by name, e.g. a small one for the analytics and ``frame`` for recording.
+   * They are filled by the source module before the frame is sent, and are read-only for the other modules.
+   */
+  std::map<std::string, std::shared_ptr<CNDataFrame>> renditions;
   ~CNFrameInfo();
 
+  /**
+   * Gets a rendition of the frame by name.
+   *
+   * The modules converting or resizing the image anyway, e.g. to display it or to preprocess it for a model, select
+   * a small rendition to save the work on the full-resolution frame.
+   *
+   * @param name The name of the rendition. The empty name selects ``frame``.
+   *
+   * @return Returns the rendition named ``name``. Returns ``frame`` if the frame has no such rendition, so that the
+   *         modules selecting a rendition also work with the sources not producing it. The first misses are logged
+   *         as warnings, as a misspelled name also falls back to ``frame``.
+   */
+  CNDataFrame* GetRendition(const std::string& name);
+  /**
+   * Gets the scheduling weight of the stream of the frame, see CNStreamAdmission::SetWeight.
+   *
+   * @return Returns the weight of the stream. Returns 1 if the frame is not created with an admission.
+   */
+  uint32_t GetStreamWeight() const;
+  /**
+   * Gets the time the frame was created by CNFrameInfo::Create(), on the steady clock. The age of the frame is
+   * counted from it, see Pipeline::SetMaxFrameAge.
+   *
+   * @return Returns the creation time of the frame.
+   */
+  std::chrono::steady_clock::time_point GetCreateTime() const { return create_time_; }
+
  private:
+  friend class CNFrameInfoPool;
+  friend class CNFrameInfoPoolPrivate;
   CNFrameInfo() {}
   DISABLE_COPY_AND_ASSIGN(CNFrameInfo);
-  static cnstream::CNSpinLock spinlock_;
-  static std::map<std::string, int> stream_count_map_;
+  /* prepares the frame to be reused by the frame pool */
+  void Reset();
+  std::shared_ptr<CNStreamAdmission> admission_ = nullptr;
+  std::chrono::steady_clock::time_point create_time_;
 
  public:
   static int parallelism_;
 };
 
+class CNFrameInfoPoolPrivate;
+
+/**
+ * A pool of CNFrameInfo instances.
+ *
+ * The frames acquired from the pool are reset and given back to the pool when the last ``shared_ptr`` referring to
+ * them is released, so that the frame, the buffers allocated by CNDataFrame::AllocSyncMem() (also called by
+ * CNDataFrame::CopyToSyncMem()) and the synced memory helpers are reused by the following frames. At most
+ * ``capacity`` idle frames are kept, the others are deleted. The pool can be released while its frames are still in
+ * use.
+ */
+class CNFrameInfoPool {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param capacity The maximum number of idle frames kept by the pool. It is usually the limit of the frames in
+   *                 flight of a stream, see CNStreamAdmission.
+   */
+  explicit CNFrameInfoPool(size_t capacity);
+  /**
+   * Destructor. The frames in use are deleted when they are released.
+   */
+  ~CNFrameInfoPool();
+  /**
+   * Gets a frame from the pool, or allocates one if the pool is empty.
+   *
+   * @return Returns the frame, or nullptr if the allocation failed.
+   */
+  std::shared_ptr<CNFrameInfo> Acquire();
+  /**
+   * @return Returns the maximum number of idle frames kept by the pool.
+   */
+  size_t GetCapacity() const;
+  /**
+   * @return Returns the number of idle frames in the pool.
+   */
+  size_t GetIdleNumber() const;
+  /**
+   * @return Returns the number of frames acquired from the idle frames.
+   */
+  uint64_t GetHitCount() const;
+  /**
+   * @return Returns the number of frames allocated because the pool was empty.
+   */
+  uint64_t GetMissCount() const;
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(CNFrameInfoPool);
+  std::shared_ptr<CNFrameInfoPoolPrivate> d_ptr_;
+};  // class CNFrameInfoPool
+
+/**
+ * The admission of the frames of a stream.
+ *
+ * Limits the number of frames of a stream in flight, that is, created by CNFrameInfo::Create() and not released yet,
+ * and keeps the frame pool of the stream. The source module creates one for each stream when the stream is added.
+ */
+class CNStreamAdmission {
+ public:
+  /**
+   * Constructor.
+   *
+   * @param limit The maximum number of frames in flight. The frames are not limited if it is less than or equal to 0.
+   */
+  explicit CNStreamAdmission(int limit);
+  /**
+   * Sets the maximum number of frames in flight. It can be changed while the frames are in flight.
+   *
+   * @param limit The maximum number of frames in flight. The frames are not limited if it is less than or equal to 0.
+   */
+  void SetLimit(int limit);
+  /**
+   * @return Returns the maximum number of frames in flight.
+   */
+  int GetLimit() const { return limit_.load(std::memory_order_relaxed); }
+  /**
+   * @return Returns the number of frames in flight.
+   */
+  int GetInflightNumber() const { return inflight_.load(std::memory_order_relaxed); }
+  /**
+   * Sets the scheduling weight of the stream. The input queues of type QUEUE_FAIR give each stream as many turns
+   * as its weight, relative to the other streams. It can be changed while the frames are in flight.
+   *
+   * @param weight The weight of the stream. 0 is taken as 1.
+   */
+  void SetWeight(uint32_t weight) { weight_.store(weight ? weight : 1, std::memory_order_relaxed); }
+  /**
+   * @return Returns the scheduling weight of the stream, 1 by default.
+   */
+  uint32_t GetWeight() const { return weight_.load(std::memory_order_relaxed); }
+  /**
+   * Takes a slot for a frame.
+   *
+   * @param block If true, waits until a slot is released or the admission is closed.
+   *
+   * @return Returns true if a slot is taken. Otherwise, returns false.
+   */
+  bool Acquire(bool block);
+  /**
+   * Gives back a slot taken by Acquire().
+   */
+  void Release();
+  /**
+   * Closes the admission. The callers waiting in Acquire() are woken up, and Acquire() fails afterwards.
+   */
+  void Close();
+  /**
+   * @return Returns the frame pool of the stream.
+   */
+  CNFrameInfoPool* GetPool() { return &pool_; }
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(CNStreamAdmission);
+  bool TryAcquire();
+  std::atomic<int> limit_;
+  std::atomic<uint32_t> weight_{1};
+  std::atomic<int> inflight_{0};
+  std::atomic<int> waiters_{0};
+  std::atomic<bool> closed_{false};
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  CNFrameInfoPool pool_;
+};  // class CNStreamAdmission
+
 }  // namespace cnstream
 
 #endif  // CNSTREAM_FRAME_HPP_
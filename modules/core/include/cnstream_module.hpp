@@ -31,6 +31,7 @@
 #include <cxxabi.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <list>
@@ -174,8 +175,8 @@ class Module {
    * @param name The name of a module. Modules defined in a pipeline should
    *             have different names.
    */
-  explicit Module(const std::string &name) : name_(name) { this->GetId(); }
-  virtual ~Module() { this->ReturnId(); }
+  explicit Module(const std::string &name) : name_(name) {}
+  virtual ~Module() {}
 
   /**
    * Opens resources for a module.
@@ -215,6 +216,24 @@ class Module {
    */
   virtual int Process(std::shared_ptr<CNFrameInfo> data) = 0;
 
+  /**
+   * Processes a batch of data.
+   *
+   * The pipeline calls this function instead of ``Process`` when the module is configured with a maximum batch size
+   * greater than 1 (see Pipeline::SetModuleBatchAttribute). The data in a batch are in the order they are received,
+   * and EOS data never appear in a batch, they are still passed to ``Process`` one by one.
+   * The default implementation calls ``Process`` for each data. Modules that could amortize the cost of processing,
+   * e.g., setup and locks, over several data could override it.
+   *
+   * @param data The data to be processed by the module. The data must not be removed from the vector if 0 is returned.
+   *
+   * @retval 0: The data are processed successfully. But the data should be transmitted in framework then.
+   * @retval >0: The data are processed successfully. The data have been handled by this module.
+   *             The ``hasTransmit_`` must be set.
+   * @retval <0: Pipeline will post an event with the EVENT_ERROR event type and return number.
+   */
+  virtual int ProcessBatch(std::vector<std::shared_ptr<CNFrameInfo>> &data);
+
   /**
    * Gets the name of this module.
    *
@@ -249,6 +268,49 @@ class Module {
    */
   bool TransmitData(std::shared_ptr<CNFrameInfo> data);
 
+  /**
+   * @brief Sets the CPU affinity and the NUMA node of the threads processing this module.
+   *
+   * @param cpus The CPUs the threads of this module are bound to. If it is empty, the threads are bound to
+   *             the CPUs of ``numa_node``.
+   * @param numa_node The NUMA node the threads of this module and the host memory they allocate are placed on.
+   *                  -1 means no NUMA placement.
+   *
+   * @return Void.
+   *
+   * @note It takes effect when the pipeline is started next time.
+   *
+   * @see Pipeline::SetStreamNumaPlacement
+   */
+  void SetAffinity(const std::vector<int> &cpus, int numa_node = -1);
+
+  /**
+   * @return Returns the CPUs the threads of this module are bound to.
+   */
+  std::vector<int> GetCpuAffinity() const { return cpu_affinity_; }
+
+  /**
+   * @return Returns the NUMA node the threads of this module are placed on. Returns -1 if it is not set.
+   */
+  int GetNumaNode() const { return numa_node_; }
+
+  /**
+   * @brief Binds the calling thread according to the affinity of this module.
+   *
+   * CPUs set by ``SetAffinity`` take precedence. Otherwise, if stream-to-socket placement is enabled for the pipeline
+   * of this module (see Pipeline::SetStreamNumaPlacement) and ``stream_idx`` is valid, the thread is bound to the
+   * NUMA node of the stream. Otherwise, the thread is bound to the NUMA node set by ``SetAffinity``. Host memory
+   * allocated by the thread is placed on the same node.
+   *
+   * @param stream_idx The index of the stream processed by the calling thread.
+   *
+   * @return Returns true if the thread is bound. Returns false if there is nothing to bind or binding fails.
+   *
+   * @note It is called by pipeline in module threads. Modules creating threads by themselves, e.g., source
+   *       modules, could call it in those threads.
+   */
+  bool BindThread(uint32_t stream_idx = INVALID_STREAM_IDX) const;
+
   /**
    * @brief Checks parameters for a module, including parameter name, type, value, validity, and so on.
    *
@@ -277,15 +339,22 @@ class Module {
    */
   inline void SetContainer(Pipeline *container) { container_ = container; }
 
-  /* useless for users */
-  size_t GetId();
+  /* useless for users, the ID is allocated by the pipeline the module is added to */
+  size_t GetId() const { return id_; }
   /* useless for users */
   std::vector<size_t> GetParentIds() const { return parent_ids_; }
   /* useless for users, set upstream node ID to this module */
   void SetParentId(size_t id) {
+    if (std::find(parent_ids_.begin(), parent_ids_.end(), id) != parent_ids_.end()) return;
     parent_ids_.push_back(id);
-    mask_ = 0;
-    for (auto &v : parent_ids_) mask_ |= (uint64_t)1 << v;
+    mask_ = parent_ids_.size() >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << parent_ids_.size()) - 1;
+  }
+  /* useless for users, the bit of the upstream node in the masks, 0 if it is not an upstream node */
+  uint64_t GetParentMask(size_t id) const {
+    for (size_t i = 0; i < parent_ids_.size(); ++i) {
+      if (parent_ids_[i] == id) return (uint64_t)1 << i;
+    }
+    return 0;
   }
 
   /* useless for users */
@@ -317,6 +386,19 @@ class Module {
    */
   int DoProcess(std::shared_ptr<CNFrameInfo> data);
 
+  /**
+   * @brief Processes a batch of data.
+   *
+   * This function is called by pipeline.
+   *
+   * @param data The data to be processed.
+   *
+   * @return The return value of ``ProcessBatch``.
+   *
+   * @see DoProcess
+   */
+  int DoProcessBatch(std::vector<std::shared_ptr<CNFrameInfo>> &data);
+
   /**
    * @return Returns true if the performance information is displayed. Otherwise, returns false.
    */
@@ -337,15 +419,15 @@ class Module {
   std::atomic<bool> isSource_{false};     ///< If it is a source module.
 
  private:
-  void ReturnId();
-  size_t id_ = -1;
-  /* supports no more than 64 modules */
-  static CNSpinLock module_id_spinlock_;
-  static uint64_t module_id_mask_;
+  void SetId(size_t id) { id_ = id; }
+  size_t id_ = INVALID_MODULE_ID;
 
   std::vector<size_t> parent_ids_;
   uint64_t mask_ = 0;
 
+  std::vector<int> cpu_affinity_;
+  int numa_node_ = -1;
+
  protected:
   StreamFpsStat fps_stat_;
   std::atomic<bool> showPerfInfo_{false};
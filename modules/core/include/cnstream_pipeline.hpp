@@ -29,6 +29,7 @@
 
 #include <atomic>
 #include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -101,6 +102,18 @@ class PipelinePrivate;
 struct LinkStatus {
   bool stopped;                      ///< Whether the data transmissions between the modules are stopped.
   std::vector<uint32_t> cache_size;  ///< The size of each queue that is used to cache data between modules.
+  std::vector<uint64_t> push_blocked_time;   ///< The time in microseconds spent waiting for each full queue.
+  std::vector<uint64_t> pop_blocked_time;    ///< The time in microseconds spent waiting for each empty queue.
+  std::vector<uint64_t> push_timeout_count;  ///< The number of data dropped because pushing to each queue timed out.
+  std::vector<uint64_t> process_time;        ///< The time in microseconds spent processing the data of each queue.
+};
+
+/**
+ * The way a pipeline runs the modules.
+ */
+enum PipelineExecutorType {
+  EXECUTOR_THREAD_PER_CONVEYOR = 0,  ///< Each input conveyor of each module is processed by its own thread.
+  EXECUTOR_WORK_STEALING,            ///< Input conveyors are processed by a shared work-stealing thread pool.
 };
 
 /**
@@ -118,6 +131,14 @@ struct LinkStatus {
  *   }
  *  "parallelism(CNModuleConfig::parallelism)": 3,
  *  "max_input_queue_size(CNModuleConfig::maxInputQueueSize)": 20,
+ *  "input_queue_type(CNModuleConfig::inputQueueType)": "mutex",
+ *  "input_queue_block_timeout_ms(CNModuleConfig::inputQueueBlockTimeout)": 0,
+ *  "cpu_affinity(CNModuleConfig::cpuAffinity)": [0, 1, 2, 3],
+ *  "numa_node(CNModuleConfig::numaNode)": 0,
+ *  "max_batch(CNModuleConfig::maxBatch)": 1,
+ *  "max_wait_us(CNModuleConfig::maxWaitUs)": 0,
+ *  "enable_fusion(CNModuleConfig::enableFusion)": true,
+ *  "frame_parallel(CNModuleConfig::frameParallel)": false,
  *  "class_name(CNModuleConfig::className)": "Inferencer",
  *  "next_modules": ["module0(CNModuleConfig::name)", "module1(CNModuleConfig::name)", ...],
  * }
@@ -131,6 +152,18 @@ struct CNModuleConfig {
       parameters;   ///< The key-value pairs. The pipeline passes this value to the CNModuleConfig::name module.
   int parallelism;  ///< Module parallelism. It is equal to module thread number and the data queue for input data.
   int maxInputQueueSize;          ///< The maximum size of the input data queues.
+  ConveyorQueueType inputQueueType;  ///< The queue type of the input data queues, "mutex", "lockfree" or "fair".
+                                     ///< A "fair" queue keeps the streams apart, maxInputQueueSize still bounds all
+                                     ///< of them, a stream holding its share leaves the space to the waiting ones.
+  uint32_t inputQueueBlockTimeout;   ///< The maximum time in milliseconds to block on the input data queues, 0 means
+                                     ///< no limit. Data except EOS is dropped when pushing times out.
+  std::vector<int> cpuAffinity;      ///< The CPUs the module threads are bound to. Empty means no binding.
+  int numaNode;                      ///< The NUMA node the module threads and their host memory are placed on, -1
+                                     ///< means no NUMA placement.
+  uint32_t maxBatch;                 ///< The maximum number of data processed by Module::ProcessBatch at a time.
+  uint32_t maxWaitUs;                ///< The maximum time in microseconds to wait for a batch to fill.
+  bool enableFusion;                 ///< Whether the module could be fused into its upstream module.
+  bool frameParallel;                ///< Whether the frames of a stream are processed by all module threads.
   std::string className;          ///< The class name of the module.
   std::vector<std::string> next;  ///< The name of the downstream modules.
   bool showPerfInfo;              ///< Whether to show performance information or not.
@@ -260,12 +293,128 @@ class Pipeline : public Module {
    * }
    * @endcode
    *
+   * The optional ``pipeline_config`` item configures the pipeline itself, so it can not be used as a module name.
+   *
+   * @code
+   *   "pipeline_config" : {
+   *     "executor" : "work_stealing",  // or "thread_per_conveyor" (default)
+   *     "executor_threads" : 8,        // 0 (default) means the number of CPU cores
+   *     "stream_numa_placement" : true, // see Pipeline::SetStreamNumaPlacement, false by default
+   *     "max_frame_age_ms" : 200,       // see Pipeline::SetMaxFrameAge, 0 (default) means no limit
+   *     "conveyor_assignment" : "least_loaded" // or "stream_index" (default), see SetConveyorAssignPolicy
+   *   }
+   * @endcode
+   *
    * @param config_file The configuration file in JSON format.
    *
    * @return Returns 0 if this function has run successfully. Otherwise, returns -1.
    *
    */
   int BuildPipelineByJSONFile(const std::string& config_file);
+  /**
+   * Sets the way this pipeline runs the modules.
+   *
+   * By default, each input conveyor of each module is processed by its own thread.
+   * In work-stealing mode, all conveyors are processed by a shared thread pool, a conveyor becomes a task
+   * when it has data and is never processed by two threads at the same time, so the order of the frames
+   * in a conveyor is kept.
+   *
+   * @param type The executor type.
+   * @param thread_num The thread number of the work-stealing thread pool. 0 means the number of CPU cores.
+   *
+   * @return Returns false if the pipeline is running. Otherwise, returns true.
+   *
+   * @note You must call this function before calling Pipeline::Start.
+   */
+  bool SetExecutorType(PipelineExecutorType type, uint32_t thread_num = 0);
+  /**
+   * Gets the way this pipeline runs the modules.
+   */
+  PipelineExecutorType GetExecutorType() const;
+  /**
+   * Enables stream-to-socket placement for this pipeline.
+   *
+   * When it is enabled, streams are distributed to NUMA nodes by stream index (stream_index % node_count), and the
+   * threads of the modules processing a stream are bound to the CPUs of the node of the stream, see
+   * Module::BindThread. So the source, inference and tracking of a stream stay on the same socket. Module parallelism
+   * should be a multiple of the NUMA node number, so that each conveyor only gets streams of one node.
+   *
+   * Host memory is placed on the node of the thread allocating it, e.g. the frames of a stream are placed by the
+   * source thread. With stream placement it is the node of all the modules processing the stream. Without it, set
+   * the NUMA node of the source module to the node of the modules consuming its frames, see Module::SetAffinity.
+   *
+   * @param enable Whether to enable stream-to-socket placement. Disabled by default.
+   *
+   * @return Returns false if the pipeline is running. Otherwise, returns true.
+   *
+   * @note You must call this function before calling Pipeline::Start.
+   */
+  bool SetStreamNumaPlacement(bool enable);
+  /**
+   * @return Returns true if stream-to-socket placement is enabled for this pipeline. Otherwise, returns false.
+   */
+  bool GetStreamNumaPlacement() const;
+  /**
+   * Sets the maximum age of the frames processed by the modules.
+   *
+   * The age of a frame is counted from its creation, see CNFrameInfo::GetCreateTime. When a module takes a frame
+   * older than ``max_frame_age_ms`` from its input queue, the frame is dropped before Module::Process is called and
+   * is not transmitted to the downstream modules, so that a pipeline falling behind spends its time on fresh frames.
+   * EOS frames are never dropped. The dropped frames are counted by module and by stream, see
+   * Pipeline::GetStaleFrameCount.
+   *
+   * @param max_frame_age_ms The maximum age of the frames in milliseconds. 0 means no limit, which is the default.
+   *
+   * @note It can be changed while the pipeline is running.
+   */
+  void SetMaxFrameAge(uint32_t max_frame_age_ms);
+  /**
+   * Gets the maximum age of the frames processed by the modules, see Pipeline::SetMaxFrameAge.
+   */
+  uint32_t GetMaxFrameAge() const;
+  /**
+   * Gets the number of the frames dropped by a module because they are older than the maximum frame age.
+   *
+   * @param module_name The name of the module.
+   * @param stream_id The stream of the frames. The empty string means all streams.
+   *
+   * @return Returns the number of the dropped frames.
+   *
+   * @see Pipeline::SetMaxFrameAge.
+   */
+  uint64_t GetStaleFrameCount(const std::string& module_name, const std::string& stream_id = "") const;
+  /**
+   * Sets the way the streams are assigned to the input conveyors of the modules.
+   *
+   * By default, a stream goes to the conveyor of index stream_index % parallelism, so streams of different frame
+   * rates and resolutions may pile up on some conveyors. With ASSIGN_LEAST_LOADED, a new stream goes to the
+   * conveyor with the lowest recent processing time and queue depth.
+   *
+   * Either way, a stream keeps its conveyor until the module has transmitted the EOS of the stream, so the order
+   * of the frames is kept, and a stream added again after its EOS may be assigned to another conveyor.
+   *
+   * @param policy The assign policy.
+   *
+   * @return Returns false if the pipeline is running. Otherwise, returns true.
+   *
+   * @note You must call this function before calling Pipeline::Start.
+   *
+   * @see Pipeline::GetStreamConveyors.
+   */
+  bool SetConveyorAssignPolicy(ConveyorAssignPolicy policy);
+  /**
+   * Gets the way the streams are assigned to the input conveyors of the modules.
+   */
+  ConveyorAssignPolicy GetConveyorAssignPolicy() const;
+  /**
+   * Gets the input conveyors of a module the streams are assigned to.
+   *
+   * @param module_name The name of the module.
+   *
+   * @return Returns the conveyor index of each stream assigned to the module, by stream index. Returns an empty
+   *         map if the module has not been added to this pipeline or has no input conveyors.
+   */
+  std::map<uint32_t, uint32_t> GetStreamConveyors(const std::string& module_name) const;
   /**
    * Gets a module in a pipeline by name.
    *
@@ -326,7 +475,9 @@ class Pipeline : public Module {
    *
    * @param module The module to be configured.
    * @param parallelism Module parallelism, as well as Module's conveyor number of input connector.
-   * @param queue_capacity The queue capacity of the Module input conveyor.
+   * @param queue_capacity The queue capacity of the Module input conveyor, shared by all streams of the conveyor.
+   * @param queue_type The queue type of the Module input conveyor.
+   * @param block_timeout_ms The maximum time in milliseconds to block on the Module input conveyor, 0 means no limit.
    *
    * @return Returns true if this function has run successfully. Returns false if this module
    *         has not been added to this pipeline.
@@ -334,8 +485,11 @@ class Pipeline : public Module {
    * @note You must call this function before calling Pipeline::Start.
    *
    * @see CNModuleConfig::parallelism.
+   * @see CNModuleConfig::inputQueueType.
+   * @see CNModuleConfig::inputQueueBlockTimeout.
    */
-  bool SetModuleAttribute(std::shared_ptr<Module> module, uint32_t parallelism, size_t queue_capacity = 20);
+  bool SetModuleAttribute(std::shared_ptr<Module> module, uint32_t parallelism, size_t queue_capacity = 20,
+                          ConveyorQueueType queue_type = QUEUE_MUTEX, uint32_t block_timeout_ms = 0);
   /**
    * Gets the module parallelism.
    *
@@ -345,6 +499,78 @@ class Pipeline : public Module {
    *         Returns 0 if the module has not been added to this pipeline.
    */
   uint32_t GetModuleParallelism(std::shared_ptr<Module> module);
+  /**
+   * Enables or disables the fusion of the module into its upstream module.
+   *
+   * When the pipeline starts, a module whose only upstream module has no other downstream module is fused into
+   * the upstream module: it processes data inline in the threads of the upstream module instead of its own
+   * threads, which saves a queue hop and a context switch per frame. Chains of such modules, e.g., A->B->C, run
+   * in the threads of the first module. Modules processing data in batches (see SetModuleBatchAttribute) and
+   * modules after a source module or a module which transmits data by itself are never fused. A module is only
+   * fused when its parallelism, input queue type and affinity are the same as the upstream module's, so that it
+   * keeps the threads it asked for.
+   *
+   * Fusion is enabled by default.
+   *
+   * @param module The module to be configured.
+   * @param enable Whether the module could be fused into its upstream module.
+   *
+   * @return Returns true if this function has run successfully. Returns false if this module
+   *         has not been added to this pipeline.
+   *
+   * @note You must call this function before calling Pipeline::Start.
+   *
+   * @see CNModuleConfig::enableFusion.
+   */
+  bool SetModuleFusion(std::shared_ptr<Module> module, bool enable);
+  /**
+   * Sets the batch attributes of the module.
+   *
+   * When ``max_batch`` is greater than 1, each module thread pops up to ``max_batch`` data from its input conveyor
+   * at a time and passes them to Module::ProcessBatch.
+   *
+   * @param module The module to be configured.
+   * @param max_batch The maximum number of data processed by Module::ProcessBatch at a time. 1 means processing
+   *                  data one by one by Module::Process.
+   * @param max_wait_us The maximum time in microseconds to wait for more data after the first data of a batch
+   *                    arrives. 0 means only the data already in the conveyor are batched. It is ignored by the
+   *                    work-stealing executor, whose threads never wait for data.
+   *
+   * @return Returns true if this function has run successfully. Returns false if this module
+   *         has not been added to this pipeline or ``max_batch`` is 0.
+   *
+   * @note You must call this function before calling Pipeline::Start.
+   *
+   * @see CNModuleConfig::maxBatch.
+   * @see CNModuleConfig::maxWaitUs.
+   */
+  bool SetModuleBatchAttribute(std::shared_ptr<Module> module, uint32_t max_batch, uint32_t max_wait_us = 0);
+  /**
+   * Enables or disables frame parallelism of the module.
+   *
+   * By default, all frames of a stream go to one input conveyor of the module, so a stream is processed by one
+   * thread at a time and a high-resolution, high-frame-rate stream can not use more than one core. With frame
+   * parallelism, the frames of a stream go to all conveyors in turn and are processed by all threads of the module
+   * at the same time. The processed frames are transmitted to the downstream modules in the order they came, and
+   * the EOS of a stream after all frames before it, so the downstream modules see no difference. The frames
+   * dropped by the module are skipped.
+   *
+   * It suits stateless modules whose processing time dominates, e.g. drawing or CPU preprocessing. Modules keeping
+   * the state of a stream across frames, e.g. tracking, must not enable it. Modules with frame parallelism are
+   * never fused into their upstream modules.
+   *
+   * @param module The module to be configured.
+   * @param enable Whether the frames of a stream are processed by all threads of the module.
+   *
+   * @return Returns true if this function has run successfully. Returns false if this module has not been added to
+   *         this pipeline, the pipeline is running, or the module transmits data by itself (see
+   *         Module::HasTransmit), whose output order can not be restored.
+   *
+   * @note You must call this function before calling Pipeline::Start.
+   *
+   * @see CNModuleConfig::frameParallel.
+   */
+  bool SetModuleFrameParallel(std::shared_ptr<Module> module, bool enable);
 
   /**
    * Links two modules.
@@ -427,7 +653,8 @@ class Pipeline : public Module {
 #ifdef UNIT_TEST
  public:  // NOLINT
 #endif
-  void TransmitData(const std::string node_name, std::shared_ptr<CNFrameInfo> data);
+  /* returns false if a downstream module fused into the calling thread failed to process the data */
+  bool TransmitData(const std::string node_name, std::shared_ptr<CNFrameInfo> data);
 
   void TaskLoop(std::string node_name, uint32_t conveyor_idx);
 
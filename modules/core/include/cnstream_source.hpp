@@ -64,12 +64,44 @@ class SourceModule : public Module {
    */
   int RemoveSource(const std::string &stream_id);
 
+  /**
+   * @brief Set the maximum number of frames in flight of one stream. It could be called before or after the stream
+   *        is added, so that the high-priority streams get deeper pipelines than the others.
+   * @param
+   *   stream_id[in]: unique stream identifier.
+   *   parallelism[in]: the maximum number of frames in flight, not limited if it is less than or equal to 0.
+   *                    The streams without their own limit use the one set by SetParallelism().
+   * @return
+   *    0: success (always success by now)
+   */
+  int SetStreamParallelism(const std::string &stream_id, int parallelism);
+
+  /**
+   * @brief Set the scheduling weight of one stream. It could be called before or after the stream is added.
+   *        The input queues of type QUEUE_FAIR of the modules give each stream as many turns as its weight,
+   *        relative to the other streams, so that a bursty stream does not starve the others.
+   * @param
+   *   stream_id[in]: unique stream identifier.
+   *   weight[in]: the weight of the stream, 0 is taken as 1. The streams are weighted 1 by default.
+   * @return
+   *    0: success (always success by now)
+   */
+  int SetStreamWeight(const std::string &stream_id, uint32_t weight);
+
   int Process(std::shared_ptr<CNFrameInfo> data) override;
 
  protected:
   friend class SourceHandler;
   uint32_t GetStreamIndex(const std::string &stream_id);
   void ReturnStreamIndex(const std::string &stream_id);
+  int GetStreamParallelism(const std::string &stream_id);
+  uint32_t GetStreamWeight(const std::string &stream_id);
+  /**
+   * @brief Get the handler of one stream added to the source module.
+   * @return
+   *   the handler of the stream, nullptr if the stream is not found
+   */
+  std::shared_ptr<SourceHandler> GetSourceHandler(const std::string &stream_id);
   /**
    * @brief Transmit data to next stage(s) of the pipeline
    * @param
@@ -93,6 +125,9 @@ class SourceModule : public Module {
  private:
   std::mutex mutex_;
   std::map<std::string /*stream_id*/, std::shared_ptr<SourceHandler>> source_map_;
+  CNSpinLock parallelism_lock_;  // guards stream_parallelism_ and stream_weight_
+  std::map<std::string /*stream_id*/, int> stream_parallelism_;
+  std::map<std::string /*stream_id*/, uint32_t> stream_weight_;
 };
 
 class SourceHandler {
@@ -100,6 +135,9 @@ class SourceHandler {
   explicit SourceHandler(SourceModule *module, const std::string &stream_id, int frame_rate, bool loop)
       : module_(module), stream_id_(stream_id), frame_rate_(frame_rate), loop_(loop) {
     stream_index_ = module_->GetStreamIndex(stream_id_);
+    int parallelism = module_ ? module_->GetStreamParallelism(stream_id_) : GetParallelism();
+    admission_ = std::make_shared<CNStreamAdmission>(parallelism);
+    if (module_) admission_->SetWeight(module_->GetStreamWeight(stream_id_));
   }
   virtual ~SourceHandler() { module_->ReturnStreamIndex(stream_id_); }
 
@@ -109,6 +147,11 @@ class SourceHandler {
  public:
   std::string GetStreamId() const { return stream_id_; }
   uint32_t GetStreamIndex() const { return stream_index_; }
+  /**
+   * @brief Get the admission of the stream, which limits the frames of the stream in flight.
+   *        The frames should be created by CNFrameInfo::Create() with it.
+   */
+  std::shared_ptr<CNStreamAdmission> GetAdmission() const { return admission_; }
   bool SendData(std::shared_ptr<CNFrameInfo> data) {
     if (this->module_) {
       return this->module_->SendData(data);
@@ -122,6 +165,7 @@ class SourceHandler {
   int frame_rate_ = 0;
   bool loop_ = false;
   uint32_t stream_index_;
+  std::shared_ptr<CNStreamAdmission> admission_;
 };
 
 }  // namespace cnstream
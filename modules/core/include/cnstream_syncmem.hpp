@@ -37,6 +37,8 @@
  */
 
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 
 namespace cnstream {
@@ -44,8 +46,14 @@ namespace cnstream {
 /**
  * Allocates data on a host.
  *
+ * The data is 64-byte aligned. The blocks from 64KB to 64MB are rounded up to size classes and kept for reuse after
+ * they are freed, in a cache of the freeing thread first and then in free lists shared by the threads, so that
+ * the frames of the same size do not map and fault in new pages.
+ *
  * @param ptr Outputs data pointer.
  * @param size Size of the data to be allocated.
+ *
+ * @note The data is placed on the NUMA node set by ``SetThreadMemoryNode`` in the calling thread, if any.
  */
 void CNStreamMallocHost(void** ptr, size_t size);
 
@@ -54,7 +62,44 @@ void CNStreamMallocHost(void** ptr, size_t size);
  *
  * @param ptr The data address to be freed.
  */
-inline void CNStreamFreeHost(void* ptr) { free(ptr); }
+void CNStreamFreeHost(void* ptr);
+
+/**
+ * The statistics of the host memory allocated by ``CNStreamMallocHost``.
+ */
+struct CNHostMemoryStats {
+  size_t in_use_bytes = 0;      ///< The bytes in use.
+  size_t high_water_bytes = 0;  ///< The maximum bytes in use since the process started.
+  size_t cached_bytes = 0;      ///< The bytes of the free blocks kept for reuse.
+  uint64_t hit_count = 0;       ///< The number of allocations served by the free blocks.
+  uint64_t miss_count = 0;      ///< The number of allocations that mapped new memory.
+};
+
+/**
+ * Gets the statistics of the host memory allocated by ``CNStreamMallocHost``.
+ *
+ * @return Returns the statistics.
+ */
+CNHostMemoryStats GetHostMemoryStats();
+
+/**
+ * Backs the large blocks allocated by ``CNStreamMallocHost`` with huge pages. The pages reserved for MAP_HUGETLB are
+ * used if any, otherwise transparent huge pages are requested.
+ *
+ * Disabled by default.
+ */
+void SetHostMemoryHugePages(bool enable);
+
+/**
+ * Sets the maximum bytes of the free blocks kept for reuse and shared by the threads. The blocks freed beyond it
+ * are returned to the system. 512MB by default.
+ */
+void SetHostMemoryCacheLimit(size_t bytes);
+
+/**
+ * Returns the free blocks shared by the threads to the system.
+ */
+void ReleaseHostMemoryCache();
 
 /**
  * @brief Synchronizes memory between CPU and MLU.
@@ -126,6 +171,15 @@ class CNSyncedMemory {
    * @note You need to call this API before all getters and setters.
    */
   void SetMluDevContext(int dev_id, int ddr_chn = 0);
+  /**
+   * Resets the synced memory to the uninitialized state, so that the object can be reused.
+   * The data owned by the synced memory is released.
+   *
+   * @param size The new data size.
+   * @param mlu_dev_id The MLU device ID.
+   * @param mlu_ddr_chn The MLU DDR channel ID.
+   */
+  void Reset(size_t size, int mlu_dev_id = 0, int mlu_ddr_chn = 0);
   /**
    * Gets the MLU device ID.
    *
@@ -217,6 +271,14 @@ class CNSyncedMemory {
   int dev_id_ = 0;   ///< Ordinal MLU device ID.
   int ddr_chn_ = 0;  ///< Ordinal MLU DDR channel ID. The value should be [0, 4).
 
+  friend struct CNDataFrame;
+  /**
+   * Keeps the data alive when it is not owned by the synced memory, e.g., the data of a frame released while
+   * its planes are still referenced.
+   */
+  void SetDataHolder(std::shared_ptr<void> holder);
+  std::shared_ptr<void> data_holder_;
+
   DISABLE_COPY_AND_ASSIGN(CNSyncedMemory);
   mutable std::mutex mutex_;
 };  // class CNSyncedMemory
@@ -0,0 +1,129 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "cnstream_affinity.hpp"
+
+#include <glog/logging.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+namespace cnstream {
+
+static const char* kNumaNodePath = "/sys/devices/system/node/node";
+
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  std::stringstream ss(cpu_list.substr(0, cpu_list.find_last_not_of(" \n") + 1));
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    int first = -1, last = -1;
+    char tail = 0;
+    if (sscanf(range.c_str(), "%d-%d%c", &first, &last, &tail) != 2) {
+      if (sscanf(range.c_str(), "%d%c", &first, &tail) != 1) return {};
+      last = first;
+    }
+    if (first < 0 || last < first) return {};
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+int GetNumaNodeCount() {
+  static const int node_count = [] {
+    int count = 0;
+    while (access((kNumaNodePath + std::to_string(count)).c_str(), F_OK) == 0) ++count;
+    return count > 0 ? count : 1;
+  }();
+  return node_count;
+}
+
+std::vector<int> GetNumaNodeCpus(int node) {
+  if (node < 0) return {};
+  std::ifstream ifs(kNumaNodePath + std::to_string(node) + "/cpulist");
+  if (!ifs.is_open()) {
+    if (node != 0) return {};
+    // NUMA is not supported, all CPUs belong to node 0.
+    std::vector<int> cpus;
+    long cpu_num = sysconf(_SC_NPROCESSORS_CONF);  // NOLINT
+    for (int cpu = 0; cpu < cpu_num; ++cpu) cpus.push_back(cpu);
+    return cpus;
+  }
+  std::string cpu_list;
+  std::getline(ifs, cpu_list);
+  return ParseCpuList(cpu_list);
+}
+
+bool SetThreadAffinity(const std::vector<int>& cpus, pthread_t thread) {
+  if (cpus.empty()) return false;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      LOG(ERROR) << "Invalid cpu index: " << cpu;
+      return false;
+    }
+    CPU_SET(cpu, &cpuset);
+  }
+  int ret = pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset);
+  if (ret != 0) {
+    LOG(WARNING) << "Set thread affinity failed, error code: " << ret;
+    return false;
+  }
+  return true;
+}
+
+static thread_local int tls_memory_node = -1;
+
+void SetThreadMemoryNode(int node) { tls_memory_node = node; }
+
+int GetThreadMemoryNode() { return tls_memory_node; }
+
+bool BindHostMemory(void* ptr, size_t size, int node) {
+#ifdef __NR_mbind
+  if (!ptr || !size || node < 0 || node >= GetNumaNodeCount()) return false;
+  if (GetNumaNodeCount() == 1) return true;
+  unsigned long nodemask = 1UL << node;  // NOLINT
+  long ret = syscall(__NR_mbind, ptr, size, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8, 0);  // NOLINT
+  if (ret != 0) {
+    LOG(WARNING) << "Bind host memory to numa node " << node << " failed, errno: " << errno;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+int GetStreamNumaNode(uint32_t stream_idx) { return static_cast<int>(stream_idx % GetNumaNodeCount()); }
+
+}  // namespace cnstream
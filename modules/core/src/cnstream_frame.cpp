@@ -22,6 +22,10 @@
 
 #include <cnrt.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -35,13 +39,35 @@
 
 namespace cnstream {
 
+static constexpr size_t kPlaneAlignment = 64;
+
+/* the memory of a released frame, kept alive by the synced memory of the planes still referenced */
+struct FrameMemoryHolder {
+  void* cpu_data = nullptr;
+  void* mlu_data = nullptr;
+  DevContext ctx;
+  std::shared_ptr<IDataDeallocator> deallocator;
+  std::shared_ptr<ICNMediaImageMapper> mapper;
+  ~FrameMemoryHolder() {
+    if (nullptr != mlu_data) {
+      CALL_CNRT_BY_CONTEXT(cnrtFree(mlu_data), ctx.dev_id, ctx.ddr_channel);
+    }
+    if (nullptr != cpu_data) CNStreamFreeHost(cpu_data);
+  }
+};
+
 CNDataFrame::~CNDataFrame() {
+  HandOverSharedPlanes();
   if (nullptr != mlu_data) {
     CALL_CNRT_BY_CONTEXT(cnrtFree(mlu_data), ctx.dev_id, ctx.ddr_channel);
   }
   if (nullptr != cpu_data) {
     CNStreamFreeHost(cpu_data), cpu_data = nullptr;
   }
+  if (nullptr != cached_cpu_data_) {
+    CNStreamFreeHost(cached_cpu_data_), cached_cpu_data_ = nullptr;
+  }
+  ReleaseCachedMluData();
 
   if (nullptr != mapper_) {
     mapper_.reset();
@@ -64,12 +90,29 @@ cv::Mat* CNDataFrame::ImageBGR() {
   }
   int stride_ = stride[0];
   cv::Mat bgr(height, stride_, CV_8UC3);
-  uint8_t* img_data = new (std::nothrow) uint8_t[GetBytes()];
+  size_t img_bytes = GetBytes();
+  if (CN_PIXEL_FORMAT_YUV420P == fmt) img_bytes = std::max(img_bytes, static_cast<size_t>(height) * stride_ * 3 / 2);
+  uint8_t* img_data = new (std::nothrow) uint8_t[img_bytes];
   LOG_IF(FATAL, nullptr == img_data) << "CNDataFrame::ImageBGR() failed to alloc memory";
   uint8_t* t = img_data;
-  for (int i = 0; i < GetPlanes(); ++i) {
-    memcpy(t, data[i]->GetCpuData(), GetPlaneBytes(i));
-    t += GetPlaneBytes(i);
+  if (CN_PIXEL_FORMAT_YUV420P == fmt) {
+    // I420 conversion expects the chroma rows to be half of the luma stride
+    memcpy(t, data[0]->GetCpuData(), GetPlaneBytes(0));
+    t += GetPlaneBytes(0);
+    const size_t chroma_width = stride_ / 2;
+    for (int i = 1; i < GetPlanes(); ++i) {
+      const uint8_t* src = reinterpret_cast<const uint8_t*>(data[i]->GetCpuData());
+      const size_t row_bytes = std::min(chroma_width, static_cast<size_t>(stride[i]));
+      for (int row = 0; row < height / 2; ++row) {
+        memcpy(t, src + row * stride[i], row_bytes);
+        t += chroma_width;
+      }
+    }
+  } else {
+    for (int i = 0; i < GetPlanes(); ++i) {
+      memcpy(t, data[i]->GetCpuData(), GetPlaneBytes(i));
+      t += GetPlaneBytes(i);
+    }
   }
   switch (fmt) {
     case CNDataFormat::CN_PIXEL_FORMAT_BGR24: {
@@ -87,6 +130,14 @@ cv::Mat* CNDataFrame::ImageBGR() {
       cv::Mat src = cv::Mat(height * 3 / 2, stride_, CV_8UC1, img_data);
       cv::cvtColor(src, bgr, cv::COLOR_YUV2BGR_NV21);
     } break;
+    case CNDataFormat::CN_PIXEL_FORMAT_YUV420P: {
+      cv::Mat src = cv::Mat(height * 3 / 2, stride_, CV_8UC1, img_data);
+      cv::cvtColor(src, bgr, cv::COLOR_YUV2BGR_I420);
+    } break;
+    case CNDataFormat::CN_PIXEL_FORMAT_GRAY8: {
+      cv::Mat src = cv::Mat(height, stride_, CV_8UC1, img_data);
+      cv::cvtColor(src, bgr, cv::COLOR_GRAY2BGR);
+    } break;
     default: {
       LOG(WARNING) << "Unsupport pixel format.";
       delete[] img_data;
@@ -116,6 +167,13 @@ size_t CNDataFrame::GetPlaneBytes(int plane_idx) const {
         return height * stride[1] / 2;
       else
         LOG(FATAL) << "plane index wrong.";
+    case CN_PIXEL_FORMAT_YUV420P:
+      if (0 == plane_idx)
+        return height * stride[0];
+      else
+        return height * stride[plane_idx] / 2;
+    case CN_PIXEL_FORMAT_GRAY8:
+      return height * stride[0];
     default:
       return 0;
   }
@@ -131,12 +189,21 @@ size_t CNDataFrame::GetBytes() const {
 }
 
 void CNDataFrame::CopyToSyncMem() {
+  if (this->deAllocator_ != nullptr && this->ctx.dev_type == DevContext::CPU) {
+    /*the decoder buffer (e.g. AVFrame) is referenced by the deallocator, avoid host2host copy*/
+    for (int i = 0; i < GetPlanes(); i++) {
+      size_t plane_size = GetPlaneBytes(i);
+      this->data[i] = AcquireSyncedMemory(i, plane_size);
+      this->data[i]->SetCpuData(this->ptr_cpu[i]);
+    }
+    return;
+  }
   if (this->deAllocator_ != nullptr) {
 #ifdef CNS_MLU220_SOC
     if (this->ctx.dev_type == DevContext::MLU_CPU) {
       for (int i = 0; i < GetPlanes(); i++) {
         size_t plane_size = GetPlaneBytes(i);
-        this->data[i].reset(new (std::nothrow) CNSyncedMemory(plane_size, ctx.dev_id, ctx.ddr_channel));
+        this->data[i] = AcquireSyncedMemory(i, plane_size, ctx.dev_id, ctx.ddr_channel);
         this->data[i]->SetMluCpuData(this->ptr_mlu[i], this->ptr_cpu[i]);
       }
     } else {
@@ -146,88 +213,213 @@ void CNDataFrame::CopyToSyncMem() {
     /*cndecoder buffer will be used to avoid dev2dev copy*/
     for (int i = 0; i < GetPlanes(); i++) {
       size_t plane_size = GetPlaneBytes(i);
-      this->data[i].reset(new (std::nothrow) CNSyncedMemory(plane_size, ctx.dev_id, ctx.ddr_channel));
+      this->data[i] = AcquireSyncedMemory(i, plane_size, ctx.dev_id, ctx.ddr_channel);
       this->data[i]->SetMluData(this->ptr_mlu[i]);
     }
 #endif
     return;
   }
   /*deep copy*/
+  if (this->ctx.dev_type == DevContext::MLU) {
+    AllocSyncMem();
+    for (int i = 0; i < GetPlanes(); i++) {
+      CALL_CNRT_BY_CONTEXT(cnrtMemcpy(this->data[i]->GetMutableMluData(), ptr_mlu[i], GetPlaneBytes(i),
+                                      CNRT_MEM_TRANS_DIR_DEV2DEV),
+                           ctx.dev_id, ctx.ddr_channel);
+    }
+  } else if (this->ctx.dev_type == DevContext::CPU) {
+    AllocSyncMem();
+    for (int i = 0; i < GetPlanes(); i++) {
+      memcpy(this->data[i]->GetMutableCpuData(), ptr_cpu[i], GetPlaneBytes(i));
+    }
+#ifdef CNS_MLU220_SOC
+  } else if (this->ctx.dev_type == DevContext::MLU_CPU) {
+    LOG(FATAL) << "MLU220_SOC: MLU_CPU deepCopy not supported yet";
+#endif
+  } else {
+    LOG(FATAL) << "Device type not supported";
+  }
+}
+
+void CNDataFrame::ReleaseCachedMluData() {
+  if (nullptr != cached_mlu_data_) {
+    CALL_CNRT_BY_CONTEXT(cnrtFree(cached_mlu_data_), cached_mlu_ctx_.dev_id, cached_mlu_ctx_.ddr_channel);
+    cached_mlu_data_ = nullptr;
+  }
+}
+
+void CNDataFrame::AllocSyncMem() {
   if (this->ctx.dev_type == DevContext::MLU) {
     if (mlu_data != nullptr) {
-      LOG(FATAL) << "CopyToSyncMem should be called once for each frame";
+      LOG(FATAL) << "AllocSyncMem should be called once for each frame";
     }
-    size_t bytes = GetBytes();
-    bytes = ROUND_UP(bytes, 64 * 1024);
-    CALL_CNRT_BY_CONTEXT(cnrtMalloc(&mlu_data, bytes), ctx.dev_id, ctx.ddr_channel);
+    size_t bytes = ROUND_UP(GetBytes(), 64 * 1024);
+    if (nullptr != cached_mlu_data_ && cached_mlu_bytes_ >= bytes && cached_mlu_ctx_.dev_id == ctx.dev_id &&
+        cached_mlu_ctx_.ddr_channel == ctx.ddr_channel) {
+      // reuse the buffer of the previous frame recycled by the frame pool
+      mlu_data = cached_mlu_data_, cached_mlu_data_ = nullptr;
+      bytes = cached_mlu_bytes_;
+    } else {
+      ReleaseCachedMluData();
+      CALL_CNRT_BY_CONTEXT(cnrtMalloc(&mlu_data, bytes), ctx.dev_id, ctx.ddr_channel);
+    }
+    mlu_data_bytes_ = bytes;
     void* dst = mlu_data;
     for (int i = 0; i < GetPlanes(); i++) {
       size_t plane_size = GetPlaneBytes(i);
-      CALL_CNRT_BY_CONTEXT(cnrtMemcpy(dst, ptr_mlu[i], plane_size, CNRT_MEM_TRANS_DIR_DEV2DEV), ctx.dev_id,
-                           ctx.ddr_channel);
-      this->data[i].reset(new (std::nothrow) CNSyncedMemory(plane_size, ctx.dev_id, ctx.ddr_channel));
+      this->data[i] = AcquireSyncedMemory(i, plane_size, ctx.dev_id, ctx.ddr_channel);
       this->data[i]->SetMluData(dst);
       dst = reinterpret_cast<void*>(reinterpret_cast<uint8_t*>(dst) + plane_size);
     }
   } else if (this->ctx.dev_type == DevContext::CPU) {
     if (cpu_data != nullptr) {
-      LOG(FATAL) << "CopyToSyncMem should be called once for each frame";
+      LOG(FATAL) << "AllocSyncMem should be called once for each frame";
+    }
+    // the planes are 64-byte aligned, as the data allocated by CNStreamMallocHost
+    size_t bytes = 0;
+    for (int i = 0; i < GetPlanes(); i++) {
+      bytes += ROUND_UP(GetPlaneBytes(i), kPlaneAlignment);
     }
-    size_t bytes = GetBytes();
     bytes = ROUND_UP(bytes, 64 * 1024);
-    CNStreamMallocHost(&cpu_data, bytes);
+    if (nullptr != cached_cpu_data_ && cached_cpu_bytes_ >= bytes) {
+      // reuse the buffer of the previous frame recycled by the frame pool
+      cpu_data = cached_cpu_data_, cached_cpu_data_ = nullptr;
+      bytes = cached_cpu_bytes_;
+    } else {
+      if (nullptr != cached_cpu_data_) {
+        CNStreamFreeHost(cached_cpu_data_), cached_cpu_data_ = nullptr;
+      }
+      CNStreamMallocHost(&cpu_data, bytes);
+    }
+    cpu_data_bytes_ = bytes;
     if (nullptr == cpu_data) {
-      LOG(FATAL) << "CopyToSyncMem: failed to alloc cpu memory";
+      LOG(FATAL) << "AllocSyncMem: failed to alloc cpu memory";
     }
     void* dst = cpu_data;
     for (int i = 0; i < GetPlanes(); i++) {
       size_t plane_size = GetPlaneBytes(i);
-      memcpy(dst, ptr_cpu[i], plane_size);
-      this->data[i].reset(new (std::nothrow) CNSyncedMemory(plane_size));
+      this->data[i] = AcquireSyncedMemory(i, plane_size);
       this->data[i]->SetCpuData(dst);
-      dst = reinterpret_cast<void*>(reinterpret_cast<uint8_t*>(dst) + plane_size);
+      dst = reinterpret_cast<void*>(reinterpret_cast<uint8_t*>(dst) + ROUND_UP(plane_size, kPlaneAlignment));
     }
-#ifdef CNS_MLU220_SOC
-  } else if (this->ctx.dev_type == DevContext::MLU_CPU) {
-    LOG(FATAL) << "MLU220_SOC: MLU_CPU deepCopy not supported yet";
-#endif
   } else {
     LOG(FATAL) << "Device type not supported";
   }
 }
 
-uint64_t CNDataFrame::SetModuleMask(Module* module, Module* current) {
-  CNSpinLockGuard guard(mask_lock_);
-  auto iter = module_mask_map_.find(module->GetId());
-  if (iter != module_mask_map_.end()) {
-    iter->second |= (uint64_t)1 << current->GetId();
-  } else {
-    module_mask_map_[module->GetId()] = (uint64_t)1 << current->GetId();
+std::shared_ptr<CNSyncedMemory> CNDataFrame::AcquireSyncedMemory(int plane_idx, size_t size, int dev_id,
+                                                                 int ddr_chn) {
+  std::shared_ptr<CNSyncedMemory> mem = std::move(cached_data_[plane_idx]);
+  if (mem) {
+    mem->Reset(size, dev_id, ddr_chn);
+    return mem;
   }
-  return module_mask_map_[module->GetId()];
+  mem.reset(new (std::nothrow) CNSyncedMemory(size, dev_id, ddr_chn));
+  return mem;
 }
 
-uint64_t CNDataFrame::GetModulesMask(Module* module) {
-  CNSpinLockGuard guard(mask_lock_);
-  auto iter = module_mask_map_.find(module->GetId());
-  if (iter != module_mask_map_.end()) {
-    return iter->second;
+bool CNDataFrame::HandOverSharedPlanes() {
+  bool shared = false;
+  for (int i = 0; i < CN_MAX_PLANES && !shared; ++i) {
+    shared = data[i] && data[i].use_count() > 1;
   }
-  return 0;
+  if (!shared) return false;
+  std::shared_ptr<FrameMemoryHolder> holder = std::make_shared<FrameMemoryHolder>();
+  holder->cpu_data = cpu_data, cpu_data = nullptr;
+  holder->mlu_data = mlu_data, mlu_data = nullptr;
+  holder->ctx = ctx;
+  holder->deallocator = std::move(deAllocator_);
+  holder->mapper = std::move(mapper_);
+  cpu_data_bytes_ = 0;
+  mlu_data_bytes_ = 0;
+  for (int i = 0; i < CN_MAX_PLANES; ++i) {
+    if (data[i] && data[i].use_count() > 1) data[i]->SetDataHolder(holder);
+  }
+  return true;
 }
 
-void CNDataFrame::ClearModuleMask(Module* module) {
-  CNSpinLockGuard guard(mask_lock_);
-  auto iter = module_mask_map_.find(module->GetId());
-  if (iter != module_mask_map_.end()) {
-    iter->second = 0;
+void CNDataFrame::Reset() {
+  // the memory of the planes referenced elsewhere is released by the last owner, it is not reused
+  HandOverSharedPlanes();
+  if (nullptr != mlu_data) {
+    if (0 != mlu_data_bytes_) {
+      // allocated by AllocSyncMem, keep it for the next frame
+      ReleaseCachedMluData();
+      cached_mlu_data_ = mlu_data;
+      cached_mlu_ctx_ = ctx;
+      cached_mlu_bytes_ = mlu_data_bytes_;
+    } else {
+      CALL_CNRT_BY_CONTEXT(cnrtFree(mlu_data), ctx.dev_id, ctx.ddr_channel);
+    }
+    mlu_data = nullptr;
+    mlu_data_bytes_ = 0;
+  }
+  if (nullptr != cpu_data) {
+    if (0 != cpu_data_bytes_) {
+      // allocated by AllocSyncMem, keep it for the next frame
+      if (nullptr != cached_cpu_data_) CNStreamFreeHost(cached_cpu_data_);
+      cached_cpu_data_ = cpu_data;
+      cached_cpu_bytes_ = cpu_data_bytes_;
+    } else {
+      CNStreamFreeHost(cpu_data);
+    }
+    cpu_data = nullptr;
+    cpu_data_bytes_ = 0;
+  }
+  for (int i = 0; i < CN_MAX_PLANES; ++i) {
+    if (data[i] && 1 == data[i].use_count()) {
+      // release the data owned by the synced memory, the object itself is kept
+      data[i]->Reset(0);
+      cached_data_[i] = std::move(data[i]);
+    }
+    data[i].reset();
+  }
+  mapper_.reset();
+  deAllocator_.reset();
+#ifdef HAVE_OPENCV
+  if (nullptr != bgr_mat) {
+    delete bgr_mat, bgr_mat = nullptr;
   }
+#endif
+  stream_id.clear();
+  flags = 0;
+  ctx = DevContext();
+  module_num_ = 0;
+  eos_num_.store(0, std::memory_order_relaxed);
+}
+
+void CNDataFrame::InitModuleMasks(size_t module_num) {
+  const size_t mask_num = module_num + (module_num + 63) / 64;
+  if (mask_num > module_masks_capacity_) {
+    module_masks_.reset(new std::atomic<uint64_t>[mask_num]);
+    module_masks_capacity_ = mask_num;
+  }
+  for (size_t i = 0; i < mask_num; ++i) module_masks_[i].store(0, std::memory_order_relaxed);
+  module_num_ = module_num;
+  eos_num_.store(0);
+}
+
+uint64_t CNDataFrame::SetModuleMask(Module* module, uint64_t parent_mask) {
+  assert(module->GetId() < module_num_);
+  return module_masks_[module->GetId()].fetch_or(parent_mask, std::memory_order_acq_rel) | parent_mask;
+}
+
+uint64_t CNDataFrame::GetModulesMask(Module* module) {
+  if (!module_masks_ || module->GetId() >= module_num_) return 0;
+  return module_masks_[module->GetId()].load(std::memory_order_acquire);
 }
 
-uint64_t CNDataFrame::AddEOSMask(Module* module) {
-  CNSpinLockGuard guard(eos_lock_);
-  eos_mask |= (uint64_t)1 << module->GetId();
-  return eos_mask;
+void CNDataFrame::ClearModuleMask(Module* module) {
+  if (!module_masks_ || module->GetId() >= module_num_) return;
+  module_masks_[module->GetId()].store(0, std::memory_order_relaxed);
+}
+
+bool CNDataFrame::AddEOSMask(Module* module) {
+  const size_t id = module->GetId();
+  assert(id < module_num_);
+  const uint64_t bit = (uint64_t)1 << (id % 64);
+  if (module_masks_[module_num_ + id / 64].fetch_or(bit, std::memory_order_acq_rel) & bit) return false;
+  return eos_num_.fetch_add(1, std::memory_order_acq_rel) + 1 == module_num_;
 }
 
 bool CNInferObject::AddAttribute(const std::string& key, const CNInferAttr& value) {
@@ -293,10 +485,11 @@ std::vector<CNInferFeature> CNInferObject::GetFeatures() {
   return features_;
 }
 
-CNSpinLock CNFrameInfo::spinlock_;
-std::map<std::string, int> CNFrameInfo::stream_count_map_;
 int CNFrameInfo::parallelism_ = 0;
 
+/* the number of idle frames kept for a stream when the frames in flight are not limited */
+static constexpr size_t kDefaultFramePoolCapacity = 32;
+
 void SetParallelism(int parallelism) { CNFrameInfo::parallelism_ = parallelism; }
 int GetParallelism() { return CNFrameInfo::parallelism_; }
 
@@ -311,54 +504,185 @@ std::shared_ptr<CNFrameInfo> CNFrameInfo::Create(const std::string& stream_id, b
     return nullptr;
   }
   ptr->frame.stream_id = stream_id;
+  ptr->create_time_ = std::chrono::steady_clock::now();
   if (eos) {
     ptr->frame.flags |= cnstream::CN_FRAME_FLAG_EOS;
-    return ptr;
   }
+  return ptr;
+}
 
-  if (parallelism_ > 0) {
-    CNSpinLockGuard guard(spinlock_);
-    auto iter = stream_count_map_.find(stream_id);
-    if (iter == stream_count_map_.end()) {
-      int count = 1;
-      stream_count_map_[stream_id] = count;
-      // LOG(INFO) << "CNFrameInfo::Create() insert stream_id: " << stream_id;
-    } else {
-      int count = stream_count_map_[stream_id];
-      if (count >= parallelism_) {
-        return nullptr;
-      }
-      stream_count_map_[stream_id] = count + 1;
-      // LOG(INFO) << "CNFrameInfo::Create() add count stream_id " << stream_id << ":" << count;
-    }
+std::shared_ptr<CNFrameInfo> CNFrameInfo::Create(const std::string& stream_id,
+                                                 const std::shared_ptr<CNStreamAdmission>& admission, bool block) {
+  if (!admission) return Create(stream_id);
+  if (stream_id == "") {
+    LOG(ERROR) << "CNFrameInfo::Create() stream_id is empty string.";
+    return nullptr;
+  }
+  if (!admission->Acquire(block)) {
+    return nullptr;
+  }
+  std::shared_ptr<CNFrameInfo> ptr = admission->GetPool()->Acquire();
+  if (!ptr) {
+    LOG(ERROR) << "CNFrameInfo::Create() new CNFrameInfo failed.";
+    admission->Release();
+    return nullptr;
   }
+  ptr->admission_ = admission;
+  ptr->frame.stream_id = stream_id;
+  ptr->create_time_ = std::chrono::steady_clock::now();
   return ptr;
 }
 
-CNFrameInfo::~CNFrameInfo() {
-  if (frame.flags & CN_FRAME_FLAG_EOS) {
-    return;
+void CNFrameInfo::Reset() {
+  channel_idx = INVALID_STREAM_IDX;
+  objs.clear();
+  renditions.clear();
+  frame.Reset();
+}
+
+/* only the first misses of rendition names are logged, the frames of a stream all miss the same name */
+static const int kRenditionMissLogNumber = 10;
+
+CNDataFrame* CNFrameInfo::GetRendition(const std::string& name) {
+  if (name.empty()) return &frame;
+  auto it = renditions.find(name);
+  if (it == renditions.end() || !it->second) {
+    LOG_FIRST_N(WARNING, kRenditionMissLogNumber) << "Frame rendition [" << name << "] not found in stream "
+                                                  << frame.stream_id << ", the full-resolution frame is used instead";
+    return &frame;
   }
-  if (frame.ctx.dev_type == DevContext::INVALID) {
-    return;
+  return it->second.get();
+}
+
+uint32_t CNFrameInfo::GetStreamWeight() const { return admission_ ? admission_->GetWeight() : 1; }
+
+CNFrameInfo::~CNFrameInfo() {
+  if (admission_) admission_->Release();
+}
+
+class CNFrameInfoPoolPrivate {
+ public:
+  explicit CNFrameInfoPoolPrivate(size_t capacity) : capacity_(capacity) {}
+  ~CNFrameInfoPoolPrivate() {
+    for (auto frame : idle_frames_) delete frame;
   }
-  if (parallelism_ > 0) {
-    CNSpinLockGuard guard(spinlock_);
-    auto iter = stream_count_map_.find(frame.stream_id);
-    if (iter != stream_count_map_.end()) {
-      int count = iter->second;
-      --count;
-      if (count <= 0) {
-        stream_count_map_.erase(iter);
-        // LOG(INFO) << "CNFrameInfo::~CNFrameInfo() erase stream_id " << frame.stream_id;
-      } else {
-        iter->second = count;
-        // LOG(INFO) << "CNFrameInfo::~CNFrameInfo() update stream_id " << frame.stream_id << " : " << count;
+  /* called by the deleter of the frames acquired from the pool */
+  void Recycle(CNFrameInfo* frame) {
+    // the slot is given back after the frame is in the pool, so that the next frame of the stream reuses it
+    std::shared_ptr<CNStreamAdmission> admission = std::move(frame->admission_);
+    frame->Reset();
+    bool kept = false;
+    {
+      CNSpinLockGuard guard(lock_);
+      if (!released_ && idle_frames_.size() < capacity_) {
+        idle_frames_.push_back(frame);
+        kept = true;
       }
-    } else {
-      LOG(ERROR) << "Invaid stream_id, please check\n";
     }
+    if (!kept) delete frame;
+    if (admission) admission->Release();
+  }
+
+  const size_t capacity_;
+  std::vector<CNFrameInfo*> idle_frames_;
+  bool released_ = false;
+  mutable CNSpinLock lock_;
+  std::atomic<uint64_t> hit_count_{0};
+  std::atomic<uint64_t> miss_count_{0};
+};  // class CNFrameInfoPoolPrivate
+
+CNFrameInfoPool::CNFrameInfoPool(size_t capacity) : d_ptr_(std::make_shared<CNFrameInfoPoolPrivate>(capacity)) {
+  d_ptr_->idle_frames_.reserve(capacity);
+}
+
+CNFrameInfoPool::~CNFrameInfoPool() {
+  std::vector<CNFrameInfo*> idle_frames;
+  {
+    CNSpinLockGuard guard(d_ptr_->lock_);
+    d_ptr_->released_ = true;
+    idle_frames.swap(d_ptr_->idle_frames_);
+  }
+  for (auto frame : idle_frames) delete frame;
+}
+
+std::shared_ptr<CNFrameInfo> CNFrameInfoPool::Acquire() {
+  CNFrameInfo* frame = nullptr;
+  {
+    CNSpinLockGuard guard(d_ptr_->lock_);
+    if (!d_ptr_->idle_frames_.empty()) {
+      frame = d_ptr_->idle_frames_.back();
+      d_ptr_->idle_frames_.pop_back();
+    }
+  }
+  if (frame) {
+    d_ptr_->hit_count_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    frame = new (std::nothrow) CNFrameInfo();
+    if (!frame) return nullptr;
+    d_ptr_->miss_count_.fetch_add(1, std::memory_order_relaxed);
   }
+  // the deleter holds the pool data, so the frames can outlive the pool
+  std::shared_ptr<CNFrameInfoPoolPrivate> pool = d_ptr_;
+  return std::shared_ptr<CNFrameInfo>(frame, [pool](CNFrameInfo* released) { pool->Recycle(released); });
+}
+
+size_t CNFrameInfoPool::GetCapacity() const { return d_ptr_->capacity_; }
+
+size_t CNFrameInfoPool::GetIdleNumber() const {
+  CNSpinLockGuard guard(d_ptr_->lock_);
+  return d_ptr_->idle_frames_.size();
+}
+
+uint64_t CNFrameInfoPool::GetHitCount() const { return d_ptr_->hit_count_.load(std::memory_order_relaxed); }
+
+uint64_t CNFrameInfoPool::GetMissCount() const { return d_ptr_->miss_count_.load(std::memory_order_relaxed); }
+
+CNStreamAdmission::CNStreamAdmission(int limit)
+    : limit_(limit), pool_(limit > 0 ? static_cast<size_t>(limit) : kDefaultFramePoolCapacity) {}
+
+void CNStreamAdmission::SetLimit(int limit) {
+  limit_.store(limit);
+  std::lock_guard<std::mutex> lk(mutex_);
+  cond_.notify_all();
+}
+
+bool CNStreamAdmission::TryAcquire() {
+  int inflight = inflight_.load(std::memory_order_relaxed);
+  while (true) {
+    int limit = limit_.load(std::memory_order_relaxed);
+    if (limit > 0 && inflight >= limit) return false;
+    if (inflight_.compare_exchange_weak(inflight, inflight + 1, std::memory_order_acq_rel)) return true;
+  }
+}
+
+bool CNStreamAdmission::Acquire(bool block) {
+  if (closed_.load()) return false;
+  if (TryAcquire()) return true;
+  if (!block) return false;
+  waiters_.fetch_add(1);
+  // pairs with the fence in Release, either the slot released is seen here or the waiter is seen there
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool acquired = false;
+  std::unique_lock<std::mutex> lk(mutex_);
+  cond_.wait(lk, [&] { return closed_.load() || (acquired = TryAcquire()); });
+  waiters_.fetch_sub(1);
+  return acquired;
+}
+
+void CNStreamAdmission::Release() {
+  inflight_.fetch_sub(1, std::memory_order_acq_rel);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // the lock is only taken when the source is waiting for a slot
+  if (waiters_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    cond_.notify_one();
+  }
+}
+
+void CNStreamAdmission::Close() {
+  closed_.store(true);
+  std::lock_guard<std::mutex> lk(mutex_);
+  cond_.notify_all();
 }
 
 }  // namespace cnstream
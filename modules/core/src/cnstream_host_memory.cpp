@@ -0,0 +1,325 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <glog/logging.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "cnstream_affinity.hpp"
+#include "cnstream_common.hpp"
+#include "cnstream_syncmem.hpp"
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+namespace cnstream {
+
+/*
+  The memory allocated by CNStreamMallocHost is preceded by a header of kHostMemAlignment bytes, so that the data
+  is 64-byte aligned. The blocks from kMinPooledSize to kMaxPooledSize bytes (header included) are rounded up to size
+  classes, mapped with mmap and kept in the pool after they are freed, first in the cache of the freeing thread and
+  then in the shared free lists. The other blocks are allocated and freed directly.
+ */
+static constexpr size_t kHostMemAlignment = 64;
+static constexpr size_t kMinPooledSize = 64 * 1024;
+static constexpr size_t kMaxPooledSize = 64 * 1024 * 1024;
+static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+static constexpr int kSizeClassesPerDoubling = 4;
+static constexpr size_t kThreadCacheBlocks = 2;                   // per size class
+static constexpr size_t kThreadCacheBytes = 32 * 1024 * 1024;     // per thread
+static constexpr size_t kDefaultCacheLimit = 512 * 1024 * 1024;  // shared free lists
+static constexpr uint32_t kHostMemMagic = 0x434e484d;
+
+struct HostBlockHeader {
+  uint32_t magic;
+  int32_t size_class;   // -1 if the block is not pooled
+  int32_t node;         // the numa node the block is bound to, -1 if not bound
+  size_t size;          // the bytes of the block, header included
+  size_t mapped_bytes;  // the bytes mapped by mmap, 0 if the block is allocated by posix_memalign
+};
+static_assert(sizeof(HostBlockHeader) <= kHostMemAlignment, "host memory header is too large");
+
+class HostMemoryPool {
+ public:
+  static HostMemoryPool* Instance() {
+    // never destroyed, the thread caches are flushed into it when the threads exit
+    static HostMemoryPool* pool = new HostMemoryPool();
+    return pool;
+  }
+
+  void* Malloc(size_t size);
+  void Free(void* ptr);
+  CNHostMemoryStats GetStats() const;
+  void SetHugePages(bool enable) { huge_pages_.store(enable); }
+  void SetCacheLimit(size_t bytes) { cache_limit_.store(bytes); }
+  void ReleaseCache();
+
+  int GetSizeClass(size_t bytes) const {
+    if (bytes < kMinPooledSize || bytes > kMaxPooledSize) return -1;
+    return std::lower_bound(class_sizes_.begin(), class_sizes_.end(), bytes) - class_sizes_.begin();
+  }
+  size_t GetClassNumber() const { return class_sizes_.size(); }
+  /* puts a free block to the shared free lists, or unmaps it if the pool exceeds the cache limit */
+  void Recycle(HostBlockHeader* block);
+
+ private:
+  HostMemoryPool() {
+    for (size_t base = kMinPooledSize; base < kMaxPooledSize; base *= 2) {
+      for (int i = 0; i < kSizeClassesPerDoubling; ++i) {
+        class_sizes_.push_back(base + base / kSizeClassesPerDoubling * i);
+      }
+    }
+    class_sizes_.push_back(kMaxPooledSize);
+    free_lists_.resize(class_sizes_.size());
+  }
+  HostBlockHeader* Map(size_t bytes, int size_class, int node);
+  void Unmap(HostBlockHeader* block);
+  void AddInUse(size_t bytes) {
+    size_t in_use = in_use_bytes_.fetch_add(bytes) + bytes;
+    size_t high_water = high_water_bytes_.load();
+    while (in_use > high_water && !high_water_bytes_.compare_exchange_weak(high_water, in_use)) {
+    }
+  }
+
+  std::vector<size_t> class_sizes_;
+  std::vector<std::vector<HostBlockHeader*>> free_lists_;
+  std::mutex mutex_;
+  std::atomic<bool> huge_pages_{false};
+  std::atomic<size_t> cache_limit_{kDefaultCacheLimit};
+  std::atomic<size_t> in_use_bytes_{0};
+  std::atomic<size_t> high_water_bytes_{0};
+  std::atomic<size_t> cached_bytes_{0};
+  std::atomic<size_t> shared_cached_bytes_{0};
+  std::atomic<uint64_t> hit_count_{0};
+  std::atomic<uint64_t> miss_count_{0};
+
+  friend class HostThreadCache;
+};  // class HostMemoryPool
+
+/* the free blocks kept by a thread, taken without locking */
+class HostThreadCache {
+ public:
+  HostThreadCache() : blocks_(HostMemoryPool::Instance()->GetClassNumber()) {}
+  ~HostThreadCache();
+  HostBlockHeader* Pop(int size_class, int node) {
+    auto& blocks = blocks_[size_class];
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+      if ((*it)->node != node) continue;
+      HostBlockHeader* block = *it;
+      blocks.erase(std::next(it).base());
+      bytes_ -= block->mapped_bytes;
+      return block;
+    }
+    return nullptr;
+  }
+  bool Push(HostBlockHeader* block) {
+    auto& blocks = blocks_[block->size_class];
+    if (blocks.size() >= kThreadCacheBlocks || bytes_ + block->mapped_bytes > kThreadCacheBytes) return false;
+    blocks.push_back(block);
+    bytes_ += block->mapped_bytes;
+    return true;
+  }
+
+ private:
+  std::vector<std::vector<HostBlockHeader*>> blocks_;
+  size_t bytes_ = 0;
+};  // class HostThreadCache
+
+static thread_local bool tls_cache_destroyed = false;
+
+static HostThreadCache* GetThreadCache() {
+  if (tls_cache_destroyed) return nullptr;
+  static thread_local HostThreadCache cache;
+  return &cache;
+}
+
+HostThreadCache::~HostThreadCache() {
+  tls_cache_destroyed = true;
+  HostMemoryPool* pool = HostMemoryPool::Instance();
+  for (auto& blocks : blocks_) {
+    for (auto block : blocks) {
+      pool->cached_bytes_.fetch_sub(block->mapped_bytes);
+      pool->Recycle(block);
+    }
+  }
+}
+
+HostBlockHeader* HostMemoryPool::Map(size_t bytes, int size_class, int node) {
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t mapped_bytes = (bytes + page_size - 1) / page_size * page_size;
+  void* addr = MAP_FAILED;
+  bool huge_pages = huge_pages_.load() && mapped_bytes >= kHugePageSize;
+  if (huge_pages) {
+    size_t huge_bytes = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    addr = mmap(nullptr, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != addr) mapped_bytes = huge_bytes;
+  }
+  if (MAP_FAILED == addr) {
+    addr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == addr) return nullptr;
+#ifdef MADV_HUGEPAGE
+    // no huge pages reserved, fall back on transparent huge pages
+    if (huge_pages) madvise(addr, mapped_bytes, MADV_HUGEPAGE);
+#endif
+  }
+  // place the pages on the numa node of the calling thread before they are touched
+  if (node >= 0) BindHostMemory(addr, mapped_bytes, node);
+  HostBlockHeader* block = reinterpret_cast<HostBlockHeader*>(addr);
+  block->magic = kHostMemMagic;
+  block->size_class = size_class;
+  block->node = node;
+  block->size = size_class >= 0 ? class_sizes_[size_class] : bytes;
+  block->mapped_bytes = mapped_bytes;
+  return block;
+}
+
+void HostMemoryPool::Unmap(HostBlockHeader* block) {
+  block->magic = 0;
+  munmap(block, block->mapped_bytes);
+}
+
+void* HostMemoryPool::Malloc(size_t size) {
+  const size_t bytes = size + kHostMemAlignment;
+  const int node = GetThreadMemoryNode();
+  const int size_class = GetSizeClass(bytes);
+  HostBlockHeader* block = nullptr;
+  if (size_class >= 0) {
+    HostThreadCache* cache = GetThreadCache();
+    if (cache) block = cache->Pop(size_class, node);
+    if (!block) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      auto& blocks = free_lists_[size_class];
+      for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+        if ((*it)->node != node) continue;
+        block = *it;
+        blocks.erase(std::next(it).base());
+        shared_cached_bytes_.fetch_sub(block->mapped_bytes);
+        break;
+      }
+    }
+    if (block) {
+      cached_bytes_.fetch_sub(block->mapped_bytes);
+      hit_count_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      block = Map(class_sizes_[size_class], size_class, node);
+      if (!block) return nullptr;
+      miss_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+  } else if (bytes > kMaxPooledSize) {
+    block = Map(bytes, -1, node);
+    if (!block) return nullptr;
+  } else {
+    void* addr = nullptr;
+    if (0 != posix_memalign(&addr, kHostMemAlignment, bytes)) return nullptr;
+    block = reinterpret_cast<HostBlockHeader*>(addr);
+    block->magic = kHostMemMagic;
+    block->size_class = -1;
+    block->node = -1;
+    block->size = bytes;
+    block->mapped_bytes = 0;
+  }
+  AddInUse(block->size);
+  return reinterpret_cast<uint8_t*>(block) + kHostMemAlignment;
+}
+
+void HostMemoryPool::Free(void* ptr) {
+  HostBlockHeader* block = reinterpret_cast<HostBlockHeader*>(reinterpret_cast<uint8_t*>(ptr) - kHostMemAlignment);
+  LOG_IF(FATAL, kHostMemMagic != block->magic) << "CNStreamFreeHost: the memory is not allocated by CNStreamMallocHost";
+  in_use_bytes_.fetch_sub(block->size);
+  if (block->size_class < 0) {
+    if (block->mapped_bytes) {
+      Unmap(block);
+    } else {
+      block->magic = 0;
+      free(block);
+    }
+    return;
+  }
+  cached_bytes_.fetch_add(block->mapped_bytes);
+  HostThreadCache* cache = GetThreadCache();
+  if (cache && cache->Push(block)) return;
+  cached_bytes_.fetch_sub(block->mapped_bytes);
+  Recycle(block);
+}
+
+void HostMemoryPool::Recycle(HostBlockHeader* block) {
+  if (shared_cached_bytes_.load() + block->mapped_bytes <= cache_limit_.load()) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    free_lists_[block->size_class].push_back(block);
+    shared_cached_bytes_.fetch_add(block->mapped_bytes);
+    cached_bytes_.fetch_add(block->mapped_bytes);
+    return;
+  }
+  Unmap(block);
+}
+
+void HostMemoryPool::ReleaseCache() {
+  std::vector<HostBlockHeader*> released;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto& blocks : free_lists_) {
+      released.insert(released.end(), blocks.begin(), blocks.end());
+      blocks.clear();
+    }
+  }
+  for (auto block : released) {
+    shared_cached_bytes_.fetch_sub(block->mapped_bytes);
+    cached_bytes_.fetch_sub(block->mapped_bytes);
+    Unmap(block);
+  }
+}
+
+CNHostMemoryStats HostMemoryPool::GetStats() const {
+  CNHostMemoryStats stats;
+  stats.in_use_bytes = in_use_bytes_.load();
+  stats.high_water_bytes = high_water_bytes_.load();
+  stats.cached_bytes = cached_bytes_.load();
+  stats.hit_count = hit_count_.load();
+  stats.miss_count = miss_count_.load();
+  return stats;
+}
+
+void CNStreamMallocHost(void** ptr, size_t size) {
+  void* __ptr = HostMemoryPool::Instance()->Malloc(size);
+  LOG_IF(FATAL, nullptr == __ptr) << "Malloc memory on CPU failed, malloc size:" << size;
+  *ptr = __ptr;
+}
+
+void CNStreamFreeHost(void* ptr) {
+  if (nullptr == ptr) return;
+  HostMemoryPool::Instance()->Free(ptr);
+}
+
+CNHostMemoryStats GetHostMemoryStats() { return HostMemoryPool::Instance()->GetStats(); }
+
+void SetHostMemoryHugePages(bool enable) { HostMemoryPool::Instance()->SetHugePages(enable); }
+
+void SetHostMemoryCacheLimit(size_t bytes) { HostMemoryPool::Instance()->SetCacheLimit(bytes); }
+
+void ReleaseHostMemoryCache() { HostMemoryPool::Instance()->ReleaseCache(); }
+
+}  // namespace cnstream
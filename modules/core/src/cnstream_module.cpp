@@ -19,45 +19,16 @@
  *************************************************************************/
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "cnstream_affinity.hpp"
 #include "cnstream_eventbus.hpp"
 #include "cnstream_module.hpp"
 #include "cnstream_pipeline.hpp"
 
 namespace cnstream {
 
-CNSpinLock Module::module_id_spinlock_;
-uint64_t Module::module_id_mask_ = 0;
-
-uint32_t GetMaxModuleNumber() {
-  /*maxModuleIdNum is sizeof(module_id_mask_) * 8  (bytes->bits)*/
-  return sizeof(uint64_t) * 8;
-}
-
-size_t Module::GetId() {
-  CNSpinLockGuard guard(module_id_spinlock_);
-  if (id_ != INVALID_MODULE_ID) {
-    return id_;
-  }
-  for (size_t i = 0; i < sizeof(module_id_mask_) * 8; i++) {
-    if (!(module_id_mask_ & ((uint64_t)1 << i))) {
-      module_id_mask_ |= (uint64_t)1 << i;
-      id_ = i;
-      return i;
-    }
-  }
-  id_ = INVALID_MODULE_ID;
-  return INVALID_MODULE_ID;
-}
-
-void Module::ReturnId() {
-  CNSpinLockGuard guard(module_id_spinlock_);
-  if (id_ < 0 || id_ >= sizeof(module_id_mask_) * 8) {
-    return;
-  }
-  module_id_mask_ &= ~(1 << id_);
-  id_ = INVALID_MODULE_ID;
-}
+uint32_t GetMaxModuleNumber() { return 4096; }
 
 bool Module::PostEvent(EventType type, const std::string& msg) const {
   Event event;
@@ -72,6 +43,29 @@ bool Module::PostEvent(EventType type, const std::string& msg) const {
   }
 }
 
+void Module::SetAffinity(const std::vector<int>& cpus, int numa_node) {
+  cpu_affinity_ = cpus;
+  numa_node_ = numa_node;
+}
+
+bool Module::BindThread(uint32_t stream_idx) const {
+  int node = numa_node_;
+  if (container_ && container_->GetStreamNumaPlacement() && stream_idx != INVALID_STREAM_IDX) {
+    node = GetStreamNumaNode(stream_idx);
+  }
+  SetThreadMemoryNode(node);
+  if (!cpu_affinity_.empty()) {
+    return SetThreadAffinity(cpu_affinity_);
+  }
+  if (node < 0) return false;
+  std::vector<int> cpus = GetNumaNodeCpus(node);
+  if (cpus.empty()) {
+    LOG(WARNING) << "[" << GetName() << "] numa node " << node << " has no cpus";
+    return false;
+  }
+  return SetThreadAffinity(cpus);
+}
+
 int Module::DoProcess(std::shared_ptr<CNFrameInfo> data) {
   if (!HasTransmit()) {
     if (!isSource_) fps_stat_.Update(data);
@@ -80,6 +74,22 @@ int Module::DoProcess(std::shared_ptr<CNFrameInfo> data) {
   return Process(data);
 }
 
+int Module::DoProcessBatch(std::vector<std::shared_ptr<CNFrameInfo>>& data) {
+  if (!HasTransmit() && !isSource_) {
+    for (auto& it : data) fps_stat_.Update(it);
+  }
+  return ProcessBatch(data);
+}
+
+int Module::ProcessBatch(std::vector<std::shared_ptr<CNFrameInfo>>& data) {
+  int ret = 0;
+  for (auto& it : data) {
+    ret = Process(it);
+    if (ret < 0) return ret;
+  }
+  return ret;
+}
+
 bool Module::TransmitData(std::shared_ptr<CNFrameInfo> data) {
   if (HasTransmit()) {
     if (container_) {
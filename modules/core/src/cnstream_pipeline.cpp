@@ -24,12 +24,14 @@
 #include <rapidjson/writer.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <thread>
@@ -37,12 +39,16 @@
 #include <utility>
 #include <vector>
 
+#include "cnstream_affinity.hpp"
 #include "cnstream_module.hpp"
 #include "cnstream_pipeline.hpp"
 #include "cnstream_timer.hpp"
 #include "connector.hpp"
 #include "conveyor.hpp"
+#include "conveyor_assigner.hpp"
+#include "reorder_buffer.hpp"
 #include "threadsafe_queue.hpp"
+#include "work_stealing_executor.hpp"
 
 namespace cnstream {
 
@@ -91,6 +97,114 @@ bool CNModuleConfig::ParseByJSONStr(const std::string& jstr) {
     this->maxInputQueueSize = 20;
   }
 
+  // inputQueueType
+  if (end != doc.FindMember("input_queue_type")) {
+    if (!doc["input_queue_type"].IsString()) {
+      LOG(ERROR) << "input_queue_type must be string type.";
+      return false;
+    }
+    std::string queue_type = doc["input_queue_type"].GetString();
+    if (queue_type == "mutex") {
+      this->inputQueueType = QUEUE_MUTEX;
+    } else if (queue_type == "lockfree") {
+      this->inputQueueType = QUEUE_LOCKFREE;
+    } else if (queue_type == "fair") {
+      this->inputQueueType = QUEUE_FAIR;
+    } else {
+      LOG(ERROR) << "input_queue_type must be \"mutex\", \"lockfree\" or \"fair\", got: " << queue_type;
+      return false;
+    }
+  } else {
+    this->inputQueueType = QUEUE_MUTEX;
+  }
+
+  // inputQueueBlockTimeout
+  if (end != doc.FindMember("input_queue_block_timeout_ms")) {
+    if (!doc["input_queue_block_timeout_ms"].IsUint()) {
+      LOG(ERROR) << "input_queue_block_timeout_ms must be uint type.";
+      return false;
+    }
+    this->inputQueueBlockTimeout = doc["input_queue_block_timeout_ms"].GetUint();
+  } else {
+    this->inputQueueBlockTimeout = 0;
+  }
+
+  // cpuAffinity
+  this->cpuAffinity.clear();
+  if (end != doc.FindMember("cpu_affinity")) {
+    if (!doc["cpu_affinity"].IsArray()) {
+      LOG(ERROR) << "cpu_affinity must be array type.";
+      return false;
+    }
+    auto values = doc["cpu_affinity"].GetArray();
+    for (auto iter = values.begin(); iter != values.end(); ++iter) {
+      if (!iter->IsUint()) {
+        LOG(ERROR) << "cpu_affinity must be an array of uint.";
+        return false;
+      }
+      this->cpuAffinity.push_back(iter->GetUint());
+    }
+  }
+
+  // numaNode
+  if (end != doc.FindMember("numa_node")) {
+    if (!doc["numa_node"].IsInt()) {
+      LOG(ERROR) << "numa_node must be int type.";
+      return false;
+    }
+    this->numaNode = doc["numa_node"].GetInt();
+    if (this->numaNode >= GetNumaNodeCount()) {
+      LOG(ERROR) << "numa_node must be less than the number of numa nodes: " << GetNumaNodeCount();
+      return false;
+    }
+  } else {
+    this->numaNode = -1;
+  }
+
+  // maxBatch
+  if (end != doc.FindMember("max_batch")) {
+    if (!doc["max_batch"].IsUint() || 0 == doc["max_batch"].GetUint()) {
+      LOG(ERROR) << "max_batch must be uint type and greater than 0.";
+      return false;
+    }
+    this->maxBatch = doc["max_batch"].GetUint();
+  } else {
+    this->maxBatch = 1;
+  }
+
+  // maxWaitUs
+  if (end != doc.FindMember("max_wait_us")) {
+    if (!doc["max_wait_us"].IsUint()) {
+      LOG(ERROR) << "max_wait_us must be uint type.";
+      return false;
+    }
+    this->maxWaitUs = doc["max_wait_us"].GetUint();
+  } else {
+    this->maxWaitUs = 0;
+  }
+
+  // enableFusion
+  if (end != doc.FindMember("enable_fusion")) {
+    if (!doc["enable_fusion"].IsBool()) {
+      LOG(ERROR) << "enable_fusion must be Boolean type.";
+      return false;
+    }
+    this->enableFusion = doc["enable_fusion"].GetBool();
+  } else {
+    this->enableFusion = true;
+  }
+
+  // frameParallel
+  if (end != doc.FindMember("frame_parallel")) {
+    if (!doc["frame_parallel"].IsBool()) {
+      LOG(ERROR) << "frame_parallel must be Boolean type.";
+      return false;
+    }
+    this->frameParallel = doc["frame_parallel"].GetBool();
+  } else {
+    this->frameParallel = false;
+  }
+
   // enablePerfInfo
   if (end != doc.FindMember("show_perf_info")) {
     if (!doc["show_perf_info"].IsBool()) {
@@ -183,13 +297,59 @@ bool CNModuleConfig::ParseByJSONFile(const std::string& jfname) {
   return true;
 }
 
+struct ModuleAssociatedInfo;
+
+/* only one of this many frames dropped by a full input queue is logged */
+static const uint64_t kDropLogInterval = 100;
+
+/* the time in microseconds elapsed since start */
+static uint64_t GetElapsedUs(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+  An input conveyor of a module, it is the task unit of the work-stealing executor.
+  state: IDLE -> SCHEDULED when data is pushed, SCHEDULED -> RUNNING when a worker picks it up,
+  RUNNING -> IDLE when the worker has processed a batch of data.
+ */
+struct ConveyorTask {
+  enum State { IDLE = 0, SCHEDULED, RUNNING };
+  std::string node_name;
+  ModuleAssociatedInfo* module_info = nullptr;
+  Conveyor* conveyor = nullptr;
+  std::atomic<int> state{IDLE};
+  /* the module failed to process data, stop processing like TaskLoop does */
+  std::atomic<bool> failed{false};
+};
+
+/*
+  A link to a downstream module, compiled when the modules are linked, so that transmitting data needs no lookup
+  by module name.
+ */
+struct DownRoute {
+  const std::string* node_name = nullptr;  // the key of the downstream module in PipelinePrivate::modules_
+  ModuleAssociatedInfo* module_info = nullptr;
+  Module* instance = nullptr;
+  /* the bit of the upstream module in the mask of the downstream module, see Module::GetParentMask */
+  uint64_t parent_mask = 0;
+};
+
 struct ModuleAssociatedInfo {
   std::shared_ptr<Module> instance;
   uint32_t parallelism = 0;
   std::shared_ptr<Connector> connector;
   std::set<std::string> down_nodes;
+  std::vector<DownRoute> down_routes;
   std::vector<std::string> input_connectors;
   std::vector<std::string> output_connectors;
+  std::vector<ConveyorTask*> conveyor_tasks;
+  uint32_t max_batch = 1;
+  uint32_t max_wait_us = 0;
+  bool fusion_enabled = true;
+  /* processes data inline in the threads of the only upstream module, decided when the pipeline starts */
+  bool fused = false;
+  /* set when the frames of a stream are spread over all conveyors, see Pipeline::SetModuleFrameParallel */
+  std::shared_ptr<ReorderBuffer> reorder_buffer;
 };
 
 StreamMsgObserver::~StreamMsgObserver() {}
@@ -202,6 +362,7 @@ class PipelinePrivate {
     smsg_thread_ = std::thread(&PipelinePrivate::StreamMsgHandleFunc, this);
   }
   ~PipelinePrivate() {
+    DestroyConveyorTasks();
     exit_msg_loop_ = true;
     if (smsg_thread_.joinable()) smsg_thread_.join();
   }
@@ -209,21 +370,69 @@ class PipelinePrivate {
   std::vector<std::thread> threads_;
   std::thread event_thread_;
   std::map<std::string, ModuleAssociatedInfo> modules_;
+  /* the modules indexed by module id, see Module::GetId */
+  std::vector<ModuleAssociatedInfo*> module_slots_;
   std::mutex stop_mtx_;
-  uint64_t eos_mask_ = 0;
+  PipelineExecutorType executor_type_ = EXECUTOR_THREAD_PER_CONVEYOR;
+  uint32_t executor_thread_num_ = 0;
+  std::unique_ptr<WorkStealingExecutor> executor_;
+  std::vector<std::unique_ptr<ConveyorTask>> conveyor_tasks_;
+  ConveyorAssignPolicy assign_policy_ = ASSIGN_BY_STREAM_INDEX;
+  bool stream_numa_placement_ = false;
+  std::atomic<uint32_t> max_frame_age_ms_{0};
+  /* the number of the stale frames dropped, by module name and stream id */
+  mutable std::mutex stale_mtx_;
+  std::map<std::string, std::map<std::string, uint64_t>> stale_counts_;
 
  private:
   std::unordered_map<std::string, CNModuleConfig> modules_config_;
   std::unordered_map<std::string, std::vector<std::string>> connections_config_;
   std::map<std::string, std::shared_ptr<Module>> modules_map_;
   DECLARE_PUBLIC(q_ptr_, Pipeline);
-  void SetEOSMask() {
-    for (const std::pair<std::string, ModuleAssociatedInfo> module_info : modules_) {
-      auto instance = module_info.second.instance;
-      eos_mask_ |= (uint64_t)1 << instance->GetId();
-    }
+
+  /* transmits data to the downstream modules by the routes of the module */
+  bool TransmitData(const ModuleAssociatedInfo& module_info, std::shared_ptr<CNFrameInfo> data);
+  bool ProcessData(const std::string& node_name, ModuleAssociatedInfo* module_info,
+                   std::shared_ptr<CNFrameInfo> data);
+  /* processes data by Module::ProcessBatch, EOS data are processed one by one by ProcessData */
+  bool ProcessDataBatch(const std::string& node_name, ModuleAssociatedInfo* module_info,
+                        std::vector<std::shared_ptr<CNFrameInfo>>* batch);
+  bool ProcessFrames(const std::string& node_name, ModuleAssociatedInfo* module_info,
+                     std::vector<std::shared_ptr<CNFrameInfo>>* frames);
+  void OnProcessFailed(ModuleAssociatedInfo* module_info, int ret,
+                       const std::vector<std::shared_ptr<CNFrameInfo>>& frames);
+  /* transmits the data processed or dropped by a module, in the order they were dispatched with frame parallelism */
+  bool EmitData(ModuleAssociatedInfo* module_info, const std::shared_ptr<CNFrameInfo>& data, bool dropped = false);
+
+  /*
+    stale frames
+   */
+  bool IsStale(const std::shared_ptr<CNFrameInfo>& data) const;
+  void CountStaleFrame(const std::string& node_name, const std::shared_ptr<CNFrameInfo>& data);
+
+  /*
+    stream assignment, the stream is released after its eos is transmitted, so that the data of the stream added
+    again never overtake the eos in the downstream modules
+   */
+  void ReleaseStreamConveyor(ModuleAssociatedInfo* module_info, const std::shared_ptr<CNFrameInfo>& data) {
+    if (module_info->connector) module_info->connector->GetAssigner()->Release(data->channel_idx);
   }
-  void ClearEOSMask() { eos_mask_ = 0; }
+
+  /*
+    module fusion
+   */
+  void FuseModules();
+
+  /*
+    work-stealing executor
+   */
+  void CreateConveyorTasks();
+  void DestroyConveyorTasks();
+  void ScheduleConveyorTask(ConveyorTask* task);
+  void RunScheduledConveyorTask(ConveyorTask* task);
+  bool TryRunConveyorTask(ConveyorTask* task);
+  void RunClaimedConveyorTask(ConveyorTask* task);
+  bool PushToConveyorTask(ConveyorTask* task, std::shared_ptr<CNFrameInfo> data);
 
   /*
     stream message
@@ -279,6 +488,10 @@ Pipeline::Pipeline(const std::string& name) : Module(name) {
 
 Pipeline::~Pipeline() {
   running_ = false;
+  for (auto& it : d_ptr_->modules_) {
+    it.second.instance->SetContainer(nullptr);
+    it.second.instance->SetId(INVALID_MODULE_ID);
+  }
   delete event_bus_;
   delete d_ptr_;
 }
@@ -329,11 +542,13 @@ EventHandleFlag Pipeline::DefaultBusWatch(const Event& event, Module* module) {
 }
 
 bool Pipeline::ProvideData(const Module* module, std::shared_ptr<CNFrameInfo> data) {
-  std::string moduleName = module->GetName();
+  const size_t module_id = module->GetId();
 
-  if (d_ptr_->modules_.find(moduleName) == d_ptr_->modules_.end()) return false;
+  if (module_id >= d_ptr_->module_slots_.size() || d_ptr_->module_slots_[module_id]->instance.get() != module) {
+    return false;
+  }
 
-  TransmitData(moduleName, data);
+  d_ptr_->TransmitData(*d_ptr_->module_slots_[module_id], data);
 
   return true;
 }
@@ -346,29 +561,40 @@ bool Pipeline::AddModule(std::shared_ptr<Module> module) {
     return false;
   }
 
-  LOG(INFO) << "Add Module " << module->GetName() << " to pipeline";
-  if (module->GetId() == INVALID_MODULE_ID) {
-    LOG(ERROR) << "Failed to get module Id";
+  if (module->GetId() != INVALID_MODULE_ID) {
+    LOG(ERROR) << "Module [" << module->GetName() << "] has already been added to another pipeline";
     return false;
   }
+  if (d_ptr_->modules_.size() >= GetMaxModuleNumber()) {
+    LOG(ERROR) << "Failed to add module [" << module->GetName() << "], the pipeline could contain no more than "
+               << GetMaxModuleNumber() << " modules";
+    return false;
+  }
+
+  LOG(INFO) << "Add Module " << module->GetName() << " to pipeline";
+  module->SetId(d_ptr_->modules_.size());
 
   ModuleAssociatedInfo associated_info;
   associated_info.instance = module;
   associated_info.parallelism = 1;
   associated_info.connector = std::make_shared<Connector>(associated_info.parallelism);
   module->SetContainer(this);
-  d_ptr_->modules_.insert(std::make_pair(moduleName, associated_info));
+  auto iter = d_ptr_->modules_.insert(std::make_pair(moduleName, associated_info)).first;
+  d_ptr_->module_slots_.push_back(&iter->second);
 
   return true;
 }
 
-bool Pipeline::SetModuleAttribute(std::shared_ptr<Module> module, uint32_t parallelism, size_t queue_capacity) {
+bool Pipeline::SetModuleAttribute(std::shared_ptr<Module> module, uint32_t parallelism, size_t queue_capacity,
+                                  ConveyorQueueType queue_type, uint32_t block_timeout_ms) {
   std::string moduleName = module->GetName();
   if (d_ptr_->modules_.find(moduleName) == d_ptr_->modules_.end()) return false;
   d_ptr_->modules_[moduleName].parallelism = parallelism;
   if (parallelism && queue_capacity) {
-    d_ptr_->modules_[moduleName].connector = std::make_shared<Connector>(parallelism, queue_capacity);
-    return static_cast<bool>(d_ptr_->modules_[moduleName].connector);
+    d_ptr_->modules_[moduleName].connector = std::make_shared<Connector>(parallelism, queue_capacity, queue_type);
+    if (!d_ptr_->modules_[moduleName].connector) return false;
+    d_ptr_->modules_[moduleName].connector->SetBlockTimeout(block_timeout_ms);
+    return true;
   }
   if (!parallelism && d_ptr_->modules_[moduleName].connector) {
     d_ptr_->modules_[moduleName].connector.reset();
@@ -382,6 +608,46 @@ uint32_t Pipeline::GetModuleParallelism(std::shared_ptr<Module> module) {
   return d_ptr_->modules_[moduleName].parallelism;
 }
 
+bool Pipeline::SetModuleFusion(std::shared_ptr<Module> module, bool enable) {
+  std::string moduleName = module->GetName();
+  if (d_ptr_->modules_.find(moduleName) == d_ptr_->modules_.end()) return false;
+  d_ptr_->modules_[moduleName].fusion_enabled = enable;
+  return true;
+}
+
+bool Pipeline::SetModuleFrameParallel(std::shared_ptr<Module> module, bool enable) {
+  std::string moduleName = module->GetName();
+  if (d_ptr_->modules_.find(moduleName) == d_ptr_->modules_.end()) return false;
+  if (IsRunning()) {
+    LOG(ERROR) << "Frame parallelism can not be changed while the pipeline is running, module: " << moduleName;
+    return false;
+  }
+  if (enable && module->HasTransmit()) {
+    LOG(ERROR) << "Frame parallelism is not supported by the modules transmitting data by themselves, module: "
+               << moduleName;
+    return false;
+  }
+  std::shared_ptr<ReorderBuffer>& reorder_buffer = d_ptr_->modules_[moduleName].reorder_buffer;
+  if (!enable) {
+    reorder_buffer.reset();
+  } else if (!reorder_buffer) {
+    reorder_buffer = std::make_shared<ReorderBuffer>();
+  }
+  return true;
+}
+
+bool Pipeline::SetModuleBatchAttribute(std::shared_ptr<Module> module, uint32_t max_batch, uint32_t max_wait_us) {
+  std::string moduleName = module->GetName();
+  if (d_ptr_->modules_.find(moduleName) == d_ptr_->modules_.end()) return false;
+  if (!max_batch) {
+    LOG(ERROR) << "max_batch must be greater than 0, module: " << moduleName;
+    return false;
+  }
+  d_ptr_->modules_[moduleName].max_batch = max_batch;
+  d_ptr_->modules_[moduleName].max_wait_us = max_wait_us;
+  return true;
+}
+
 std::string Pipeline::LinkModules(std::shared_ptr<Module> up_node, std::shared_ptr<Module> down_node) {
   if (up_node == nullptr || down_node == nullptr) {
     return "";
@@ -404,11 +670,16 @@ std::string Pipeline::LinkModules(std::shared_ptr<Module> up_node, std::shared_p
     LOG(ERROR) << "connector is invalid when linking " << link_id;
     return "";
   }
-  auto ret = up_node_info.down_nodes.insert(down_node_name);
-  if (!ret.second) {
+  if (up_node_info.down_nodes.count(down_node_name)) {
     LOG(ERROR) << "modules have been linked already";
     return link_id;
   }
+  if (down_node->GetParentIds().size() >= MAX_UPSTREAM_MODULE_NUM) {
+    LOG(ERROR) << "Link " << link_id << " failed, a module could have no more than " << MAX_UPSTREAM_MODULE_NUM
+               << " upstream modules";
+    return "";
+  }
+  up_node_info.down_nodes.insert(down_node_name);
 
   LOG(INFO) << "Link Module " << link_id;
 
@@ -418,6 +689,12 @@ std::string Pipeline::LinkModules(std::shared_ptr<Module> up_node, std::shared_p
   d_ptr_->links_[link_id] = down_node_info.connector;
 
   down_node->SetParentId(up_node->GetId());
+  DownRoute route;
+  route.node_name = &d_ptr_->modules_.find(down_node_name)->first;
+  route.module_info = &down_node_info;
+  route.instance = down_node.get();
+  route.parent_mask = down_node->GetParentMask(up_node->GetId());
+  up_node_info.down_routes.push_back(route);
   return link_id;
 }
 
@@ -432,15 +709,23 @@ bool Pipeline::QueryLinkStatus(LinkStatus* status, const std::string& link_id) {
     return false;
   }
   status->stopped = con->IsStopped();
+  status->cache_size.clear();
+  status->push_blocked_time.clear();
+  status->pop_blocked_time.clear();
+  status->push_timeout_count.clear();
+  status->process_time.clear();
   for (uint32_t i = 0; i < con->GetConveyorCount(); ++i) {
-    status->cache_size.emplace_back(con->GetConveyor(i)->GetBufferSize());
+    Conveyor* conveyor = con->GetConveyor(i);
+    status->cache_size.emplace_back(conveyor->GetBufferSize());
+    status->push_blocked_time.emplace_back(conveyor->GetPushBlockedTime());
+    status->pop_blocked_time.emplace_back(conveyor->GetPopBlockedTime());
+    status->push_timeout_count.emplace_back(conveyor->GetPushTimeoutCount());
+    status->process_time.emplace_back(conveyor->GetProcessTime());
   }
   return true;
 }
 
 bool Pipeline::Start() {
-  // set eos mask
-  d_ptr_->SetEOSMask();
   // open modules
   std::vector<std::shared_ptr<Module>> opened_modules;
   bool open_module_failed = false;
@@ -456,7 +741,6 @@ bool Pipeline::Start() {
 
   if (open_module_failed) {
     for (auto it : opened_modules) it->Close();
-    d_ptr_->ClearEOSMask();
     return false;
   }
 
@@ -467,10 +751,14 @@ bool Pipeline::Start() {
 
   for (const std::pair<std::string, ModuleAssociatedInfo>& it : d_ptr_->modules_) {
     if (it.second.connector) {
+      it.second.connector->GetAssigner()->SetPolicy(d_ptr_->assign_policy_);
+      it.second.connector->GetAssigner()->SetStreamNumaPlacement(d_ptr_->stream_numa_placement_);
       it.second.connector->Start();
     }
   }
 
+  d_ptr_->FuseModules();
+
   // create process threads
   for (auto& it : d_ptr_->modules_) {
     const std::string node_name = it.first;
@@ -482,12 +770,26 @@ bool Pipeline::Start() {
                 << module_info.instance->GetName();
       return false;
     }
+    if (d_ptr_->stream_numa_placement_ && parallelism % GetNumaNodeCount()) {
+      LOG(WARNING) << "Module parallelism is not a multiple of the numa node number " << GetNumaNodeCount()
+                   << ", streams of different numa nodes are mixed in the conveyors, name: "
+                   << module_info.instance->GetName();
+    }
+    if (EXECUTOR_WORK_STEALING == d_ptr_->executor_type_ || module_info.fused) continue;
     for (uint32_t conveyor_idx = 0; conveyor_idx < parallelism; ++conveyor_idx) {
       d_ptr_->threads_.push_back(std::thread(&Pipeline::TaskLoop, this, node_name, conveyor_idx));
     }
   }
+  d_ptr_->DestroyConveyorTasks();
+  if (EXECUTOR_WORK_STEALING == d_ptr_->executor_type_) {
+    d_ptr_->CreateConveyorTasks();
+  }
   LOG(INFO) << "Pipeline Start";
-  LOG(INFO) << "Total Module's threads :" << d_ptr_->threads_.size();
+  if (d_ptr_->executor_) {
+    LOG(INFO) << "Total Module's threads :" << d_ptr_->executor_->GetThreadNum() << " (work-stealing)";
+  } else {
+    LOG(INFO) << "Total Module's threads :" << d_ptr_->threads_.size();
+  }
   return true;
 }
 
@@ -507,6 +809,8 @@ bool Pipeline::Stop() {
     if (it.joinable()) it.join();
   }
   d_ptr_->threads_.clear();
+  /* the tasks are kept until the next start, source threads may still be transmitting data to stopped connectors */
+  if (d_ptr_->executor_) d_ptr_->executor_->Stop();
   if (d_ptr_->event_thread_.joinable()) {
     d_ptr_->event_thread_.join();
   }
@@ -515,7 +819,6 @@ bool Pipeline::Stop() {
     it.second.instance->Close();
   }
 
-  d_ptr_->ClearEOSMask();
   LOG(INFO) << "Pipeline Stop";
   return true;
 }
@@ -557,17 +860,25 @@ void Pipeline::PrintPerformanceInformation() const {
     const ModuleAssociatedInfo& module_info = it.second;
     if (module_info.instance) {
       module_info.instance->PrintPerfInfo();
+      uint64_t stale_count = GetStaleFrameCount(it.first);
+      if (stale_count) std::cout << "[" << it.first << "] stale frames dropped: " << stale_count << "\n";
     }
   }
 }
 
-void Pipeline::TransmitData(std::string moduleName, std::shared_ptr<CNFrameInfo> data) {
-  LOG_IF(FATAL, d_ptr_->modules_.find(moduleName) == d_ptr_->modules_.end());
+bool Pipeline::TransmitData(std::string moduleName, std::shared_ptr<CNFrameInfo> data) {
+  auto iter = d_ptr_->modules_.find(moduleName);
+  LOG_IF(FATAL, iter == d_ptr_->modules_.end());
 
-  const ModuleAssociatedInfo& module_info = d_ptr_->modules_[moduleName];
+  return d_ptr_->TransmitData(iter->second, data);
+}
 
+bool PipelinePrivate::TransmitData(const ModuleAssociatedInfo& module_info, std::shared_ptr<CNFrameInfo> data) {
   const uint32_t chn_idx = data->channel_idx;
 
+  /* the data enters the pipeline */
+  if (!data->frame.HasModuleMasks()) data->frame.InitModuleMasks(module_slots_.size());
+
   /*
     eos
    */
@@ -579,35 +890,57 @@ void Pipeline::TransmitData(std::string moduleName, std::shared_ptr<CNFrameInfo>
     e.module = module_info.instance.get();
     e.message = module_info.instance->GetName() + " received eos from channel " + std::to_string(chn_idx);
     e.thread_id = std::this_thread::get_id();
-    event_bus_->PostEvent(e);
-    const uint64_t eos_mask = data->frame.AddEOSMask(module_info.instance.get());
-    if (eos_mask == d_ptr_->eos_mask_) {
+    q_ptr_->event_bus_->PostEvent(e);
+    if (data->frame.AddEOSMask(module_info.instance.get())) {
       StreamMsg msg;
       msg.type = StreamMsgType::EOS_MSG;
       msg.chn_idx = chn_idx;
       msg.stream_id = data->frame.stream_id;
-      d_ptr_->UpdateByStreamMsg(msg);
+      UpdateByStreamMsg(msg);
     }
   }
 
-  for (auto& down_node_name : module_info.down_nodes) {
-    ModuleAssociatedInfo& down_node_info = d_ptr_->modules_.find(down_node_name)->second;
+  bool ret = true;
+  for (const DownRoute& route : module_info.down_routes) {
+    ModuleAssociatedInfo& down_node_info = *route.module_info;
     assert(down_node_info.connector);
     assert(0 < down_node_info.input_connectors.size());
-    uint64_t frame_mask = data->frame.SetModuleMask(down_node_info.instance.get(), module_info.instance.get());
+    uint64_t frame_mask = data->frame.SetModuleMask(route.instance, route.parent_mask);
 
     // case 1: down_node has only 1 input node: current node
     // case 2: down_node has >1 input nodes, current node has brother nodes
     // the processing data frame will not be pushed into down_node Connector
     // until processed by all brother nodes, the last node responds to transmit
-    bool processed_by_all_modules = frame_mask == down_node_info.instance->GetModulesMask();
+    bool processed_by_all_modules = frame_mask == route.instance->GetModulesMask();
 
-    if (processed_by_all_modules) {
+    if (processed_by_all_modules && down_node_info.fused) {
+      // the down node is fused into this node, process the data in the calling thread
+      ret = ProcessData(*route.node_name, &down_node_info, data) && ret;
+    } else if (processed_by_all_modules) {
       std::shared_ptr<Connector> connector = down_node_info.connector;
-      int conveyor_idx = chn_idx % connector->GetConveyorCount();
-      connector->PushDataBufferToConveyor(conveyor_idx, data);
+      // with frame parallelism, the frames of a stream go to the conveyors in turn and are put back in order after
+      // they are processed, the streams start from different conveyors
+      uint32_t conveyor_idx =
+          down_node_info.reorder_buffer
+              ? (chn_idx + down_node_info.reorder_buffer->Push(data)) % connector->GetConveyorCount()
+              : connector->GetAssigner()->GetConveyorIdx(chn_idx);
+      bool pushed = executor_
+                        ? PushToConveyorTask(down_node_info.conveyor_tasks[conveyor_idx], data)
+                        : connector->PushDataBufferToConveyor(conveyor_idx, data);
+      if (!pushed && !connector->IsStopped()) {
+        // the drops are counted by the conveyor (see LinkStatus::push_timeout_count), under sustained overload only
+        // every kDropLogInterval-th drop of a queue is logged
+        uint64_t drop_count = connector->GetConveyor(conveyor_idx)->GetPushTimeoutCount();
+        LOG_IF(WARNING, 1 == drop_count % kDropLogInterval)
+            << "[" << *route.node_name << "] input queue is blocked for more than " << connector->GetBlockTimeout()
+            << " ms, drop frame " << data->frame.frame_id << " of channel " << chn_idx << ", " << drop_count
+            << " frames dropped by this queue";
+      }
+      // the frame dropped must not hold back the following frames of the stream
+      if (!pushed && down_node_info.reorder_buffer) EmitData(&down_node_info, data, true);
     }
   }
+  return ret;
 }
 
 void Pipeline::TaskLoop(std::string node_name, uint32_t conveyor_idx) {
@@ -621,8 +954,27 @@ void Pipeline::TaskLoop(std::string node_name, uint32_t conveyor_idx) {
   size_t len = node_name.size() > 10 ? 10 : node_name.size();
   std::string thread_name = "cn-" + node_name.substr(0, len) + std::to_string(conveyor_idx);
   SetThreadName(thread_name, pthread_self());
+  /* streams are dispatched by chn_idx % parallelism, or to the least loaded conveyor of their numa nodes (see
+     ConveyorAssigner), so all streams of this conveyor are on the node of conveyor_idx when parallelism is a multiple
+     of the numa node number */
+  module_info.instance->BindThread(conveyor_idx);
+  Conveyor* conveyor = connector->GetConveyor(conveyor_idx);
 
   bool has_data = true;
+  if (module_info.max_batch > 1) {
+    while (has_data) {
+      std::vector<std::shared_ptr<CNFrameInfo>> batch =
+          connector->PopDataBufferBatchFromConveyor(conveyor_idx, module_info.max_batch, module_info.max_wait_us);
+      if (batch.empty()) {
+        has_data = !connector->IsStopped();
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      has_data = d_ptr_->ProcessDataBatch(node_name, &module_info, &batch);
+      conveyor->AddProcessTime(GetElapsedUs(start));
+    }
+    return;
+  }
   while (has_data) {
     has_data = false;
     std::shared_ptr<CNFrameInfo> data;
@@ -630,51 +982,297 @@ void Pipeline::TaskLoop(std::string node_name, uint32_t conveyor_idx) {
     data = connector->PopDataBufferFromConveyor(conveyor_idx);
     if (nullptr == data.get()) {
       /*
-         nullptr will be received when connector stops.
+         nullptr will be received when connector stops or popping data times out.
          maybe only part of the connectors stopped.
          */
+      has_data = !connector->IsStopped();
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    has_data = d_ptr_->ProcessData(node_name, &module_info, data);
+    conveyor->AddProcessTime(GetElapsedUs(start));
+  }  // while
+}
+
+bool PipelinePrivate::ProcessData(const std::string& node_name, ModuleAssociatedInfo* module_info,
+                                  std::shared_ptr<CNFrameInfo> data) {
+  assert(data->frame.GetModulesMask(module_info->instance.get()) == module_info->instance->GetModulesMask());
+
+  data->frame.ClearModuleMask(module_info->instance.get());
+  if (IsStale(data)) {
+    CountStaleFrame(node_name, data);
+    return EmitData(module_info, data, true);
+  }
+  int flags = data->frame.flags;
+
+  if (!module_info->instance->HasTransmit() && (CN_FRAME_FLAG_EOS & flags)) {
+    /*normal module, transmit EOS by the framework*/
+    bool transmitted = EmitData(module_info, data);
+    ReleaseStreamConveyor(module_info, data);
+    return transmitted;
+  }
+
+  int ret = module_info->instance->DoProcess(data);
+  if (CN_FRAME_FLAG_EOS & flags) ReleaseStreamConveyor(module_info, data);
+  /*process failed*/
+  if (ret < 0) {
+    OnProcessFailed(module_info, ret, {data});
+    return false;
+  } else if (ret > 0) {
+    // data has been transmitted by the module itself
+    if (!module_info->instance->HasTransmit()) {
+      LOG(ERROR) << "Module::Process() should not return 1\n";
+      return false;
+    }
+    return true;
+  }
+  return EmitData(module_info, data);
+}
+
+bool PipelinePrivate::ProcessDataBatch(const std::string& node_name, ModuleAssociatedInfo* module_info,
+                                       std::vector<std::shared_ptr<CNFrameInfo>>* batch) {
+  if (batch->size() == 1) return ProcessData(node_name, module_info, batch->front());
+  std::vector<std::shared_ptr<CNFrameInfo>> frames;
+  frames.reserve(batch->size());
+  for (auto& data : *batch) {
+    if (CN_FRAME_FLAG_EOS & data->frame.flags) {
+      /* EOS keeps the per-frame semantics, and is processed after the frames before it */
+      if (!frames.empty() && !ProcessFrames(node_name, module_info, &frames)) return false;
+      frames.clear();
+      if (!ProcessData(node_name, module_info, data)) return false;
       continue;
     }
+    if (IsStale(data)) {
+      // the mask is cleared as the processed frames, so that the accounting of the module is the same
+      data->frame.ClearModuleMask(module_info->instance.get());
+      CountStaleFrame(node_name, data);
+      if (!EmitData(module_info, data, true)) return false;
+      continue;
+    }
+    frames.push_back(data);
+  }
+  return frames.empty() || ProcessFrames(node_name, module_info, &frames);
+}
 
-    has_data = true;
-    assert(data->frame.GetModulesMask(module_info.instance.get()) == module_info.instance->GetModulesMask());
+bool PipelinePrivate::ProcessFrames(const std::string& node_name, ModuleAssociatedInfo* module_info,
+                                    std::vector<std::shared_ptr<CNFrameInfo>>* frames) {
+  Module* instance = module_info->instance.get();
+  for (auto& data : *frames) {
+    assert(data->frame.GetModulesMask(instance) == instance->GetModulesMask());
+    data->frame.ClearModuleMask(instance);
+  }
+  int ret = instance->DoProcessBatch(*frames);
+  /*process failed*/
+  if (ret < 0) {
+    OnProcessFailed(module_info, ret, *frames);
+    return false;
+  } else if (ret > 0) {
+    // data has been transmitted by the module itself
+    if (!instance->HasTransmit()) {
+      LOG(ERROR) << "Module::ProcessBatch() should not return 1\n";
+      return false;
+    }
+    return true;
+  }
+  bool transmitted = true;
+  for (auto& data : *frames) transmitted = EmitData(module_info, data) && transmitted;
+  return transmitted;
+}
 
-    data->frame.ClearModuleMask(module_info.instance.get());
-    int flags = data->frame.flags;
+bool PipelinePrivate::EmitData(ModuleAssociatedInfo* module_info, const std::shared_ptr<CNFrameInfo>& data,
+                               bool dropped) {
+  if (!module_info->reorder_buffer) return dropped || TransmitData(*module_info, data);
+  return module_info->reorder_buffer->Done(
+      data, !dropped, [&](const std::shared_ptr<CNFrameInfo>& ready) { return TransmitData(*module_info, ready); });
+}
 
-    if (!module_info.instance->HasTransmit() && (CN_FRAME_FLAG_EOS & flags)) {
-      /*normal module, transmit EOS by the framework*/
-      TransmitData(node_name, data);
+void PipelinePrivate::OnProcessFailed(ModuleAssociatedInfo* module_info, int ret,
+                                      const std::vector<std::shared_ptr<CNFrameInfo>>& frames) {
+  Event e;
+  e.type = EventType::EVENT_ERROR;
+  e.module = module_info->instance.get();
+  e.message = module_info->instance->GetName() + " process failed, return number: " + std::to_string(ret);
+  e.thread_id = std::this_thread::get_id();
+  q_ptr_->event_bus_->PostEvent(e);
+  std::set<uint32_t> failed_streams;
+  for (auto& data : frames) {
+    if (!failed_streams.insert(data->channel_idx).second) continue;
+    StreamMsg msg;
+    msg.type = StreamMsgType::ERROR_MSG;
+    msg.chn_idx = data->channel_idx;
+    msg.stream_id = data->frame.stream_id;
+    UpdateByStreamMsg(msg);
+  }
+}
+
+bool PipelinePrivate::IsStale(const std::shared_ptr<CNFrameInfo>& data) const {
+  const uint32_t max_frame_age_ms = max_frame_age_ms_.load(std::memory_order_relaxed);
+  if (0 == max_frame_age_ms || (CN_FRAME_FLAG_EOS & data->frame.flags)) return false;
+  return std::chrono::steady_clock::now() - data->GetCreateTime() > std::chrono::milliseconds(max_frame_age_ms);
+}
+
+void PipelinePrivate::CountStaleFrame(const std::string& node_name, const std::shared_ptr<CNFrameInfo>& data) {
+  std::lock_guard<std::mutex> lk(stale_mtx_);
+  ++stale_counts_[node_name][data->frame.stream_id];
+}
+
+void PipelinePrivate::FuseModules() {
+  for (auto& it : modules_) it.second.fused = false;
+  for (auto& it : modules_) {
+    const ModuleAssociatedInfo& up_node_info = it.second;
+    /* only data transmitted in the threads of the up node could be processed inline */
+    if (!up_node_info.connector || up_node_info.instance->HasTransmit() || 1 != up_node_info.down_nodes.size()) {
+      continue;
+    }
+    const std::string& down_node_name = *up_node_info.down_nodes.begin();
+    ModuleAssociatedInfo& down_node_info = modules_[down_node_name];
+    if (!down_node_info.fusion_enabled || down_node_info.max_batch > 1 || down_node_info.reorder_buffer ||
+        1 != down_node_info.input_connectors.size()) {
+      continue;
+    }
+    /* the fused module runs in the threads of the up node, so it must have asked for the same threads */
+    std::string mismatch;
+    if (down_node_info.parallelism != up_node_info.parallelism) {
+      mismatch = "parallelism";
+    } else if (down_node_info.connector->GetConveyorQueueType() != up_node_info.connector->GetConveyorQueueType()) {
+      mismatch = "input queue type";
+    } else if (down_node_info.instance->GetCpuAffinity() != up_node_info.instance->GetCpuAffinity() ||
+               down_node_info.instance->GetNumaNode() != up_node_info.instance->GetNumaNode()) {
+      mismatch = "affinity";
+    }
+    if (!mismatch.empty()) {
+      LOG(INFO) << "Module [" << down_node_name << "] is not fused into [" << it.first << "], the " << mismatch
+                << " differs";
       continue;
     }
+    down_node_info.fused = true;
+  }
+  for (auto& it : modules_) {
+    if (it.second.fused) continue;
+    std::string chain = it.first;
+    const ModuleAssociatedInfo* module_info = &it.second;
+    while (1 == module_info->down_nodes.size()) {
+      const std::string& down_node_name = *module_info->down_nodes.begin();
+      module_info = &modules_[down_node_name];
+      if (!module_info->fused) break;
+      chain += " -> " + down_node_name;
+    }
+    if (chain != it.first) LOG(INFO) << "Fused module chain: " << chain;
+  }
+}
+
+/* the maximum number of frames processed by a conveyor task before it yields the worker */
+static const uint32_t kConveyorTaskBatch = 16;
+
+void PipelinePrivate::CreateConveyorTasks() {
+  for (auto& it : modules_) {
+    ModuleAssociatedInfo& module_info = it.second;
+    if (!module_info.connector || module_info.fused) continue;
+    for (uint32_t conveyor_idx = 0; conveyor_idx < module_info.parallelism; ++conveyor_idx) {
+      std::unique_ptr<ConveyorTask> task(new ConveyorTask);
+      task->node_name = it.first;
+      task->module_info = &module_info;
+      task->conveyor = module_info.connector->GetConveyor(conveyor_idx);
+      module_info.conveyor_tasks.push_back(task.get());
+      conveyor_tasks_.push_back(std::move(task));
+    }
+  }
+  executor_.reset(new WorkStealingExecutor(executor_thread_num_));
+  executor_->Start();
+}
 
-    {
-      int ret = module_info.instance->DoProcess(data);
-      /*process failed*/
-      if (ret < 0) {
-        Event e;
-        e.type = EventType::EVENT_ERROR;
-        e.module = module_info.instance.get();
-        e.message = module_info.instance->GetName() + " process failed, return number: " + std::to_string(ret);
-        e.thread_id = std::this_thread::get_id();
-        event_bus_->PostEvent(e);
-        StreamMsg msg;
-        msg.type = StreamMsgType::ERROR_MSG;
-        msg.chn_idx = data->channel_idx;
-        msg.stream_id = data->frame.stream_id;
-        d_ptr_->UpdateByStreamMsg(msg);
-        return;
-      } else if (ret > 0) {
-        // data has been transmitted by the module itself
-        if (!module_info.instance->HasTransmit()) {
-          LOG(ERROR) << "Module::Process() should not return 1\n";
-          return;
-        }
-        continue;
+void PipelinePrivate::DestroyConveyorTasks() {
+  if (!executor_) return;
+  executor_->Stop();
+  executor_.reset();
+  for (auto& it : modules_) {
+    it.second.conveyor_tasks.clear();
+  }
+  conveyor_tasks_.clear();
+}
+
+void PipelinePrivate::ScheduleConveyorTask(ConveyorTask* task) {
+  // pairs with the fence in RunClaimedConveyorTask, either the data or the IDLE state is seen.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int expected = ConveyorTask::IDLE;
+  if (!task->failed.load() && task->state.compare_exchange_strong(expected, ConveyorTask::SCHEDULED)) {
+    executor_->Submit([this, task] { RunScheduledConveyorTask(task); });
+  }
+}
+
+void PipelinePrivate::RunScheduledConveyorTask(ConveyorTask* task) {
+  int expected = ConveyorTask::SCHEDULED;
+  // the task has been run by the upstream worker directly, see PushToConveyorTask.
+  if (!task->state.compare_exchange_strong(expected, ConveyorTask::RUNNING)) return;
+  RunClaimedConveyorTask(task);
+}
+
+bool PipelinePrivate::TryRunConveyorTask(ConveyorTask* task) {
+  int state = task->state.load();
+  while (ConveyorTask::RUNNING != state) {
+    if (task->state.compare_exchange_weak(state, ConveyorTask::RUNNING)) {
+      RunClaimedConveyorTask(task);
+      return true;
+    }
+  }
+  return false;
+}
+
+void PipelinePrivate::RunClaimedConveyorTask(ConveyorTask* task) {
+  const uint32_t max_batch = task->module_info->max_batch;
+  if (max_batch > 1) {
+    for (uint32_t i = 0; i < kConveyorTaskBatch && !task->failed.load();) {
+      std::vector<std::shared_ptr<CNFrameInfo>> batch = task->conveyor->TryPopDataBufferBatch(max_batch);
+      if (batch.empty()) break;
+      i += batch.size();
+      auto start = std::chrono::steady_clock::now();
+      if (!ProcessDataBatch(task->node_name, task->module_info, &batch)) {
+        task->failed.store(true);
       }
+      task->conveyor->AddProcessTime(GetElapsedUs(start));
     }
-    TransmitData(node_name, data);
-  }  // while
+  } else {
+    for (uint32_t i = 0; i < kConveyorTaskBatch && !task->failed.load(); ++i) {
+      std::shared_ptr<CNFrameInfo> data = task->conveyor->TryPopDataBuffer();
+      if (!data) break;
+      auto start = std::chrono::steady_clock::now();
+      if (!ProcessData(task->node_name, task->module_info, data)) {
+        task->failed.store(true);
+      }
+      task->conveyor->AddProcessTime(GetElapsedUs(start));
+    }
+  }
+  task->state.store(ConveyorTask::IDLE);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!task->module_info->connector->IsStopped() && task->conveyor->GetBufferSize()) {
+    ScheduleConveyorTask(task);
+  }
+}
+
+bool PipelinePrivate::PushToConveyorTask(ConveyorTask* task, std::shared_ptr<CNFrameInfo> data) {
+  bool pushed = false;
+  if (!executor_->InWorkerThread()) {
+    // threads outside of the executor, e.g. source module threads, are blocked by back-pressure as usual.
+    pushed = task->conveyor->PushDataBuffer(data);
+  } else {
+    /*
+      A worker never waits on a full conveyor while other work is pending, it drains the conveyor by running the
+      downstream task itself. Only downstream tasks are run this way, so the tasks on the stack of a worker are
+      always ordered from upstream to downstream and can not wait for each other.
+     */
+    Connector* connector = task->module_info->connector.get();
+    while (!(pushed = task->conveyor->TryPushDataBuffer(data))) {
+      if (connector->IsStopped()) break;
+      if (task->failed.load() || !TryRunConveyorTask(task)) {
+        // the downstream task is running on another worker which may in turn wait for this one,
+        // so only wait for a short time and retry.
+        task->conveyor->WaitForSpace(std::chrono::milliseconds(1), data);
+      }
+    }
+  }
+  if (pushed) ScheduleConveyorTask(task);
+  return pushed;
 }
 
 /* ------config/auto-graph methods------ */
@@ -710,7 +1308,7 @@ CNModuleConfig Pipeline::GetModuleConfig(const std::string& module_name) {
 
 int Pipeline::BuildPipeline(const std::vector<CNModuleConfig>& configs) {
   /*TODO,check configs*/
-  uint64_t linked_id_mask = 0;
+  std::set<std::string> linked_modules;
   ModuleCreatorWorker creator;
   for (auto& v : configs) {
     this->AddModuleConfig(v);
@@ -720,9 +1318,14 @@ int Pipeline::BuildPipeline(const std::vector<CNModuleConfig>& configs) {
       return -1;
     }
     instance->ShowPerfInfo(v.showPerfInfo);
+    instance->SetAffinity(v.cpuAffinity, v.numaNode);
     d_ptr_->modules_map_[v.name] = instance;
     this->AddModule(instance);
-    this->SetModuleAttribute(instance, v.parallelism, v.maxInputQueueSize);
+    this->SetModuleAttribute(instance, v.parallelism, v.maxInputQueueSize, v.inputQueueType,
+                             v.inputQueueBlockTimeout);
+    this->SetModuleBatchAttribute(instance, v.maxBatch, v.maxWaitUs);
+    this->SetModuleFusion(instance, v.enableFusion);
+    if (v.frameParallel && !this->SetModuleFrameParallel(instance, true)) return -1;
   }
   for (auto& v : d_ptr_->connections_config_) {
     for (auto& name : v.second) {
@@ -730,12 +1333,11 @@ int Pipeline::BuildPipeline(const std::vector<CNModuleConfig>& configs) {
         LOG(ERROR) << "Link [" << v.first << "] with [" << name << "] failed.";
         return -1;
       }
-      linked_id_mask |= (uint64_t)1 << d_ptr_->modules_map_[name]->GetId();
+      linked_modules.insert(name);
     }
   }
   for (auto& v : configs) {
-    if (v.className != "cnstream::DataSource" &&
-        !(((uint64_t)1 << d_ptr_->modules_map_[v.name]->GetId()) & linked_id_mask)) {
+    if (v.className != "cnstream::DataSource" && !linked_modules.count(v.name)) {
       LOG(ERROR) << v.name << " not linked to any module.";
       return -1;
     }
@@ -743,6 +1345,128 @@ int Pipeline::BuildPipeline(const std::vector<CNModuleConfig>& configs) {
   return 0;
 }
 
+bool Pipeline::SetExecutorType(PipelineExecutorType type, uint32_t thread_num) {
+  if (IsRunning()) {
+    LOG(ERROR) << "The executor type can not be changed while the pipeline is running.";
+    return false;
+  }
+  d_ptr_->executor_type_ = type;
+  d_ptr_->executor_thread_num_ = thread_num;
+  return true;
+}
+
+PipelineExecutorType Pipeline::GetExecutorType() const { return d_ptr_->executor_type_; }
+
+bool Pipeline::SetStreamNumaPlacement(bool enable) {
+  if (IsRunning()) {
+    LOG(ERROR) << "The stream numa placement can not be changed while the pipeline is running.";
+    return false;
+  }
+  d_ptr_->stream_numa_placement_ = enable;
+  return true;
+}
+
+bool Pipeline::GetStreamNumaPlacement() const { return d_ptr_->stream_numa_placement_; }
+
+void Pipeline::SetMaxFrameAge(uint32_t max_frame_age_ms) { d_ptr_->max_frame_age_ms_.store(max_frame_age_ms); }
+
+uint32_t Pipeline::GetMaxFrameAge() const { return d_ptr_->max_frame_age_ms_.load(); }
+
+bool Pipeline::SetConveyorAssignPolicy(ConveyorAssignPolicy policy) {
+  if (IsRunning()) {
+    LOG(ERROR) << "The conveyor assign policy can not be changed while the pipeline is running.";
+    return false;
+  }
+  d_ptr_->assign_policy_ = policy;
+  return true;
+}
+
+ConveyorAssignPolicy Pipeline::GetConveyorAssignPolicy() const { return d_ptr_->assign_policy_; }
+
+std::map<uint32_t, uint32_t> Pipeline::GetStreamConveyors(const std::string& module_name) const {
+  auto it = d_ptr_->modules_.find(module_name);
+  if (it == d_ptr_->modules_.end() || !it->second.connector) return {};
+  return it->second.connector->GetAssigner()->GetAssignment();
+}
+
+uint64_t Pipeline::GetStaleFrameCount(const std::string& module_name, const std::string& stream_id) const {
+  std::lock_guard<std::mutex> lk(d_ptr_->stale_mtx_);
+  auto module_it = d_ptr_->stale_counts_.find(module_name);
+  if (module_it == d_ptr_->stale_counts_.end()) return 0;
+  if (!stream_id.empty()) {
+    auto stream_it = module_it->second.find(stream_id);
+    return stream_it == module_it->second.end() ? 0 : stream_it->second;
+  }
+  uint64_t count = 0;
+  for (const auto& it : module_it->second) count += it.second;
+  return count;
+}
+
+/* the item in the pipeline JSON file that configures the pipeline itself rather than a module */
+static const char* kPipelineConfigName = "pipeline_config";
+
+static bool ParsePipelineConfig(const rapidjson::Value& config, Pipeline* pipeline) {
+  if (!config.IsObject()) {
+    LOG(ERROR) << kPipelineConfigName << " must be an object.";
+    return false;
+  }
+  auto end = config.MemberEnd();
+  PipelineExecutorType executor_type = EXECUTOR_THREAD_PER_CONVEYOR;
+  if (end != config.FindMember("executor")) {
+    if (!config["executor"].IsString()) {
+      LOG(ERROR) << "executor must be string type.";
+      return false;
+    }
+    std::string executor = config["executor"].GetString();
+    if (executor == "thread_per_conveyor") {
+      executor_type = EXECUTOR_THREAD_PER_CONVEYOR;
+    } else if (executor == "work_stealing") {
+      executor_type = EXECUTOR_WORK_STEALING;
+    } else {
+      LOG(ERROR) << "executor must be \"thread_per_conveyor\" or \"work_stealing\", got: " << executor;
+      return false;
+    }
+  }
+  uint32_t thread_num = 0;
+  if (end != config.FindMember("executor_threads")) {
+    if (!config["executor_threads"].IsUint()) {
+      LOG(ERROR) << "executor_threads must be uint type.";
+      return false;
+    }
+    thread_num = config["executor_threads"].GetUint();
+  }
+  if (end != config.FindMember("stream_numa_placement")) {
+    if (!config["stream_numa_placement"].IsBool()) {
+      LOG(ERROR) << "stream_numa_placement must be Boolean type.";
+      return false;
+    }
+    pipeline->SetStreamNumaPlacement(config["stream_numa_placement"].GetBool());
+  }
+  if (end != config.FindMember("max_frame_age_ms")) {
+    if (!config["max_frame_age_ms"].IsUint()) {
+      LOG(ERROR) << "max_frame_age_ms must be uint type.";
+      return false;
+    }
+    pipeline->SetMaxFrameAge(config["max_frame_age_ms"].GetUint());
+  }
+  if (end != config.FindMember("conveyor_assignment")) {
+    if (!config["conveyor_assignment"].IsString()) {
+      LOG(ERROR) << "conveyor_assignment must be string type.";
+      return false;
+    }
+    std::string assignment = config["conveyor_assignment"].GetString();
+    if (assignment == "stream_index") {
+      pipeline->SetConveyorAssignPolicy(ASSIGN_BY_STREAM_INDEX);
+    } else if (assignment == "least_loaded") {
+      pipeline->SetConveyorAssignPolicy(ASSIGN_LEAST_LOADED);
+    } else {
+      LOG(ERROR) << "conveyor_assignment must be \"stream_index\" or \"least_loaded\", got: " << assignment;
+      return false;
+    }
+  }
+  return pipeline->SetExecutorType(executor_type, thread_num);
+}
+
 int Pipeline::BuildPipelineByJSONFile(const std::string& config_file) {
   std::ifstream ifs(config_file);
   if (!ifs.is_open()) {
@@ -764,6 +1488,10 @@ int Pipeline::BuildPipelineByJSONFile(const std::string& config_file) {
   }
 
   for (rapidjson::Document::ConstMemberIterator iter = doc.MemberBegin(); iter != doc.MemberEnd(); ++iter) {
+    if (std::string(kPipelineConfigName) == iter->name.GetString()) {
+      if (!ParsePipelineConfig(iter->value, this)) return -1;
+      continue;
+    }
     CNModuleConfig mconf;
     mconf.name = iter->name.GetString();
     if (find(namelist.begin(), namelist.end(), mconf.name) != namelist.end()) {
@@ -71,6 +71,59 @@ uint32_t SourceModule::GetStreamIndex(const std::string &stream_id) { return _Ge
 
 void SourceModule::ReturnStreamIndex(const std::string &stream_id) { _ReturnStreamIndex(stream_id); }
 
+int SourceModule::GetStreamParallelism(const std::string &stream_id) {
+  CNSpinLockGuard guard(parallelism_lock_);
+  auto iter = stream_parallelism_.find(stream_id);
+  if (iter != stream_parallelism_.end()) {
+    return iter->second;
+  }
+  return GetParallelism();
+}
+
+int SourceModule::SetStreamParallelism(const std::string &stream_id, int parallelism) {
+  {
+    CNSpinLockGuard guard(parallelism_lock_);
+    stream_parallelism_[stream_id] = parallelism;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto iter = source_map_.find(stream_id);
+  if (iter != source_map_.end()) {
+    iter->second->GetAdmission()->SetLimit(parallelism);
+  }
+  return 0;
+}
+
+uint32_t SourceModule::GetStreamWeight(const std::string &stream_id) {
+  CNSpinLockGuard guard(parallelism_lock_);
+  auto iter = stream_weight_.find(stream_id);
+  if (iter != stream_weight_.end()) {
+    return iter->second;
+  }
+  return 1;
+}
+
+int SourceModule::SetStreamWeight(const std::string &stream_id, uint32_t weight) {
+  {
+    CNSpinLockGuard guard(parallelism_lock_);
+    stream_weight_[stream_id] = weight ? weight : 1;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto iter = source_map_.find(stream_id);
+  if (iter != source_map_.end()) {
+    iter->second->GetAdmission()->SetWeight(weight);
+  }
+  return 0;
+}
+
+std::shared_ptr<SourceHandler> SourceModule::GetSourceHandler(const std::string &stream_id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto iter = source_map_.find(stream_id);
+  if (iter == source_map_.end()) {
+    return nullptr;
+  }
+  return iter->second;
+}
+
 int SourceModule::AddVideoSource(const std::string &stream_id, const std::string &filename, int framerate, bool loop) {
   std::unique_lock<std::mutex> lock(mutex_);
   if (source_map_.find(stream_id) != source_map_.end()) {
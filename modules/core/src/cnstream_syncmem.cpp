@@ -30,17 +30,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cnrt.h>
 #include <glog/logging.h>
 
+#include <stdlib.h>
+
 #include "cnstream_common.hpp"
 #include "cnstream_syncmem.hpp"
 
 namespace cnstream {
 
-void CNStreamMallocHost(void** ptr, size_t size) {
-  void* __ptr = malloc(size);
-  LOG_IF(FATAL, nullptr == __ptr) << "Malloc memory on CPU failed, malloc size:" << size;
-  *ptr = __ptr;
-}
-
 CNSyncedMemory::CNSyncedMemory() {}
 
 CNSyncedMemory::CNSyncedMemory(size_t size) : size_(size) {}
@@ -52,7 +48,7 @@ CNSyncedMemory::~CNSyncedMemory() {
   std::lock_guard<std::mutex> lock(mutex_);
   if (0 == size_) return;
   if (cpu_ptr_ && own_cpu_data_) {
-    free(cpu_ptr_);
+    CNStreamFreeHost(cpu_ptr_);
   }
   if (mlu_ptr_ && own_mlu_data_) {
     // set device id before call cnrt functions, or CNRT_RET_ERR_EXISTS will be returned from cnrt function
@@ -60,6 +56,25 @@ CNSyncedMemory::~CNSyncedMemory() {
   }
 }
 
+void CNSyncedMemory::Reset(size_t size, int mlu_dev_id, int mlu_ddr_chn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cpu_ptr_ && own_cpu_data_) {
+    CNStreamFreeHost(cpu_ptr_);
+  }
+  if (mlu_ptr_ && own_mlu_data_) {
+    CALL_CNRT_BY_CONTEXT(cnrtFree(mlu_ptr_), dev_id_, ddr_chn_);
+  }
+  cpu_ptr_ = nullptr;
+  mlu_ptr_ = nullptr;
+  own_cpu_data_ = false;
+  own_mlu_data_ = false;
+  data_holder_.reset();
+  head_ = UNINITIALIZED;
+  size_ = size;
+  dev_id_ = mlu_dev_id;
+  ddr_chn_ = mlu_ddr_chn;
+}
+
 inline void CNSyncedMemory::ToCpu() {
   if (0 == size_) return;
   switch (head_) {
@@ -199,4 +214,9 @@ void* CNSyncedMemory::GetMutableMluData() {
   return mlu_ptr_;
 }
 
+void CNSyncedMemory::SetDataHolder(std::shared_ptr<void> holder) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  data_holder_ = std::move(holder);
+}
+
 }  // namespace cnstream
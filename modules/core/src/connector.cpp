@@ -21,8 +21,11 @@
 #include "connector.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <memory>
 #include <vector>
 #include "conveyor.hpp"
+#include "conveyor_assigner.hpp"
 
 namespace cnstream {
 
@@ -34,21 +37,27 @@ class ConnectorPrivate {
 
   DECLARE_PUBLIC(q_ptr_, Connector);
   std::vector<Conveyor*> vec_conveyor_;
+  std::unique_ptr<ConveyorAssigner> assigner_;
   size_t conveyor_capacity_ = 20;
+  ConveyorQueueType queue_type_ = QUEUE_MUTEX;
+  std::atomic<uint32_t> block_timeout_ms_{0};
   std::atomic<bool> stop_{false};
   DISABLE_COPY_AND_ASSIGN(ConnectorPrivate);
 };  // class ConnectorPrivate
 
-Connector::Connector(const size_t conveyor_count, size_t conveyor_capacity)
+Connector::Connector(const size_t conveyor_count, size_t conveyor_capacity, ConveyorQueueType queue_type)
     : d_ptr_(new (std::nothrow) ConnectorPrivate(this)) {
   LOG_IF(FATAL, nullptr == d_ptr_) << "Connector::Connector()  new ConnectorPrivate failed.";
   d_ptr_->conveyor_capacity_ = conveyor_capacity;
+  d_ptr_->queue_type_ = queue_type;
   d_ptr_->vec_conveyor_.reserve(conveyor_count);
   for (size_t i = 0; i < conveyor_count; ++i) {
-    Conveyor* Conveyor_ptr = new (std::nothrow) Conveyor(this, conveyor_capacity);
+    Conveyor* Conveyor_ptr = new (std::nothrow) Conveyor(this, conveyor_capacity, false, queue_type);
     LOG_IF(FATAL, nullptr == Conveyor_ptr) << "Connector::Connector()  new Conveyor failed.";
     d_ptr_->vec_conveyor_.push_back(Conveyor_ptr);
   }
+  d_ptr_->assigner_.reset(new (std::nothrow) ConveyorAssigner(this));
+  LOG_IF(FATAL, nullptr == d_ptr_->assigner_) << "Connector::Connector()  new ConveyorAssigner failed.";
 }
 
 Connector::~Connector() { delete d_ptr_; }
@@ -59,19 +68,38 @@ Conveyor* Connector::GetConveyor(int conveyor_idx) const { return d_ptr_->GetCon
 
 size_t Connector::GetConveyorCapacity() const { return d_ptr_->conveyor_capacity_; }
 
+ConveyorQueueType Connector::GetConveyorQueueType() const { return d_ptr_->queue_type_; }
+
+ConveyorAssigner* Connector::GetAssigner() const { return d_ptr_->assigner_.get(); }
+
 CNFrameInfoPtr Connector::PopDataBufferFromConveyor(int conveyor_idx) {
   return GetConveyor(conveyor_idx)->PopDataBuffer();
 }
 
-void Connector::PushDataBufferToConveyor(int conveyor_idx, CNFrameInfoPtr data) {
-  GetConveyor(conveyor_idx)->PushDataBuffer(data);
+std::vector<CNFrameInfoPtr> Connector::PopDataBufferBatchFromConveyor(int conveyor_idx, size_t max_batch,
+                                                                      uint32_t max_wait_us) {
+  return GetConveyor(conveyor_idx)->PopDataBufferBatch(max_batch, std::chrono::microseconds(max_wait_us));
+}
+
+bool Connector::PushDataBufferToConveyor(int conveyor_idx, CNFrameInfoPtr data) {
+  return GetConveyor(conveyor_idx)->PushDataBuffer(data);
 }
 
+void Connector::SetBlockTimeout(uint32_t timeout_ms) { d_ptr_->block_timeout_ms_.store(timeout_ms); }
+
+uint32_t Connector::GetBlockTimeout() const { return d_ptr_->block_timeout_ms_.load(); }
+
 bool Connector::IsStopped() { return d_ptr_->stop_.load(); }
 
 void Connector::Start() { d_ptr_->stop_.store(false); }
 
-void Connector::Stop() { d_ptr_->stop_.store(true); }
+void Connector::Stop() {
+  d_ptr_->stop_.store(true);
+  // wake up the threads blocked on conveyors
+  for (Conveyor* it : d_ptr_->vec_conveyor_) {
+    it->NotifyAll();
+  }
+}
 
 ConnectorPrivate::ConnectorPrivate(Connector* q) : q_ptr_(q) {}
 
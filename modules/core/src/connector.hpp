@@ -22,6 +22,7 @@
 #define MODULES_CORE_INCLUDE_CONNECTOR_HPP_
 
 #include <memory>
+#include <vector>
 
 #include "cnstream_frame.hpp"
 
@@ -31,6 +32,7 @@ using CNFrameInfoPtr = std::shared_ptr<CNFrameInfo>;
 
 class ConnectorPrivate;
 class Conveyor;
+class ConveyorAssigner;
 
 /**
  * @brief Connects two modules. Transmits data between modules through Conveyor(s).
@@ -59,16 +61,38 @@ class Connector {
    * @param
    *   [conveyor_count]: the conveyor num of this connector.
    *   [conveyor_capacity]: the maximum buffer number of a conveyor.
+   *   [queue_type]: the queue type used by conveyors.
    */
-  explicit Connector(const size_t conveyor_count, size_t conveyor_capacity = 20);
+  explicit Connector(const size_t conveyor_count, size_t conveyor_capacity = 20,
+                     ConveyorQueueType queue_type = QUEUE_MUTEX);
   ~Connector();
 
   const size_t GetConveyorCount() const;
   Conveyor* GetConveyor(int conveyor_idx) const;
   size_t GetConveyorCapacity() const;
+  ConveyorQueueType GetConveyorQueueType() const;
+  /**
+   * @brief Gets the assigner deciding the conveyor of each stream, see ConveyorAssigner.
+   */
+  ConveyorAssigner* GetAssigner() const;
+
+  /**
+   * @brief Sets the maximum time that a conveyor blocks on push or pop.
+   * @param
+   *   [timeout_ms]: timeout in milliseconds, 0 means waiting until data is pushed/popped or the connector stops.
+   */
+  void SetBlockTimeout(uint32_t timeout_ms);
+  uint32_t GetBlockTimeout() const;
 
   CNFrameInfoPtr PopDataBufferFromConveyor(int conveyor_idx);
-  void PushDataBufferToConveyor(int conveyor_idx, CNFrameInfoPtr data);
+  /**
+   * @brief Pops at most max_batch data from a conveyor, see Conveyor::PopDataBufferBatch.
+   * @param
+   *   [max_wait_us]: the maximum time in microseconds to wait for more data after the first one is popped.
+   */
+  std::vector<CNFrameInfoPtr> PopDataBufferBatchFromConveyor(int conveyor_idx, size_t max_batch,
+                                                             uint32_t max_wait_us);
+  bool PushDataBufferToConveyor(int conveyor_idx, CNFrameInfoPtr data);
 
   void Start();
   void Stop();
@@ -20,7 +20,9 @@
 
 #include "conveyor.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <thread>
 #include <vector>
@@ -29,48 +31,420 @@
 
 namespace cnstream {
 
-Conveyor::Conveyor(Connector* container, size_t max_size, bool enable_drop)
-    : container_(container), max_size_(max_size), enable_drop_(enable_drop) {
+static inline uint32_t GetStreamIdx(const CNFrameInfoPtr& data) {
+  return data ? data->channel_idx : INVALID_STREAM_IDX;
+}
+
+Conveyor::Conveyor(Connector* container, size_t max_size, bool enable_drop, ConveyorQueueType queue_type)
+    : container_(container), max_size_(max_size), enable_drop_(enable_drop), queue_type_(queue_type) {
   LOG_IF(FATAL, nullptr == container) << "container should not be nullptr.";
+  if (QUEUE_LOCKFREE == queue_type_) {
+    lockfree_dataq_.reset(new (std::nothrow) LockFreeQueue<CNFrameInfoPtr>(max_size));
+    LOG_IF(FATAL, nullptr == lockfree_dataq_) << "Conveyor::Conveyor()  new LockFreeQueue failed.";
+  }
+}
+
+static inline uint64_t ElapsedUs(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t Conveyor::GetBufferSize() {
+  if (lockfree_dataq_) return lockfree_dataq_->Size();
+  std::lock_guard<std::mutex> lk(data_mutex_);
+  return QueueSize();
 }
 
-uint32_t Conveyor::GetBufferSize() { return dataq_.Size(); }
+bool Conveyor::PushDataBuffer(CNFrameInfoPtr data) {
+  const uint32_t timeout_ms = container_->GetBlockTimeout();
+  const bool can_timeout = timeout_ms && !(data && (data->frame.flags & CN_FRAME_FLAG_EOS));
+  if (lockfree_dataq_) return LockFreePush(data, can_timeout);
 
-void Conveyor::PushDataBuffer(CNFrameInfoPtr data) {
-  while (!container_->IsStopped() && dataq_.Size() >= max_size_) {
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  if (!container_->IsStopped() && QueueFull(data)) {
     if (enable_drop_) {
-      CNFrameInfoPtr drop;
-      dataq_.TryPop(drop);
-      break;
+      QueueDrop(data);
     } else {
-      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      auto pred = [this, &data] { return container_->IsStopped() || !QueueFull(data); };
+      auto start = std::chrono::steady_clock::now();
+      bool ready = true;
+      AddPushWaiter(data);
+      if (can_timeout) {
+        ready = notfull_cond_.wait_for(lk, std::chrono::milliseconds(timeout_ms), pred);
+      } else {
+        notfull_cond_.wait(lk, pred);
+      }
+      RemovePushWaiter(data);
+      push_blocked_us_ += ElapsedUs(start);
+      if (!ready) {
+        push_timeout_count_++;
+        lk.unlock();
+        // the space left to this stream may be taken by the others now
+        if (QUEUE_FAIR == queue_type_) notfull_cond_.notify_all();
+        return false;
+      }
     }
   }
-  if (container_->IsStopped()) return;
-  dataq_.Push(data);
+  if (container_->IsStopped()) return false;
+  const bool was_waited = QUEUE_FAIR == queue_type_ && !push_waiting_streams_.empty();
+  QueuePush(data);
+  lk.unlock();
+  notempty_cond_.notify_one();
+  // the pushers leaving the space to the waiting streams may push again
+  if (was_waited) notfull_cond_.notify_all();
+  return true;
 }
 
 CNFrameInfoPtr Conveyor::PopDataBuffer() {
-  CNFrameInfoPtr data;
-  while (!container_->IsStopped()) {
-    if (dataq_.WaitAndTryPop(data, std::chrono::milliseconds(20))) {
-      break;
+  if (lockfree_dataq_) return LockFreePop();
+
+  const uint32_t timeout_ms = container_->GetBlockTimeout();
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  if (!container_->IsStopped() && QueueEmpty()) {
+    auto pred = [this] { return container_->IsStopped() || !QueueEmpty(); };
+    auto start = std::chrono::steady_clock::now();
+    if (timeout_ms) {
+      notempty_cond_.wait_for(lk, std::chrono::milliseconds(timeout_ms), pred);
+    } else {
+      notempty_cond_.wait(lk, pred);
     }
+    pop_blocked_us_ += ElapsedUs(start);
   }
-  if (container_->IsStopped()) {
+  if (container_->IsStopped() || QueueEmpty()) {
     return nullptr;
   }
+  CNFrameInfoPtr data = QueuePop();
+  lk.unlock();
+  NotifyNotFull(1);
+  return data;
+}
+
+bool Conveyor::TryPushDataBuffer(CNFrameInfoPtr data) {
+  if (container_->IsStopped()) return false;
+  if (lockfree_dataq_) {
+    if (IsFull() || !lockfree_dataq_->TryPush(data)) return false;
+    NotifyPushed();
+    return true;
+  }
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  if (QueueFull(data)) return false;
+  QueuePush(data);
+  lk.unlock();
+  notempty_cond_.notify_one();
+  return true;
+}
+
+CNFrameInfoPtr Conveyor::TryPopDataBuffer() {
+  if (container_->IsStopped()) return nullptr;
+  CNFrameInfoPtr data;
+  if (lockfree_dataq_) {
+    if (lockfree_dataq_->TryPop(data)) NotifyPopped();
+    return data;
+  }
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  if (QueueEmpty()) return nullptr;
+  data = QueuePop();
+  lk.unlock();
+  NotifyNotFull(1);
   return data;
 }
 
+void Conveyor::WaitForSpace(std::chrono::microseconds timeout, const CNFrameInfoPtr& data) {
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  push_waiters_++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!lockfree_dataq_) AddPushWaiter(data);
+  notfull_cond_.wait_for(lk, timeout, [this, &data] {
+    return container_->IsStopped() || (lockfree_dataq_ ? !IsFull() : !QueueFull(data));
+  });
+  if (!lockfree_dataq_) RemovePushWaiter(data);
+  push_waiters_--;
+  push_blocked_us_ += ElapsedUs(start);
+}
+
+std::vector<CNFrameInfoPtr> Conveyor::PopDataBufferBatch(size_t max_batch, std::chrono::microseconds max_wait) {
+  std::vector<CNFrameInfoPtr> batch;
+  CNFrameInfoPtr data = PopDataBuffer();
+  if (!data) return batch;
+  batch.reserve(max_batch);
+  batch.push_back(data);
+  const auto deadline = std::chrono::steady_clock::now() + max_wait;
+  while (batch.size() < max_batch && !container_->IsStopped()) {
+    if (PopAvailable(&batch, max_batch - batch.size())) continue;
+    if (!WaitForData(deadline)) break;
+  }
+  return batch;
+}
+
+std::vector<CNFrameInfoPtr> Conveyor::TryPopDataBufferBatch(size_t max_batch) {
+  std::vector<CNFrameInfoPtr> batch;
+  if (container_->IsStopped()) return batch;
+  batch.reserve(max_batch);
+  PopAvailable(&batch, max_batch);
+  return batch;
+}
+
+size_t Conveyor::PopAvailable(std::vector<CNFrameInfoPtr>* batch, size_t max_num) {
+  size_t num = 0;
+  if (lockfree_dataq_) {
+    CNFrameInfoPtr data;
+    while (num < max_num && lockfree_dataq_->TryPop(data)) {
+      batch->push_back(std::move(data));
+      ++num;
+    }
+    if (num) NotifyPopped();
+    return num;
+  }
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  while (num < max_num && !QueueEmpty()) {
+    batch->push_back(QueuePop());
+    ++num;
+  }
+  lk.unlock();
+  NotifyNotFull(num);
+  return num;
+}
+
+bool Conveyor::WaitForData(const std::chrono::steady_clock::time_point& deadline) {
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lk(data_mutex_);
+  pop_waiters_++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool ready = notempty_cond_.wait_until(lk, deadline, [this] {
+    return container_->IsStopped() || (lockfree_dataq_ ? !IsEmpty() : !QueueEmpty());
+  });
+  pop_waiters_--;
+  pop_blocked_us_ += ElapsedUs(start);
+  return ready;
+}
+
 std::vector<CNFrameInfoPtr> Conveyor::PopAllDataBuffer() {
   std::vector<CNFrameInfoPtr> vec_data;
+  PopAvailable(&vec_data, SIZE_MAX);
+  return vec_data;
+}
+
+bool Conveyor::QueueFull(const CNFrameInfoPtr& data) {
+  if (QUEUE_FAIR != queue_type_) return dataq_.size() >= max_size_;
+  if (fair_size_ >= max_size_) return true;
+  if (!data || push_waiting_streams_.empty()) return false;
+  // the free space is left to the waiting streams if this stream holds its share of the capacity
+  const uint32_t chn_idx = data->channel_idx;
+  auto it = stream_queues_.find(chn_idx);
+  const size_t size = it != stream_queues_.end() ? it->second.dataq.size() : 0;
+  size_t stream_num = active_streams_.size() + (size ? 0 : 1);
+  bool others_waiting = false;
+  for (auto& waiting : push_waiting_streams_) {
+    if (waiting.first == chn_idx) continue;
+    others_waiting = true;
+    auto waiting_it = stream_queues_.find(waiting.first);
+    if (waiting_it == stream_queues_.end() || waiting_it->second.dataq.empty()) ++stream_num;
+  }
+  return others_waiting && size >= std::max<size_t>(1, max_size_ / stream_num);
+}
+
+bool Conveyor::QueueEmpty() const { return QUEUE_FAIR != queue_type_ ? dataq_.empty() : 0 == fair_size_; }
+
+size_t Conveyor::QueueSize() const { return QUEUE_FAIR != queue_type_ ? dataq_.size() : fair_size_; }
+
+void Conveyor::QueuePush(CNFrameInfoPtr data) {
+  if (QUEUE_FAIR != queue_type_) {
+    dataq_.push(std::move(data));
+    return;
+  }
+  uint32_t chn_idx = GetStreamIdx(data);
+  StreamQueue& stream_queue = stream_queues_[chn_idx];
+  if (stream_queue.dataq.empty()) active_streams_.push_back(chn_idx);
+  stream_queue.dataq.push(std::move(data));
+  ++fair_size_;
+}
+
+CNFrameInfoPtr Conveyor::QueuePop() {
+  if (QUEUE_FAIR != queue_type_) {
+    CNFrameInfoPtr data = std::move(dataq_.front());
+    dataq_.pop();
+    return data;
+  }
+  uint32_t chn_idx = active_streams_.front();
+  StreamQueue& stream_queue = stream_queues_[chn_idx];
+  CNFrameInfoPtr data = std::move(stream_queue.dataq.front());
+  stream_queue.dataq.pop();
+  --fair_size_;
+  if (0 == stream_queue.deficit) {
+    // a new turn of the stream, the weight is read from the data so that it could be changed at runtime
+    stream_queue.deficit = data ? data->GetStreamWeight() : 1;
+  }
+  if (stream_queue.dataq.empty()) {
+    // the stream leaves the round, the unused quantum is not kept
+    stream_queue.deficit = 0;
+    active_streams_.pop_front();
+    // the stream ends, its queue is released
+    if (data && (data->frame.flags & CN_FRAME_FLAG_EOS)) stream_queues_.erase(chn_idx);
+  } else if (0 == --stream_queue.deficit) {
+    active_streams_.pop_front();
+    active_streams_.push_back(chn_idx);
+  }
+  return data;
+}
+
+void Conveyor::QueueDrop(const CNFrameInfoPtr& data) {
+  if (QUEUE_FAIR != queue_type_) {
+    dataq_.pop();
+    return;
+  }
+  // the stream pushing the data loses its oldest data, or the stream having the most data if it has none
+  auto it = stream_queues_.find(GetStreamIdx(data));
+  if (it == stream_queues_.end() || it->second.dataq.empty()) {
+    it = std::max_element(stream_queues_.begin(), stream_queues_.end(),
+                          [](const std::pair<const uint32_t, StreamQueue>& a,
+                             const std::pair<const uint32_t, StreamQueue>& b) {
+                            return a.second.dataq.size() < b.second.dataq.size();
+                          });
+    if (it == stream_queues_.end() || it->second.dataq.empty()) return;
+  }
+  const uint32_t chn_idx = it->first;
+  it->second.dataq.pop();
+  --fair_size_;
+  if (it->second.dataq.empty()) {
+    it->second.deficit = 0;
+    active_streams_.erase(std::find(active_streams_.begin(), active_streams_.end(), chn_idx));
+  }
+}
+
+void Conveyor::AddPushWaiter(const CNFrameInfoPtr& data) {
+  if (QUEUE_FAIR == queue_type_ && data) ++push_waiting_streams_[data->channel_idx];
+}
+
+void Conveyor::RemovePushWaiter(const CNFrameInfoPtr& data) {
+  if (QUEUE_FAIR != queue_type_ || !data) return;
+  auto it = push_waiting_streams_.find(data->channel_idx);
+  if (it != push_waiting_streams_.end() && 0 == --it->second) push_waiting_streams_.erase(it);
+}
+
+void Conveyor::NotifyNotFull(size_t num) {
+  if (0 == num) return;
+  // with QUEUE_FAIR the pushers wait for different streams, the one woken up might not be the one having space
+  if (1 == num && QUEUE_FAIR != queue_type_) {
+    notfull_cond_.notify_one();
+  } else {
+    notfull_cond_.notify_all();
+  }
+}
+
+void Conveyor::NotifyAll() {
+  { std::lock_guard<std::mutex> lk(data_mutex_); }
+  notempty_cond_.notify_all();
+  notfull_cond_.notify_all();
+}
+
+/*
+  The lock-free queue is not guarded by data_mutex_. A thread spins for a while on a full (empty) queue,
+  then registers itself as a waiter and sleeps on the condition variable. The other side only takes the
+  mutex to notify when there are waiters. The fences make sure that either the waiter sees the new queue
+  state or the other side sees the waiter.
+ */
+static const uint32_t kSpinCount = 64;
+
+bool Conveyor::IsFull() { return lockfree_dataq_->Size() >= max_size_; }
+
+bool Conveyor::IsEmpty() { return lockfree_dataq_->Empty(); }
+
+void Conveyor::NotifyPushed() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (pop_waiters_.load(std::memory_order_relaxed)) {
+    { std::lock_guard<std::mutex> lk(data_mutex_); }
+    notempty_cond_.notify_all();
+  }
+}
+
+void Conveyor::NotifyPopped() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (push_waiters_.load(std::memory_order_relaxed)) {
+    { std::lock_guard<std::mutex> lk(data_mutex_); }
+    notfull_cond_.notify_all();
+  }
+}
+
+bool Conveyor::LockFreePush(const CNFrameInfoPtr& data, bool can_timeout) {
+  const std::chrono::milliseconds timeout(container_->GetBlockTimeout());
+  std::chrono::steady_clock::time_point start;
+  bool blocked = false, pushed = false;
+  uint32_t spin_count = 0;
+  while (!container_->IsStopped()) {
+    if (!IsFull() && lockfree_dataq_->TryPush(data)) {
+      pushed = true;
+      break;
+    }
+    if (enable_drop_) {
+      CNFrameInfoPtr drop;
+      lockfree_dataq_->TryPop(drop);
+      continue;
+    }
+    if (!blocked) {
+      blocked = true;
+      start = std::chrono::steady_clock::now();
+    }
+    if (spin_count < kSpinCount) {
+      ++spin_count;
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(data_mutex_);
+    push_waiters_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto pred = [this] { return container_->IsStopped() || !IsFull(); };
+    bool ready = true;
+    if (can_timeout) {
+      ready = notfull_cond_.wait_until(lk, start + timeout, pred);
+    } else {
+      notfull_cond_.wait(lk, pred);
+    }
+    push_waiters_--;
+    if (!ready) {
+      push_timeout_count_++;
+      break;
+    }
+  }
+  if (blocked) push_blocked_us_ += ElapsedUs(start);
+  if (pushed) NotifyPushed();
+  return pushed;
+}
+
+CNFrameInfoPtr Conveyor::LockFreePop() {
+  const std::chrono::milliseconds timeout(container_->GetBlockTimeout());
+  std::chrono::steady_clock::time_point start;
+  bool blocked = false;
+  uint32_t spin_count = 0;
   CNFrameInfoPtr data;
-  while (!dataq_.Empty()) {
-    dataq_.TryPop(data);
-    vec_data.push_back(data);
+  while (!container_->IsStopped()) {
+    if (lockfree_dataq_->TryPop(data)) {
+      break;
+    }
+    if (!blocked) {
+      blocked = true;
+      start = std::chrono::steady_clock::now();
+    }
+    if (spin_count < kSpinCount) {
+      ++spin_count;
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(data_mutex_);
+    pop_waiters_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto pred = [this] { return container_->IsStopped() || !IsEmpty(); };
+    bool ready = true;
+    if (timeout.count()) {
+      ready = notempty_cond_.wait_until(lk, start + timeout, pred);
+    } else {
+      notempty_cond_.wait(lk, pred);
+    }
+    pop_waiters_--;
+    if (!ready) break;
   }
-  return vec_data;
+  if (blocked) pop_blocked_us_ += ElapsedUs(start);
+  if (data) NotifyPopped();
+  return data;
 }
 
 }  // namespace cnstream
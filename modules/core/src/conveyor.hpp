@@ -21,11 +21,18 @@
 #ifndef MODULES_CORE_INCLUDE_CONVEYOR_HPP_
 #define MODULES_CORE_INCLUDE_CONVEYOR_HPP_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <deque>
+#include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "cnstream_frame.hpp"
-#include "threadsafe_queue.hpp"
+#include "lockfree_queue.hpp"
 
 namespace cnstream {
 
@@ -45,27 +52,131 @@ class Connector;
  * The capacity of buffer queue could be set in configuration json file (see README for more information of
  * configuration json file). If there is no element in buffer queue, the downstream node will wait to pop and
  * be blocked. On contrary, if the queue is full, the upstream node will wait to push and be blocked.
+ * Blocked threads are woken up as soon as the queue state changes or the connector stops. The time spent
+ * blocked is accumulated per conveyor, and the blocking could be limited by Connector::SetBlockTimeout.
+ *
+ * The buffer queue is a mutex guarded queue by default. It could be replaced by a bounded lock-free ring buffer
+ * (see ConveyorQueueType) to reduce lock contention when many threads push data to the same conveyor.
+ *
+ * With QUEUE_FAIR, each stream has a queue of its own, and the capacity bounds the data of all streams. The capacity
+ * is shared by the streams having data or waiting to push: a stream holding its share or more leaves the free space
+ * to the streams waiting, so a bursty stream only blocks itself. The streams having data are served by deficit
+ * round-robin: a stream pops as many data in its turn as its weight (see SourceModule::SetStreamWeight), the data of
+ * a stream keep their order. The queue of a stream is released after its EOS is popped.
  */
 class Conveyor {
  public:
   friend class Connector;
   // ~Conveyor();
-  void PushDataBuffer(CNFrameInfoPtr data);
+  /**
+   * @brief Pushes data to the buffer queue, waits while the queue is full.
+   * @return false if the connector stopped, or the push timed out and the data is dropped.
+   *         EOS data never times out.
+   */
+  bool PushDataBuffer(CNFrameInfoPtr data);
+  /**
+   * @brief Pops data from the buffer queue, waits while the queue is empty.
+   * @return nullptr if the connector stopped or the pop timed out.
+   */
   CNFrameInfoPtr PopDataBuffer();
+  /**
+   * @brief Pushes data to the buffer queue without waiting.
+   * @return false if the queue is full or the connector stopped.
+   */
+  bool TryPushDataBuffer(CNFrameInfoPtr data);
+  /**
+   * @brief Pops data from the buffer queue without waiting.
+   * @return nullptr if the queue is empty or the connector stopped.
+   */
+  CNFrameInfoPtr TryPopDataBuffer();
+  /**
+   * @brief Pops at most max_batch data from the buffer queue. Waits while the queue is empty like PopDataBuffer,
+   *        then waits at most max_wait for more data after the first one is popped.
+   * @return empty if the connector stopped or the pop timed out.
+   */
+  std::vector<CNFrameInfoPtr> PopDataBufferBatch(size_t max_batch, std::chrono::microseconds max_wait);
+  /**
+   * @brief Pops at most max_batch data from the buffer queue without waiting.
+   * @return empty if the queue is empty or the connector stopped.
+   */
+  std::vector<CNFrameInfoPtr> TryPopDataBufferBatch(size_t max_batch);
+  /**
+   * @brief Waits until the buffer queue is not full, the connector stopped or timeout.
+   * @param data The data to be pushed. With QUEUE_FAIR, waits for the space left to its stream.
+   */
+  void WaitForSpace(std::chrono::microseconds timeout, const CNFrameInfoPtr& data = nullptr);
   std::vector<CNFrameInfoPtr> PopAllDataBuffer();
   uint32_t GetBufferSize();
+  /* total time in microseconds spent waiting for a full queue */
+  uint64_t GetPushBlockedTime() const { return push_blocked_us_.load(std::memory_order_relaxed); }
+  /* total time in microseconds spent waiting for an empty queue */
+  uint64_t GetPopBlockedTime() const { return pop_blocked_us_.load(std::memory_order_relaxed); }
+  /* number of data dropped because the push timed out */
+  uint64_t GetPushTimeoutCount() const { return push_timeout_count_.load(std::memory_order_relaxed); }
+  /* accumulates the time in microseconds spent processing the data popped, measured by the pipeline */
+  void AddProcessTime(uint64_t us) { process_us_.fetch_add(us, std::memory_order_relaxed); }
+  /* total time in microseconds spent processing the data popped */
+  uint64_t GetProcessTime() const { return process_us_.load(std::memory_order_relaxed); }
+  /* wakes up all threads waiting on this conveyor, called when the connector stops */
+  void NotifyAll();
 
  private:
 #ifdef UNIT_TEST
  public:
 #endif
-  Conveyor(Connector* container, size_t max_size, bool enable_drop = false);
+  Conveyor(Connector* container, size_t max_size, bool enable_drop = false,
+           ConveyorQueueType queue_type = QUEUE_MUTEX);
 
  private:
+  bool LockFreePush(const CNFrameInfoPtr& data, bool can_timeout);
+  CNFrameInfoPtr LockFreePop();
+  /* pops at most max_num data that are already in the queue, returns the number of data popped */
+  size_t PopAvailable(std::vector<CNFrameInfoPtr>* batch, size_t max_num);
+  /* waits until the queue is not empty or the connector stopped, returns false on timeout */
+  bool WaitForData(const std::chrono::steady_clock::time_point& deadline);
+  bool IsFull();
+  bool IsEmpty();
+  void NotifyPushed();
+  void NotifyPopped();
+  /* the queue operations of the mutex guarded queues, called with data_mutex_ held */
+  bool QueueFull(const CNFrameInfoPtr& data);
+  bool QueueEmpty() const;
+  size_t QueueSize() const;
+  void QueuePush(CNFrameInfoPtr data);
+  CNFrameInfoPtr QueuePop();
+  /* drops the oldest data of the queue the data is pushed to */
+  void QueueDrop(const CNFrameInfoPtr& data);
+  /* registers a pusher waiting for the queue of the data with QUEUE_FAIR, called with data_mutex_ held */
+  void AddPushWaiter(const CNFrameInfoPtr& data);
+  void RemovePushWaiter(const CNFrameInfoPtr& data);
+  /* wakes up the pushers after num data are popped, called without data_mutex_ held */
+  void NotifyNotFull(size_t num);
+
   Connector* container_;
   size_t max_size_;
   bool enable_drop_;
-  ThreadSafeQueue<CNFrameInfoPtr> dataq_;
+  ConveyorQueueType queue_type_;
+  std::queue<CNFrameInfoPtr> dataq_;
+  std::unique_ptr<LockFreeQueue<CNFrameInfoPtr>> lockfree_dataq_;
+  /* the queue of a stream with QUEUE_FAIR */
+  struct StreamQueue {
+    std::queue<CNFrameInfoPtr> dataq;
+    uint32_t deficit = 0;  // the data the stream could still pop in its turn
+  };
+  std::unordered_map<uint32_t /*channel_idx*/, StreamQueue> stream_queues_;
+  std::deque<uint32_t> active_streams_;  // the streams having data, the front one is in its turn
+  size_t fair_size_ = 0;
+  std::unordered_map<uint32_t /*channel_idx*/, uint32_t> push_waiting_streams_;  // the number of pushers waiting
+  /* guards dataq_ and the stream queues, lockfree_dataq_ only uses it to sleep on the condition variables */
+  std::mutex data_mutex_;
+  std::condition_variable notempty_cond_;
+  std::condition_variable notfull_cond_;
+  std::atomic<uint32_t> push_waiters_{0};
+  std::atomic<uint32_t> pop_waiters_{0};
+  std::atomic<uint64_t> push_blocked_us_{0};
+  std::atomic<uint64_t> pop_blocked_us_{0};
+  std::atomic<uint64_t> push_timeout_count_{0};
+  std::atomic<uint64_t> process_us_{0};
   DISABLE_COPY_AND_ASSIGN(Conveyor);
 };  // class Conveyor
 
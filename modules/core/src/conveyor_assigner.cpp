@@ -0,0 +1,142 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "conveyor_assigner.hpp"
+
+#include <algorithm>
+#include <map>
+
+#include "cnstream_affinity.hpp"
+#include "connector.hpp"
+#include "conveyor.hpp"
+
+namespace cnstream {
+
+constexpr uint32_t ConveyorAssigner::kSampleIntervalMs;
+
+ConveyorAssigner::ConveyorAssigner(Connector* connector)
+    : connector_(connector),
+      conveyor_num_(static_cast<uint32_t>(connector->GetConveyorCount())),
+      max_stream_num_(GetMaxStreamNumber()),
+      stream_conveyors_(new std::atomic<int>[GetMaxStreamNumber()]),
+      loads_(connector->GetConveyorCount()),
+      last_sample_time_(std::chrono::steady_clock::now()) {
+  for (uint32_t i = 0; i < max_stream_num_; ++i) stream_conveyors_[i].store(-1, std::memory_order_relaxed);
+}
+
+void ConveyorAssigner::SetPolicy(ConveyorAssignPolicy policy) { policy_.store(policy); }
+
+ConveyorAssignPolicy ConveyorAssigner::GetPolicy() const {
+  return static_cast<ConveyorAssignPolicy>(policy_.load());
+}
+
+uint32_t ConveyorAssigner::GetConveyorIdx(uint32_t chn_idx) {
+  if (chn_idx >= max_stream_num_ || 0 == conveyor_num_) return conveyor_num_ ? chn_idx % conveyor_num_ : 0;
+  int conveyor_idx = stream_conveyors_[chn_idx].load(std::memory_order_acquire);
+  if (conveyor_idx >= 0) return static_cast<uint32_t>(conveyor_idx);
+  return Assign(chn_idx);
+}
+
+uint32_t ConveyorAssigner::Assign(uint32_t chn_idx) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  // assigned by another thread transmitting the data of the stream
+  int assigned = stream_conveyors_[chn_idx].load(std::memory_order_relaxed);
+  if (assigned >= 0) return static_cast<uint32_t>(assigned);
+  uint32_t conveyor_idx = chn_idx % conveyor_num_;
+  if (ASSIGN_LEAST_LOADED == policy_.load()) {
+    SampleLoads();
+    conveyor_idx = FindLeastLoaded(chn_idx);
+    loads_[conveyor_idx].busy_ratio += GetStreamLoad();
+  }
+  ++loads_[conveyor_idx].stream_num;
+  stream_conveyors_[chn_idx].store(static_cast<int>(conveyor_idx), std::memory_order_release);
+  return conveyor_idx;
+}
+
+void ConveyorAssigner::Release(uint32_t chn_idx) {
+  if (chn_idx >= max_stream_num_) return;
+  std::lock_guard<std::mutex> lk(mutex_);
+  int conveyor_idx = stream_conveyors_[chn_idx].load(std::memory_order_relaxed);
+  if (conveyor_idx < 0) return;
+  ConveyorLoad& load = loads_[conveyor_idx];
+  load.busy_ratio = std::max(0.0, load.busy_ratio - GetStreamLoad());
+  --load.stream_num;
+  stream_conveyors_[chn_idx].store(-1, std::memory_order_release);
+}
+
+std::map<uint32_t, uint32_t> ConveyorAssigner::GetAssignment() const {
+  std::map<uint32_t, uint32_t> assignment;
+  for (uint32_t chn_idx = 0; chn_idx < max_stream_num_; ++chn_idx) {
+    int conveyor_idx = stream_conveyors_[chn_idx].load(std::memory_order_acquire);
+    if (conveyor_idx >= 0) assignment[chn_idx] = static_cast<uint32_t>(conveyor_idx);
+  }
+  return assignment;
+}
+
+uint32_t ConveyorAssigner::FindLeastLoaded(uint32_t chn_idx) const {
+  // keep the streams on the conveyors of their numa nodes, see Pipeline::TaskLoop
+  uint32_t step = 1, first = 0;
+  const uint32_t node_num = static_cast<uint32_t>(GetNumaNodeCount());
+  if (stream_numa_placement_.load() && node_num > 1 && 0 == conveyor_num_ % node_num) {
+    step = node_num;
+    first = static_cast<uint32_t>(GetStreamNumaNode(chn_idx));
+  }
+  const double capacity = static_cast<double>(std::max<size_t>(connector_->GetConveyorCapacity(), 1));
+  uint32_t best_idx = first;
+  double best_load = 0;
+  for (uint32_t conveyor_idx = first; conveyor_idx < conveyor_num_; conveyor_idx += step) {
+    const ConveyorLoad& load = loads_[conveyor_idx];
+    double queue_ratio = connector_->GetConveyor(conveyor_idx)->GetBufferSize() / capacity;
+    double total_load = load.busy_ratio + std::min(queue_ratio, 1.0);
+    if (conveyor_idx == first || total_load < best_load ||
+        (total_load == best_load && load.stream_num < loads_[best_idx].stream_num)) {
+      best_idx = conveyor_idx;
+      best_load = total_load;
+    }
+  }
+  return best_idx;
+}
+
+void ConveyorAssigner::SampleLoads() {
+  auto now = std::chrono::steady_clock::now();
+  auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - last_sample_time_).count();
+  if (elapsed_us < static_cast<int64_t>(kSampleIntervalMs) * 1000) return;
+  last_sample_time_ = now;
+  for (uint32_t conveyor_idx = 0; conveyor_idx < conveyor_num_; ++conveyor_idx) {
+    ConveyorLoad& load = loads_[conveyor_idx];
+    uint64_t process_us = connector_->GetConveyor(conveyor_idx)->GetProcessTime();
+    double ratio = std::min(1.0, static_cast<double>(process_us - load.process_us) / elapsed_us);
+    load.process_us = process_us;
+    // the older samples fade out by half in each interval
+    load.busy_ratio = (load.busy_ratio + ratio) / 2;
+  }
+}
+
+double ConveyorAssigner::GetStreamLoad() const {
+  double busy_ratio = 0;
+  uint32_t stream_num = 0;
+  for (const auto& load : loads_) {
+    busy_ratio += load.busy_ratio;
+    stream_num += load.stream_num;
+  }
+  return stream_num ? busy_ratio / stream_num : 0;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_CORE_INCLUDE_CONVEYOR_ASSIGNER_HPP_
+#define MODULES_CORE_INCLUDE_CONVEYOR_ASSIGNER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cnstream_common.hpp"
+
+namespace cnstream {
+
+class Connector;
+
+/**
+ * @brief Assigns the streams to the conveyors of a connector.
+ *
+ * The conveyor of a stream is decided when the first data of the stream is pushed, and is kept until the stream is
+ * released, which the pipeline does after the module has transmitted the EOS of the stream. So the data of a stream
+ * always go through one conveyor in order, and a stream only moves to another conveyor at a stream boundary.
+ *
+ * With ASSIGN_LEAST_LOADED, the load of a conveyor is the share of the recent time spent processing its data (see
+ * Conveyor::AddProcessTime), smoothed over the samples taken at least kSampleIntervalMs apart, plus the fill ratio
+ * of its queue. A new stream goes to the conveyor with the lowest load, or the fewest streams on a tie, and adds the
+ * average load of a stream to the conveyor until the next sample. When stream-to-socket placement is enabled (see
+ * Pipeline::SetStreamNumaPlacement) and the conveyor number is a multiple of the numa node number, only the conveyors of the
+ * numa node of the stream are chosen from.
+ */
+class ConveyorAssigner {
+ public:
+  /* the minimum interval between the samples of the processing time */
+  static constexpr uint32_t kSampleIntervalMs = 100;
+
+  explicit ConveyorAssigner(Connector* connector);
+  /**
+   * @brief Sets the policy for the streams assigned afterwards, the assigned streams keep their conveyors.
+   */
+  void SetPolicy(ConveyorAssignPolicy policy);
+  ConveyorAssignPolicy GetPolicy() const;
+  /**
+   * @brief Keeps the streams on the conveyors of their numa nodes, see Pipeline::SetStreamNumaPlacement.
+   */
+  void SetStreamNumaPlacement(bool enable) { stream_numa_placement_.store(enable); }
+  /**
+   * @brief Gets the conveyor of a stream, the stream is assigned to a conveyor if it has none.
+   */
+  uint32_t GetConveyorIdx(uint32_t chn_idx);
+  /**
+   * @brief Releases the conveyor of a stream, the next data of the stream are assigned again.
+   */
+  void Release(uint32_t chn_idx);
+  /**
+   * @brief Gets the conveyors of the assigned streams, by stream index.
+   */
+  std::map<uint32_t, uint32_t> GetAssignment() const;
+
+ private:
+  uint32_t Assign(uint32_t chn_idx);
+  uint32_t FindLeastLoaded(uint32_t chn_idx) const;
+  /* updates the smoothed busy ratios if kSampleIntervalMs has passed since the last sample */
+  void SampleLoads();
+  /* the average busy ratio added to a conveyor by a stream */
+  double GetStreamLoad() const;
+
+  Connector* connector_;
+  const uint32_t conveyor_num_;
+  /* the streams with an index not less than it are always assigned by stream index */
+  const uint32_t max_stream_num_;
+  std::atomic<int> policy_{ASSIGN_BY_STREAM_INDEX};
+  std::atomic<bool> stream_numa_placement_{false};
+  /* the conveyor of each stream indexed by stream index, -1 if the stream is not assigned */
+  std::unique_ptr<std::atomic<int>[]> stream_conveyors_;
+
+  struct ConveyorLoad {
+    uint64_t process_us = 0;  // the processing time of the conveyor at the last sample
+    double busy_ratio = 0;    // the smoothed share of time spent processing data
+    uint32_t stream_num = 0;  // the number of the streams assigned
+  };
+  /* guards the assignment and the loads, only taken when a stream is assigned or released */
+  mutable std::mutex mutex_;
+  std::vector<ConveyorLoad> loads_;
+  std::chrono::steady_clock::time_point last_sample_time_;
+  DISABLE_COPY_AND_ASSIGN(ConveyorAssigner);
+};  // class ConveyorAssigner
+
+}  // namespace cnstream
+
+#endif  // MODULES_CORE_INCLUDE_CONVEYOR_ASSIGNER_HPP_
@@ -0,0 +1,148 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_CORE_INCLUDE_LOCKFREE_QUEUE_HPP_
+#define MODULES_CORE_INCLUDE_LOCKFREE_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace cnstream {
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * The queue is a ring buffer with a fixed power-of-two capacity. Each cell carries a sequence number
+ * that tells producers and consumers whether the cell is free to write or ready to read, so that
+ * pushing and popping only cost one CAS on the enqueue or dequeue position (Dmitry Vyukov's algorithm).
+ *
+ * The queue never blocks. TryPush returns false when the queue is full and TryPop returns false when
+ * the queue is empty, waiting is left to the caller.
+ */
+template <typename T>
+class LockFreeQueue {
+ public:
+  /**
+   * @param capacity The minimum capacity of the queue. It is rounded up to a power of two.
+   */
+  explicit LockFreeQueue(size_t capacity);
+  LockFreeQueue(const LockFreeQueue& other) = delete;
+  LockFreeQueue& operator=(const LockFreeQueue& other) = delete;
+
+  bool TryPush(const T& value);
+
+  bool TryPop(T& value);  // NOLINT
+
+  /* approximate when there are concurrent producers or consumers */
+  uint32_t Size() const;
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+  static const size_t kCacheLineSize = 64;
+  using CacheLinePad = char[kCacheLineSize];
+
+  CacheLinePad pad0_;
+  std::unique_ptr<Cell[]> buffer_;
+  size_t mask_ = 0;
+  CacheLinePad pad1_;
+  std::atomic<size_t> enqueue_pos_{0};
+  CacheLinePad pad2_;
+  std::atomic<size_t> dequeue_pos_{0};
+  CacheLinePad pad3_;
+};
+
+template <typename T>
+LockFreeQueue<T>::LockFreeQueue(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) size <<= 1;
+  buffer_.reset(new Cell[size]);
+  mask_ = size - 1;
+  for (size_t i = 0; i < size; ++i) {
+    buffer_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool LockFreeQueue<T>::TryPush(const T& value) {
+  Cell* cell;
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &buffer_[pos & mask_];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      // full
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = value;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+bool LockFreeQueue<T>::TryPop(T& value) {  // NOLINT
+  Cell* cell;
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &buffer_[pos & mask_];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      // empty
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  value = std::move(cell->data);
+  cell->data = T();
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+uint32_t LockFreeQueue<T>::Size() const {
+  size_t head = dequeue_pos_.load(std::memory_order_acquire);
+  size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+  if (tail <= head) return 0;
+  size_t size = tail - head;
+  return static_cast<uint32_t>(size > Capacity() ? Capacity() : size);
+}
+
+}  // namespace cnstream
+
+#endif  // MODULES_CORE_INCLUDE_LOCKFREE_QUEUE_HPP_
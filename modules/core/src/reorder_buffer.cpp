@@ -0,0 +1,80 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "reorder_buffer.hpp"
+
+namespace cnstream {
+
+uint64_t ReorderBuffer::Push(const CNFrameInfoPtr& data) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  StreamState& state = streams_[data->channel_idx];
+  Entry entry;
+  entry.data = data;
+  state.entries.push_back(std::move(entry));
+  return next_seqs_[data->channel_idx]++;
+}
+
+bool ReorderBuffer::Done(const CNFrameInfoPtr& data, bool emit, const Emitter& emitter) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  StreamState* state = nullptr;
+  Entry* entry = nullptr;
+  auto state_it = streams_.find(data->channel_idx);
+  if (state_it != streams_.end()) {
+    state = &state_it->second;
+    // the pending data are a few times the thread number, so they are searched from the oldest one
+    for (auto& it : state->entries) {
+      if (it.data == data) {
+        entry = &it;
+        break;
+      }
+    }
+  }
+  if (!entry) {
+    lk.unlock();
+    return !emit || emitter(data);
+  }
+  entry->done = true;
+  entry->emit = emit;
+  // the emitting thread emits this data as well
+  if (state->emitting) return true;
+  state->emitting = true;
+  bool ret = true;
+  while (!state->entries.empty() && state->entries.front().done) {
+    Entry ready = std::move(state->entries.front());
+    state->entries.pop_front();
+    if (!ready.emit) continue;
+    lk.unlock();
+    ret = emitter(ready.data) && ret;
+    lk.lock();
+  }
+  state->emitting = false;
+  // only the emitting thread erases the state, by key as the map may have been rehashed while it was unlocked
+  if (state->entries.empty()) streams_.erase(data->channel_idx);
+  return ret;
+}
+
+size_t ReorderBuffer::GetPendingNumber() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  size_t num = 0;
+  for (const auto& it : streams_) num += it.second.entries.size();
+  return num;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,88 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_CORE_INCLUDE_REORDER_BUFFER_HPP_
+#define MODULES_CORE_INCLUDE_REORDER_BUFFER_HPP_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "cnstream_frame.hpp"
+
+namespace cnstream {
+
+using CNFrameInfoPtr = std::shared_ptr<CNFrameInfo>;
+
+/**
+ * @brief Restores the order of the data of each stream processed by several threads at the same time.
+ *
+ * The data are registered by Push in the order they are dispatched to the threads, and are emitted in that order
+ * after they are done, whichever thread finishes first. The data dropped by the threads are marked done without
+ * being emitted, so they never hold back the following data.
+ *
+ * The emission of a stream is never run by two threads at the same time: the thread marking a data done emits the
+ * ready data of the stream unless another thread is emitting them, which then emits the newly ready data as well.
+ * So the emitter is called in order and without the lock held, and the other threads are not blocked when the
+ * emitter blocks.
+ */
+class ReorderBuffer {
+ public:
+  /* emits a data in order, returns false if it failed */
+  using Emitter = std::function<bool(const CNFrameInfoPtr&)>;
+  /**
+   * @brief Registers data in the order they are dispatched.
+   * @return the sequence number of the data in its stream, it keeps increasing while the stream has no data pending.
+   */
+  uint64_t Push(const CNFrameInfoPtr& data);
+  /**
+   * @brief Marks data done, and emits the data of its stream that are ready in order.
+   * @param
+   *   [emit]: false if the data is dropped.
+   * @return false if the emitter failed. The data not registered are emitted at once.
+   */
+  bool Done(const CNFrameInfoPtr& data, bool emit, const Emitter& emitter);
+  /**
+   * @brief Gets the number of the data registered and not emitted or dropped yet.
+   */
+  size_t GetPendingNumber() const;
+
+ private:
+  struct Entry {
+    CNFrameInfoPtr data;
+    bool done = false;
+    bool emit = false;
+  };
+  struct StreamState {
+    std::deque<Entry> entries;  // in dispatch order
+    bool emitting = false;
+  };
+  mutable std::mutex mutex_;
+  /* the states of the streams having data pending, erased when the streams have none */
+  std::unordered_map<uint32_t /*channel_idx*/, StreamState> streams_;
+  /* the sequence numbers are kept, so that the data of a stream sent one by one still go round the threads */
+  std::unordered_map<uint32_t /*channel_idx*/, uint64_t> next_seqs_;
+};  // class ReorderBuffer
+
+}  // namespace cnstream
+
+#endif  // MODULES_CORE_INCLUDE_REORDER_BUFFER_HPP_
@@ -0,0 +1,135 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "work_stealing_executor.hpp"
+
+#include <string>
+#include <utility>
+
+namespace cnstream {
+
+/* the executor and the worker index of the current thread */
+static thread_local const WorkStealingExecutor* tls_executor = nullptr;
+static thread_local uint32_t tls_worker_idx = 0;
+
+WorkStealingExecutor::WorkStealingExecutor(uint32_t thread_num, const std::string& name)
+    : thread_num_(thread_num), name_(name) {
+  if (0 == thread_num_) thread_num_ = std::thread::hardware_concurrency();
+  if (0 == thread_num_) thread_num_ = 1;
+  for (uint32_t i = 0; i < thread_num_; ++i) {
+    worker_queues_.emplace_back(new WorkerQueue);
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() { Stop(); }
+
+void WorkStealingExecutor::Start() {
+  if (running_.exchange(true)) return;
+  for (uint32_t i = 0; i < thread_num_; ++i) {
+    threads_.push_back(std::thread(&WorkStealingExecutor::WorkerLoop, this, i));
+  }
+}
+
+void WorkStealingExecutor::Stop() {
+  if (!running_.exchange(false)) return;
+  {
+    std::lock_guard<std::mutex> lk(sleep_mutex_);
+  }
+  sleep_cond_.notify_all();
+  for (auto& it : threads_) {
+    if (it.joinable()) it.join();
+  }
+  threads_.clear();
+}
+
+bool WorkStealingExecutor::InWorkerThread() const { return tls_executor == this; }
+
+void WorkStealingExecutor::Submit(Task task) {
+  WorkerQueue* queue = InWorkerThread() ? worker_queues_[tls_worker_idx].get() : &inject_queue_;
+  {
+    CNSpinLockGuard lk(queue->lock);
+    queue->tasks.push_back(std::move(task));
+  }
+  pending_++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed)) {
+    {
+      std::lock_guard<std::mutex> lk(sleep_mutex_);
+    }
+    sleep_cond_.notify_one();
+  }
+}
+
+bool WorkStealingExecutor::PopTask(uint32_t worker_idx, Task* task) {
+  // own queue, LIFO
+  WorkerQueue* queue = worker_queues_[worker_idx].get();
+  {
+    CNSpinLockGuard lk(queue->lock);
+    if (!queue->tasks.empty()) {
+      *task = std::move(queue->tasks.back());
+      queue->tasks.pop_back();
+      return true;
+    }
+  }
+  // injection queue, FIFO
+  {
+    CNSpinLockGuard lk(inject_queue_.lock);
+    if (!inject_queue_.tasks.empty()) {
+      *task = std::move(inject_queue_.tasks.front());
+      inject_queue_.tasks.pop_front();
+      return true;
+    }
+  }
+  // steal the oldest task from other workers
+  for (uint32_t i = 1; i < thread_num_; ++i) {
+    WorkerQueue* victim = worker_queues_[(worker_idx + i) % thread_num_].get();
+    CNSpinLockGuard lk(victim->lock);
+    if (!victim->tasks.empty()) {
+      *task = std::move(victim->tasks.front());
+      victim->tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingExecutor::WorkerLoop(uint32_t worker_idx) {
+  tls_executor = this;
+  tls_worker_idx = worker_idx;
+  SetThreadName(name_ + std::to_string(worker_idx), pthread_self());
+  Task task;
+  while (true) {
+    if (PopTask(worker_idx, &task)) {
+      pending_--;
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(sleep_mutex_);
+    sleeping_++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    sleep_cond_.wait(lk, [this] { return pending_.load() > 0 || !running_.load(); });
+    sleeping_--;
+    if (!running_.load() && pending_.load() <= 0) break;
+  }
+  tls_executor = nullptr;
+}
+
+}  // namespace cnstream
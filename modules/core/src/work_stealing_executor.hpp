@@ -0,0 +1,94 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_CORE_INCLUDE_WORK_STEALING_EXECUTOR_HPP_
+#define MODULES_CORE_INCLUDE_WORK_STEALING_EXECUTOR_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cnstream_common.hpp"
+
+namespace cnstream {
+
+/**
+ * @brief A fixed size thread pool whose workers steal tasks from each other.
+ *
+ * Each worker owns a task deque. Tasks submitted by a worker are pushed to the back of its own deque and
+ * the worker pops tasks from the back, so a task and the tasks it spawns run depth-first on the same core.
+ * Tasks submitted by other threads go to a shared injection queue. An idle worker takes tasks from the
+ * injection queue first, then steals from the front of the other workers' deques, and sleeps when there is
+ * no task at all.
+ */
+class WorkStealingExecutor {
+ public:
+  using Task = std::function<void()>;
+
+  /**
+   * @param
+   *   [thread_num]: the number of worker threads, 0 means the number of CPU cores.
+   *   [name]: prefix of the worker thread names.
+   */
+  explicit WorkStealingExecutor(uint32_t thread_num = 0, const std::string& name = "cn-worker");
+  ~WorkStealingExecutor();
+
+  void Start();
+  /* Stops the workers after the submitted tasks are done. */
+  void Stop();
+
+  void Submit(Task task);
+
+  uint32_t GetThreadNum() const { return thread_num_; }
+  /* whether the calling thread is a worker of this executor */
+  bool InWorkerThread() const;
+
+ private:
+  struct WorkerQueue {
+    CNSpinLock lock;
+    std::deque<Task> tasks;
+  };
+
+  void WorkerLoop(uint32_t worker_idx);
+  bool PopTask(uint32_t worker_idx, Task* task);
+
+  uint32_t thread_num_;
+  std::string name_;
+  std::vector<std::unique_ptr<WorkerQueue>> worker_queues_;
+  WorkerQueue inject_queue_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> running_{false};
+  /* number of tasks in all queues */
+  std::atomic<int64_t> pending_{0};
+  std::atomic<uint32_t> sleeping_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  DISABLE_COPY_AND_ASSIGN(WorkStealingExecutor);
+};  // class WorkStealingExecutor
+
+}  // namespace cnstream
+
+#endif  // MODULES_CORE_INCLUDE_WORK_STEALING_EXECUTOR_HPP_
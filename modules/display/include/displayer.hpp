@@ -76,6 +76,7 @@ class Displayer : public Module, public ModuleCreator<Displayer> {
    *   cols: display image columns
    *   rows: display image rows
    *   refresh-rate: display refresh rate
+   *   rendition: optional, the name of the frame rendition to display, see CNFrameInfo::GetRendition
    * @endverbatim
    *
    * @return if module open succeed
@@ -125,6 +126,7 @@ class Displayer : public Module, public ModuleCreator<Displayer> {
  private:
   SDLVideoPlayer* player_;
   bool show_ = false;
+  std::string rendition_;
 };  // class Displayer
 
 }  // namespace cnstream
@@ -36,6 +36,7 @@ Displayer::Displayer(const std::string &name) : Module(name) {
   param_register_.Register("max-channels", "Max channel number.");
   param_register_.Register("full-screen", "Whether the video will be displayed on full screen.");
   param_register_.Register("show", "Whether show.");
+  param_register_.Register("rendition", "Name of the frame rendition to use (default: full frame).");
 }
 
 Displayer::~Displayer() { delete player_; }
@@ -52,6 +53,10 @@ bool Displayer::Open(ModuleParamSet paramSet) {
     full_screen = paramSet["full-screen"] == "true" ? true : false;
   }
   show_ = paramSet["show"] == "true" ? true : false;
+  rendition_.clear();
+  if (paramSet.find("rendition") != paramSet.end()) {
+    rendition_ = paramSet["rendition"];
+  }
   int window_w = std::stoi(paramSet["window-width"]);
   int window_h = std::stoi(paramSet["window-height"]);
   int display_rate = std::stoi(paramSet["refresh-rate"]);
@@ -84,7 +89,7 @@ void Displayer::Close() {
 int Displayer::Process(CNFrameInfoPtr data) {
   if (show_) {
     UpdateData ud;
-    ud.img = *data->frame.ImageBGR();
+    ud.img = *data->GetRendition(rendition_)->ImageBGR();
     ud.chn_idx = data->channel_idx;
     player_->FeedData(ud);
   }
@@ -82,6 +82,7 @@ class Inferencer : public Module, public ModuleCreator<Inferencer> {
    * func_name: The function name that is defined in the offline model. It could be found in Cambricon twins file. For most cases, it is "subnet0".
    * postproc_name: The class name for postprocessing. See cnstream::Postproc.
    * preproc_name: The class name for preprocessing on CPU. See cnstream::Preproc.
+   * preproc_rendition: The name of the frame rendition preprocessed on CPU. See CNFrameInfo::GetRendition.
    * device_id: MLU device ordinal number.
    * batch_size: The batch size. The maximum value is 32. The default value if 1. Only active on MLU100.
    * batching_timeout: The batching timeout. The default value is 3000.0[ms]. type[float]. unit[ms].
@@ -72,6 +72,24 @@ class Preproc : virtual public ReflexObjectEx<Preproc> {
    */
   virtual int Execute(const std::vector<float*>& net_inputs, const std::shared_ptr<edk::ModelLoader>& model,
                       const CNFrameInfoPtr& package) = 0;
+  /**
+   * @brief Set the name of the frame rendition to be preprocessed
+   *
+   * @param name: rendition name, see CNFrameInfo::GetRendition. The full-resolution frame is used if it is empty.
+   *
+   * @return None
+   */
+  void SetRenditionName(const std::string& name) { rendition_name_ = name; }
+  /**
+   * @brief Get the name of the frame rendition to be preprocessed, implementations read the frame by
+   * ``package->GetRendition(GetRenditionName())``
+   *
+   * @return Returns the rendition name
+   */
+  const std::string& GetRenditionName() const { return rendition_name_; }
+
+ private:
+  std::string rendition_name_;
 };  // class Preproc
 
 }  // namespace cnstream
@@ -35,6 +35,7 @@ void InferThreadPool::Init(int dev_id, size_t thread_num) {
   dev_id_ = dev_id;
   running_ = true;
   max_tnum_ = 2 * thread_num;
+  // threads inherit the cpu affinity of the calling module thread, see Module::BindThread
   for (size_t ti = 0; ti < thread_num; ++ti) {
     threads_.push_back(std::thread(&InferThreadPool::TaskLoop, this));
   }
@@ -94,6 +94,7 @@ Inferencer::Inferencer(const std::string& name) : Module(name) {
                            " with cambricon extension.");
   param_register_.Register("func_name", "The offline model function name, usually is 'subnet0'.");
   param_register_.Register("peproc_name", "The preprocessing method name.");
+  param_register_.Register("preproc_rendition", "Name of the frame rendition to use (default: full frame).");
   param_register_.Register("postproc_name", "The postprocessing method name.");
   param_register_.Register("device_id", "Which device will be used. If there is only one device, it might be 0.");
   param_register_.Register("batching_timeout",
@@ -171,6 +172,9 @@ bool Inferencer::Open(ModuleParamSet paramSet) {
       LOG(ERROR) << "[Inferencer] CPU preproc name not found: " << preproc_name->second;
       return false;
     }
+    if (paramSet.find("preproc_rendition") != paramSet.end()) {
+      d_ptr_->pre_proc_->SetRenditionName(paramSet["preproc_rendition"]);
+    }
     LOG(INFO) << "[Inferencer] With CPU preproc set";
   }
 
@@ -30,6 +30,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "cnstream_frame.hpp"
 #include "cnstream_pipeline.hpp"
@@ -37,6 +38,8 @@
 
 namespace cnstream {
 
+class StreamWorkerPool;
+
 /**
  *  @brief The type of stream or source to be processed.
  */
@@ -58,6 +61,43 @@ enum DecoderType {
   DECODER_CPU,   ///< CPU decoder with FFmpeg.
   DECODER_MLU    ///< MLU decoder with CNCodec.
 };
+/**
+ * @brief The behavior of the source when the frames of a stream in flight reach the limit.
+ */
+enum AdmissionPolicy {
+  ADMISSION_BLOCK,  ///< Waits until a frame of the stream is released.
+  ADMISSION_DROP    ///< Drops the decoded frame.
+};
+/**
+ * @brief The threading method of the CPU decoder.
+ */
+enum DecodeThreadType {
+  DECODE_THREAD_FRAME,  ///< Decodes several frames in parallel. Adds one frame of latency per thread.
+  DECODE_THREAD_SLICE   ///< Decodes the slices of a frame in parallel. Depends on how the stream is encoded.
+};
+/**
+ * @brief The frames the CPU decoder skips decoding.
+ */
+enum DecodeSkipMode {
+  DECODE_SKIP_NONE,    ///< Decodes all the frames.
+  DECODE_SKIP_NONREF,  ///< Skips the frames that are not referenced by other frames, e.g. the non-reference B frames.
+  DECODE_SKIP_NONKEY   ///< Decodes the key frames only.
+};
+/**
+ * @brief How the source paces the streams.
+ */
+enum PacingMode {
+  PACING_FRAME_RATE,  ///< By the frame rate the stream is added with. Not paced if the frame rate is 0.
+  PACING_PTS          ///< By the timestamps of the packets, divided by the speed.
+};
+/**
+ * @brief A scaled rendition of the decoded frames, see CNFrameInfo::renditions.
+ */
+struct RenditionParam {
+  std::string name;  ///< The name the modules select the rendition by.
+  int width = 0;     ///< The width of the rendition.
+  int height = 0;    ///< The height of the rendition.
+};
 /**
  * @brief A structure for private usage.
  */
@@ -67,8 +107,9 @@ struct DataSourceParam {
   size_t interval_ = 1;                     ///< Outputs image every ``interval`` frames.
   DecoderType decoder_type_ = DECODER_CPU;  ///< The decoder type.
   bool reuse_cndec_buf = false;             ///< Valid when ``DECODER_MLU`` is used.
+  bool reuse_cpudec_buf = false;            ///< Valid when ``DECODER_CPU`` is used and ``output_type`` is cpu.
   int device_id_ = -1;                      ///< The MLU device ID. To disable MLU, set the value to ``-1`` .
-  size_t chunk_size_ = 0;                   ///< Valid when ``SOURCE_RAW`` is used. For H264 and H265 only.
+  size_t chunk_size_ = 0;                   ///< Valid when ``SOURCE_RAW`` is used. 0 means frame mode.
   size_t width_ = 0;                        ///< Valid when ``SOURCE_RAW`` is used. For H264 and H265 only.
   size_t height_ = 0;                       ///< Valid when ``SOURCE_RAW`` is used. For H264 and H265 only.
   bool interlaced_ = false;                 ///< Valid when ``SOURCE_RAW`` is used. For H264 and H265 only.
@@ -76,6 +117,29 @@ struct DataSourceParam {
   size_t output_h = 0;                      ///< Valid for MLU100.
   uint32_t input_buf_number_ = 2;           ///< Valid when ``decoder_type`` is set to ``DECODER_MLU``.
   uint32_t output_buf_number_ = 3;          ///< Valid when ``decoder_type`` is set to ``DECODER_MLU``.
+  AdmissionPolicy admission_policy_ = ADMISSION_BLOCK;  ///< The behavior when the frames in flight reach the limit.
+  int decode_threads_ = 1;                  ///< Valid when ``DECODER_CPU`` is used. 0 means auto.
+  DecodeThreadType decode_thread_type_ = DECODE_THREAD_FRAME;  ///< Valid when ``DECODER_CPU`` is used.
+  DecodeSkipMode decode_skip_ = DECODE_SKIP_NONE;              ///< Valid when ``DECODER_CPU`` is used.
+  int worker_num_ = 0;  ///< The number of workers shared by the streams. 0 means one thread per stream.
+  uint32_t readahead_packets_ = 0;  ///< Valid when ``SOURCE_FFMPEG`` is used. 0 means not bounded by packets.
+  uint64_t readahead_bytes_ = 0;    ///< Valid when ``SOURCE_FFMPEG`` is used. 0 means not bounded by bytes.
+  bool loop_cache_ = false;         ///< Valid when ``SOURCE_FFMPEG`` is used and the stream is looped.
+  PacingMode pacing_ = PACING_FRAME_RATE;  ///< How the streams are paced.
+  double speed_ = 1.0;                     ///< Valid when ``PACING_PTS`` is used.
+  std::vector<RenditionParam> renditions_;  ///< Valid when ``DECODER_CPU`` is used.
+};
+/**
+ * @brief The state of the packets read ahead of the decoder of a stream.
+ */
+struct ReadAheadStat {
+  uint32_t packets = 0;          ///< The packets in the queue.
+  uint64_t bytes = 0;            ///< The bytes of the packets in the queue.
+  uint32_t max_packets = 0;      ///< The most packets ever in the queue.
+  uint64_t reader_wait_ms = 0;   ///< How long the reader waited for room, i.e. the decoding is the bottleneck.
+  uint64_t decoder_wait_ms = 0;  ///< How long the decoder waited for packets, i.e. the input is the bottleneck.
+  uint64_t reader_waits = 0;     ///< The times the reader found the queue full and waited for room.
+  uint64_t decoder_waits = 0;    ///< The times the decoder found the queue empty and waited for packets.
 };
 
 /**
@@ -105,13 +169,54 @@ class DataSource : public SourceModule, public ModuleCreator<DataSource> {
    * interval: Optional. The interval during which the data is handled.
    * decoder_type : Required. The decoder type. Supported values are ``mlu`` and ``cpu``.
    * reuse_cndec_buf: Optional. This parameter should be set when MLU decoder is used. Supported values are ``true`` and ``false``.
+   * reuse_cpudec_buf: Optional. Valid when CPU decoder is used and ``output_type`` is cpu. Supported values are ``true``
+   *                   and ``false``. If true, the frames reference the FFmpeg decoder buffers in their native layout
+   *                   (e.g. ``CN_PIXEL_FORMAT_YUV420P``) instead of copying and repacking them to NV21.
    * device_id: Required when MLU is used. Set the value to -1 for CPU. Set the value for MLU in the range 0 - N.
-   * chunk_size: Required when ``source_type`` is set to ``raw``.
+   * chunk_size: Required when ``source_type`` is set to ``raw``. The bytes sent to the decoder at a time. 0 means
+   *             frame mode, the file is mapped and sent to the decoder by access units. The codec of the H264 or
+   *             H265 Annex-B stream is detected from the bitstream.
    * width: Required when ``source_type`` is set to ``raw``.
    * height: Required when ``source_type`` is set to ``raw``.
    * interlaced: Required when ``source_type`` is set to ``raw``.
    * input_buf_number: Optional. The input buffer number.
    * output_buf_number: Optional. The output buffer number.
+   * admission_policy: Optional. The behavior when the frames of a stream in flight reach the limit. Supported values
+   *                   are ``block`` and ``drop``. The default value is ``block``.
+   * decode_threads: Optional. The number of threads used by the CPU decoder of each stream. 0 means as many as the
+   *                 CPU cores. The default value is 1.
+   * decode_thread_type: Optional. The threading method of the CPU decoder. Supported values are ``frame`` and
+   *                     ``slice``. The default value is ``frame``.
+   * decode_skip: Optional. The frames the CPU decoder skips decoding. Supported values are ``none``, ``nonref`` (skip
+   *              the non-reference frames) and ``nonkey`` (decode key frames only). The default value is ``none``.
+   *              ``interval`` applies to the decoded frames, and the frame ids of the output frames stay continuous.
+   * worker_num: Optional. The number of workers demuxing and decoding all the streams. Each worker runs one step of
+   *             a stream (read a packet, decode and send the frames) at a time, and the streams keep their frame
+   *             order and frame rate. 0 means each stream has a thread of its own. The default value is 0.
+   *             The workers block while a stream waits for the frames in flight with the ``block`` admission policy.
+   * readahead_packets: Optional. Valid when ``source_type`` is set to ``ffmpeg``. The most packets read ahead of the
+   *                    decoder of each stream by a reader thread, so that the input stalls and the decoding stalls do
+   *                    not hold each other up. The default value is 0.
+   * readahead_bytes: Optional. Valid when ``source_type`` is set to ``ffmpeg``. The most bytes of the packets read
+   *                  ahead of the decoder of each stream. The default value is 0. The packets are read ahead if
+   *                  either ``readahead_packets`` or ``readahead_bytes`` is greater than 0, the bound set to 0 is not
+   *                  applied.
+   * loop_cache: Optional. Valid when ``source_type`` is set to ``ffmpeg`` and the stream is added with ``loop``. If
+   *             true, the file is demuxed once into memory and the packets are replayed forever, with the timestamps
+   *             increasing from one replay to the next. The packets of a file are shared by all its streams. Live
+   *             streams are not cached. Supported values are ``true`` and ``false``. The default value is ``false``.
+   * pacing: Optional. How the streams are paced. Supported values are ``framerate`` (by the frame rate the stream is
+   *         added with) and ``pts`` (by the timestamps of the packets and the time base of the stream, so that the
+   *         variable frame rate streams do not drift). The streams without timestamps, e.g. the raw streams, are
+   *         paced by the frame rate. The default value is ``framerate``. With ``worker_num``, the streams are
+   *         released at their due times by a timer wheel shared by the streams.
+   * speed: Optional. Valid when ``pacing`` is set to ``pts``. The playback speed, e.g. 2 or 4 for accelerated offline
+   *        analysis. It should be greater than 0. The default value is 1.
+   * renditions: Optional. Valid when ``decoder_type`` is set to ``cpu``. The scaled renditions attached to each
+   *             frame besides the full-resolution one, in the format of ``name:WIDTHxHEIGHT`` separated by commas,
+   *             e.g. ``analytics:640x360,preview:320x180``. Each rendition is scaled and converted to NV21 from the
+   *             decoded frame by one swscale pass, and is stored in host memory. The modules select a rendition by
+   *             name, see CNFrameInfo::GetRendition. The width and the height should be even numbers.
    *@endverbatim
    *
    * @return
@@ -150,6 +255,18 @@ class DataSource : public SourceModule, public ModuleCreator<DataSource> {
    * @brief Gets module parameters. This function should be called after ``Open()`` has been invoked.
    */
   DataSourceParam GetSourceParam() const { return param_; }
+  /**
+   * @brief Gets the workers shared by the streams. Returns nullptr if each stream has a thread of its own.
+   */
+  std::shared_ptr<StreamWorkerPool> GetWorkerPool() const { return worker_pool_; }
+  /**
+   * @brief Gets the state of the packets read ahead of the decoder of a stream.
+   * @param stream_id[in]: The unique stream identifier.
+   * @param stat[out]: The state of the packets read ahead.
+   * @return
+   *    Returns false if the stream is not found or its packets are not read ahead.
+   */
+  bool GetReadAheadStat(const std::string &stream_id, ReadAheadStat *stat);
 
 #ifdef UNIT_TEST
   bool SendData(std::shared_ptr<CNFrameInfo> data) { return SourceModule::SendData(data); }
@@ -157,6 +274,7 @@ class DataSource : public SourceModule, public ModuleCreator<DataSource> {
 
  private:
   DataSourceParam param_;
+  std::shared_ptr<StreamWorkerPool> worker_pool_ = nullptr;
 };  // class DataSource
 
 }  // namespace cnstream
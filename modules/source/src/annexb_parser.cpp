@@ -0,0 +1,126 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "annexb_parser.hpp"
+
+#include <cstring>
+
+namespace cnstream {
+
+/*the number of NAL units looked into for the codec*/
+static constexpr int kDetectNalNum = 64;
+
+AnnexBParser::AnnexBParser(const uint8_t *data, size_t size, Codec codec) : data_(data), size_(size), codec_(codec) {
+  Reset();
+}
+
+void AnnexBParser::Reset() { pos_ = FindStartCode(0); }
+
+// returns the offset of the start code found from ``from``, the leading zero of a 4-byte start code included
+size_t AnnexBParser::FindStartCode(size_t from) const {
+  size_t i = from + 2;
+  while (i < size_) {
+    const uint8_t *one = static_cast<const uint8_t *>(memchr(data_ + i, 0x01, size_ - i));
+    if (!one) break;
+    i = one - data_;
+    if (data_[i - 1] == 0 && data_[i - 2] == 0) {
+      size_t start = i - 2;
+      if (start > from && data_[start - 1] == 0) start--;
+      return start;
+    }
+    i++;
+  }
+  return size_;
+}
+
+// returns the offset of the NAL unit header after the start code at ``pos``
+size_t AnnexBParser::SkipStartCode(size_t pos) const {
+  while (pos < size_ && data_[pos] == 0) pos++;
+  return pos + 1;
+}
+
+AnnexBParser::Codec AnnexBParser::DetectCodec(const uint8_t *data, size_t size) {
+  AnnexBParser parser(data, size, CODEC_UNKNOWN);
+  size_t pos = parser.pos_;
+  for (int i = 0; i < kDetectNalNum && pos < size; ++i) {
+    size_t nal = parser.SkipStartCode(pos);
+    size_t next = parser.FindStartCode(nal);
+    if (nal + 1 < next) {
+      uint8_t b0 = data[nal], b1 = data[nal + 1];
+      // H.265 VPS or SPS of the base layer, the first temporal sub-layer
+      if ((b0 == 0x40 || b0 == 0x42) && b1 == 0x01) return CODEC_HEVC;
+      // H.264 SPS, forbidden_zero_bit is 0 and nal_ref_idc is not 0
+      if ((b0 & 0x9f) == 7 && (b0 & 0x60)) return CODEC_H264;
+    }
+    pos = next;
+  }
+  return CODEC_UNKNOWN;
+}
+
+bool AnnexBParser::Next(AccessUnit *au) {
+  if (codec_ == CODEC_UNKNOWN || pos_ >= size_) return false;
+  bool vcl_found = false;
+  bool key = false;
+  size_t cur = pos_;
+  while (cur < size_) {
+    size_t nal = SkipStartCode(cur);
+    size_t next = FindStartCode(nal);
+    // the NAL unit header is 1 byte for H264, 2 bytes for H265
+    size_t header_size = codec_ == CODEC_H264 ? 1 : 2;
+    if (nal + header_size <= next) {
+      bool vcl = false, irap = false, first_of_au = false;
+      if (codec_ == CODEC_H264) {
+        int type = data_[nal] & 0x1f;
+        if (type >= 1 && type <= 5) {
+          vcl = true;
+          irap = type == 5;
+          // first_mb_in_slice is 0
+          first_of_au = nal + 1 < next && (data_[nal + 1] & 0x80);
+        } else {
+          // SEI, SPS, PPS, AUD and 14 - 18
+          first_of_au = (type >= 6 && type <= 9) || (type >= 14 && type <= 18);
+        }
+      } else {
+        int type = (data_[nal] >> 1) & 0x3f;
+        if (type <= 31) {
+          vcl = true;
+          irap = type >= 16 && type <= 23;
+          // first_slice_segment_in_pic_flag is 1
+          first_of_au = nal + 2 < next && (data_[nal + 2] & 0x80);
+        } else {
+          // VPS, SPS, PPS, AUD, prefix SEI, 41 - 44 and 48 - 55
+          first_of_au = (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44) ||
+                        (type >= 48 && type <= 55);
+        }
+      }
+      // the access unit ends before the first NAL unit of the next one
+      if (vcl_found && first_of_au) break;
+      vcl_found = vcl_found || vcl;
+      key = key || irap;
+    }
+    cur = next;
+  }
+  au->data = data_ + pos_;
+  au->size = cur - pos_;
+  au->key = key;
+  pos_ = cur;
+  return true;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,72 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_SOURCE_ANNEXB_PARSER_HPP_
+#define MODULES_SOURCE_ANNEXB_PARSER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cnstream {
+
+/**
+ * Splits an H.264 or H.265 Annex-B elementary stream into access units in place.
+ *
+ * The access units point into the data given to the parser, start codes included, and are valid as long as the data.
+ */
+class AnnexBParser {
+ public:
+  enum Codec { CODEC_UNKNOWN, CODEC_H264, CODEC_HEVC };
+  struct AccessUnit {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    bool key = false;  ///< Has an IDR picture (H.264) or an IRAP picture (H.265).
+  };
+
+  /**
+   * Detects the codec by the first parameter set of the stream.
+   *
+   * @return Returns CODEC_UNKNOWN if no parameter set is found in the first NAL units.
+   */
+  static Codec DetectCodec(const uint8_t *data, size_t size);
+
+  AnnexBParser(const uint8_t *data, size_t size, Codec codec);
+  /**
+   * Gets the next access unit.
+   *
+   * @return Returns false at the end of the stream.
+   */
+  bool Next(AccessUnit *au);
+  /**
+   * Goes back to the beginning of the stream.
+   */
+  void Reset();
+
+ private:
+  size_t FindStartCode(size_t from) const;
+  size_t SkipStartCode(size_t pos) const;
+  const uint8_t *data_;
+  size_t size_;
+  Codec codec_;
+  size_t pos_ = 0;
+};  // class AnnexBParser
+
+}  // namespace cnstream
+
+#endif  // MODULES_SOURCE_ANNEXB_PARSER_HPP_
@@ -57,9 +57,17 @@ bool DataHandler::Open() {
   dev_ctx_.ddr_channel = chn_idx % 4;  // FIXME
 
   this->interval_ = param_.interval_;
+  pts_controller_ = PtsController(param_.speed_);
 
   // start demuxer
   running_.store(1);
+  worker_pool_ = source->GetWorkerPool();
+  if (worker_pool_) {
+    prepared_ = false;
+    unscheduled_ = false;
+    worker_pool_->Add(this);
+    return true;
+  }
   thread_ = std::move(std::thread(&DataHandler::Loop, this));
   return true;
 }
@@ -67,13 +75,22 @@ bool DataHandler::Open() {
 void DataHandler::Close() {
   if (running_.load()) {
     running_.store(0);
+    // wake up the decoder waiting for the frames in flight
+    admission_->Close();
+    if (worker_pool_) {
+      worker_pool_->Kick(this);
+      std::unique_lock<std::mutex> lk(unscheduled_mutex_);
+      unscheduled_cond_.wait(lk, [this] { return unscheduled_; });
+      lk.unlock();
+      worker_pool_.reset();
+    }
     if (thread_.joinable()) {
       thread_.join();
     }
   }
 }
 
-void DataHandler::Loop() {
+bool DataHandler::SetupDevContext() {
   /*meet cnrt requirement*/
   if (dev_ctx_.dev_id != DevContext::INVALID) {
     try {
@@ -84,9 +101,18 @@ void DataHandler::Loop() {
     } catch (edk::Exception &e) {
       if (nullptr != module_)
         module_->PostEvent(EVENT_ERROR, "stream_id " + stream_id_ + " failed to setup dev/channel.");
-      return;
+      return false;
     }
   }
+  return true;
+}
+
+void DataHandler::Loop() {
+  if (nullptr != module_) module_->BindThread(stream_index_);
+
+  if (!SetupDevContext()) {
+    return;
+  }
 
   if (!PrepareResources()) {
     if (nullptr != module_)
@@ -99,13 +125,66 @@ void DataHandler::Loop() {
   if (frame_rate_ > 0) controller.Start();
 
   while (running_.load()) {
+    packet_time_ = kNoPacketTime;
     if (!this->Process()) {
       break;
     }
-    if (frame_rate_ > 0) controller.Control();
+    if (PacedByPts()) {
+      std::this_thread::sleep_until(pts_controller_.GetDueTime(packet_time_, std::chrono::steady_clock::now()));
+    } else if (frame_rate_ > 0) {
+      controller.Control();
+    }
   }
 
   ClearResources();
 }
 
+bool DataHandler::Step(std::chrono::steady_clock::time_point *next_due) {
+  // the workers are shared by the streams, the device context of the stream is set for every step
+  if (!SetupDevContext()) {
+    if (prepared_) ClearResources();
+    return false;
+  }
+
+  if (!prepared_) {
+    if (!running_.load()) return false;
+    if (!PrepareResources()) {
+      if (nullptr != module_)
+        module_->PostEvent(EVENT_ERROR, "stream_id " + stream_id_ +
+                                            "Prepare codec resources failed, maybe codec resources not enough.");
+      return false;
+    }
+    prepared_ = true;
+    next_due_ = std::chrono::steady_clock::now();
+  }
+
+  packet_time_ = kNoPacketTime;
+  if (!running_.load() || !this->Process()) {
+    ClearResources();
+    prepared_ = false;
+    return false;
+  }
+
+  // paces the stream like FrController, the lateness of one frame is caught up by the next one
+  auto now = std::chrono::steady_clock::now();
+  if (PacedByPts()) {
+    next_due_ = pts_controller_.GetDueTime(packet_time_, now);
+  } else if (frame_rate_ > 0) {
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(1000.0 / frame_rate_));
+    next_due_ += period;
+    if (next_due_ + period < now) next_due_ = now;
+  } else {
+    next_due_ = now;
+  }
+  *next_due = next_due_;
+  return true;
+}
+
+void DataHandler::OnUnscheduled() {
+  std::lock_guard<std::mutex> lk(unscheduled_mutex_);
+  unscheduled_ = true;
+  unscheduled_cond_.notify_one();
+}
+
 }  // namespace cnstream
@@ -21,11 +21,19 @@
 #ifndef MODULES_SOURCE_DATA_HANDLER_HPP_
 #define MODULES_SOURCE_DATA_HANDLER_HPP_
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "cnstream_frame.hpp"
 #include "data_source.hpp"
+#include "fr_controller.hpp"
+#include "stream_worker_pool.hpp"
 
 namespace cnstream {
 
@@ -61,21 +69,45 @@ class DataHandler : public SourceHandler {
   }
   bool GetDemuxEos() const { return demux_eos_.load() ? true : false; }
   bool ReuseCNDecBuf() const { return param_.reuse_cndec_buf; }
+  bool ReuseCpuDecBuf() const { return param_.reuse_cpudec_buf; }
   size_t Output_w() { return param_.output_w; }
   size_t Output_h() { return param_.output_h; }
   uint32_t InputBufNumber() { return param_.input_buf_number_; }
   uint32_t OutputBufNumber() { return param_.output_buf_number_; }
+  bool BlockOnAdmission() const { return param_.admission_policy_ == ADMISSION_BLOCK; }
+  int DecodeThreads() const { return param_.decode_threads_; }
+  DecodeThreadType GetDecodeThreadType() const { return param_.decode_thread_type_; }
+  DecodeSkipMode GetDecodeSkipMode() const { return param_.decode_skip_; }
+  const std::vector<RenditionParam> &GetRenditions() const { return param_.renditions_; }
 
  protected:
   DataSourceParam param_;
   DevContext dev_ctx_;
   size_t interval_ = 1;
   std::atomic<int> demux_eos_{0};
+  /*the timestamp in microseconds of the packet processed by Process(), the streams are paced by it with the pts
+   * pacing. Streams without the timestamps are paced by the frame rate.*/
+  static constexpr int64_t kNoPacketTime = INT64_MIN;
+  int64_t packet_time_ = kNoPacketTime;
 
  private:
   std::atomic<int> running_{0};
   std::thread thread_;
   void Loop();
+  bool SetupDevContext();
+  bool PacedByPts() const { return param_.pacing_ == PACING_PTS && packet_time_ != kNoPacketTime; }
+  PtsController pts_controller_;
+
+  /*the stream is run by the workers of the DataSource instead of thread_*/
+  friend class StreamWorkerPool;
+  bool Step(std::chrono::steady_clock::time_point *next_due);
+  void OnUnscheduled();
+  std::shared_ptr<StreamWorkerPool> worker_pool_ = nullptr;
+  bool prepared_ = false;
+  std::chrono::steady_clock::time_point next_due_;
+  std::mutex unscheduled_mutex_;
+  std::condition_variable unscheduled_cond_;
+  bool unscheduled_ = false;
   /*the below three funcs are in the same thread*/
   virtual bool PrepareResources(bool demux_only = false) = 0;
   virtual void ClearResources(bool demux_only = false) = 0;
@@ -52,6 +52,13 @@ bool DataHandlerFFmpeg::CheckTimeOut(uint64_t ul_current_time) {
   return false;
 }
 
+bool DataHandlerFFmpeg::GetReadAheadStat(ReadAheadStat* stat) {
+  std::lock_guard<std::mutex> lk(packet_queue_mutex_);
+  if (!packet_queue_) return false;
+  *stat = packet_queue_->GetStat();
+  return true;
+}
+
 struct local_ffmpeg_init {
   local_ffmpeg_init() {
     avcodec_register_all();
@@ -66,8 +73,10 @@ bool DataHandlerFFmpeg::PrepareResources(bool demux_only) {
   // format context
   p_format_ctx_ = avformat_alloc_context();
 
+  bool live = false;
   if (0 == strncasecmp(filename_.c_str(), p_rtmp_start_str, strlen(p_rtmp_start_str)) ||
       0 == strncasecmp(filename_.c_str(), p_rtsp_start_str, strlen(p_rtsp_start_str))) {
+    live = true;
     AVIOInterruptCB intrpt_callback = {InterruptCallBack, this};
     p_format_ctx_->interrupt_callback = intrpt_callback;
     last_receive_frame_time_ = GetTickCount();
@@ -128,8 +137,32 @@ bool DataHandlerFFmpeg::PrepareResources(bool demux_only) {
   packet_.data = NULL;
   packet_.size = 0;
 
+  if (this->loop_ && param_.loop_cache_ && !demux_only) {
+    if (live) {
+      LOG(WARNING) << "loop_cache is ignored by live stream: " << filename_;
+    } else {
+      // demuxes the whole file once, the packets are shared by the streams of the file
+      cache_.reset();
+      cache_ = PacketCache::Get(filename_, [this](PacketCache* cache) {
+        while (Extract()) cache->Add(&packet_);
+        return true;
+      });
+      if (!cache_) {
+        LOG(ERROR) << "Failed to cache the packets of file: " << filename_;
+        return false;
+      }
+      cache_index_ = 0;
+      cache_replay_ = 0;
+    }
+  }
+
   if (demux_only) return true;
 
+  av_init_packet(&decode_packet_);
+  decode_packet_.data = NULL;
+  decode_packet_.size = 0;
+  time_base_ = vstream->time_base;
+
   if (param_.decoder_type_ == DecoderType::DECODER_MLU) {
     decoder_ = std::make_shared<FFmpegMluDecoder>(*this);
   } else if (param_.decoder_type_ == DecoderType::DECODER_CPU) {
@@ -142,6 +175,11 @@ bool DataHandlerFFmpeg::PrepareResources(bool demux_only) {
     bool ret = decoder_->Create(vstream);
     if (ret) {
       decoder_->ResetCount(this->interval_);
+      if (ReadAhead()) {
+        std::lock_guard<std::mutex> lk(packet_queue_mutex_);
+        packet_queue_ = std::make_shared<PacketQueue>(param_.readahead_packets_, param_.readahead_bytes_);
+        reader_ = std::thread(&DataHandlerFFmpeg::ReaderLoop, this);
+      }
       return true;
     }
     return false;
@@ -150,6 +188,9 @@ bool DataHandlerFFmpeg::PrepareResources(bool demux_only) {
 }
 
 void DataHandlerFFmpeg::ClearResources(bool demux_only) {
+  // the reader uses the demuxer until it stops
+  if (!demux_only) StopReader();
+  if (!demux_only) cache_.reset();
   if (!demux_only && decoder_.get()) {
     EnableFlowEos(true);
     decoder_->Destroy();
@@ -169,7 +210,17 @@ void DataHandlerFFmpeg::ClearResources(bool demux_only) {
   first_frame_ = true;
 }
 
+bool DataHandlerFFmpeg::ExtractCached() {
+  if (cache_index_ >= cache_->Size()) {
+    cache_index_ = 0;
+    ++cache_replay_;
+  }
+  last_receive_frame_time_ = GetTickCount();
+  return cache_->Ref(cache_index_++, cache_replay_, &packet_);
+}
+
 bool DataHandlerFFmpeg::Extract() {
+  if (cache_) return ExtractCached();
   while (true) {
     last_receive_frame_time_ = GetTickCount();
 
@@ -210,8 +261,26 @@ bool DataHandlerFFmpeg::Extract() {
     }
 
     if (bitstream_filter_ctx_) {
-      av_bitstream_filter_filter(bitstream_filter_ctx_, vstream->codec, NULL, &packet_.data, &packet_.size,
-                                 packet_.data, packet_.size, 0);
+      uint8_t* data = nullptr;
+      int size = 0;
+      int ret = av_bitstream_filter_filter(bitstream_filter_ctx_, vstream->codec, NULL, &data, &size, packet_.data,
+                                           packet_.size, 0);
+      if (ret > 0) {
+        // the packet owns the filtered data instead of the demuxed data, so that it could be queued and unreferenced
+        // like the other packets
+        av_buffer_unref(&packet_.buf);
+        packet_.buf = av_buffer_create(data, size, av_buffer_default_free, NULL, 0);
+        if (!packet_.buf) {
+          LOG(ERROR) << "Create buffer for the filtered packet failed";
+          av_free(data);
+          av_packet_unref(&packet_);
+          continue;
+        }
+      }
+      if (ret >= 0) {
+        packet_.data = data;
+        packet_.size = size;
+      }
     }
     // find pts information
     if (AV_NOPTS_VALUE == packet_.pts && find_pts_) {
@@ -226,7 +295,51 @@ bool DataHandlerFFmpeg::Extract() {
   }
 }
 
+bool DataHandlerFFmpeg::GetSpsPpsPacket(AVPacket* packet) {
+  // this is hack flow,aim to add sps/pps.
+  if (!need_insert_sps_pps_ || insert_spspps_whenidr_) return false;
+  AVStream* vstream = p_format_ctx_->streams[video_index_];
+#if LIBAVFORMAT_VERSION_INT >= FFMPEG_VERSION_3_1
+  uint8_t* extradata = vstream->codecpar->extradata;
+  int extradata_size = vstream->codecpar->extradata_size;
+#else
+  uint8_t* extradata = vstream->codec->extradata;
+  int extradata_size = vstream->codec->extradata_size;
+#endif
+  // copied, the demuxer could be reopened before the packet is decoded
+  if (av_new_packet(packet, extradata_size) < 0) return false;
+  memcpy(packet->data, extradata, extradata_size);
+  packet->pts = 0;
+  return true;
+}
+
+bool DataHandlerFFmpeg::Decode(AVPacket* packet) {
+  if (AV_NOPTS_VALUE != packet->dts) {
+    // paced in decoding order, the packets inserted (e.g. sps/pps) have no decoding timestamp
+    AVRational time_base_us = {1, 1000000};
+    packet_time_ = av_rescale_q(packet->dts, time_base_, time_base_us);
+  }
+  bool ret = decoder_->Process(packet, false);
+  av_packet_unref(packet);
+  return ret;
+}
+
 bool DataHandlerFFmpeg::Process() {
+  if (ReadAhead()) {
+    switch (packet_queue_->Pop(&decode_packet_)) {
+      case PacketQueue::POP_PACKET:
+        return Decode(&decode_packet_);
+      case PacketQueue::POP_EOS:
+        // set by the decoder side, the decoder is flushed by Destroy() if it does not get the eos
+        demux_eos_.store(1);
+        EnableFlowEos(true);
+        decoder_->Process(nullptr, true);
+        return false;
+      default:
+        return false;
+    }
+  }
+
   bool ret = Extract();
   if (!ret) {
     LOG(INFO) << "Read EOS from file";
@@ -248,38 +361,62 @@ bool DataHandlerFFmpeg::Process() {
       decoder_->Process(nullptr, true);
       return false;
     }
-  }                                                       // if (!ret)
-  if (need_insert_sps_pps_ && !insert_spspps_whenidr_) {  // this is hack flow,aim to add sps/pps.
-    AVStream* vstream = p_format_ctx_->streams[video_index_];
-#if LIBAVFORMAT_VERSION_INT >= FFMPEG_VERSION_3_1
-    uint8_t* extradata = vstream->codecpar->extradata;
-    int extradata_size = vstream->codecpar->extradata_size;
-#else
-    uint8_t* extradata = vstream->codec->extradata;
-    int extradata_size = vstream->codec->extradata_size;
-#endif
-    AVPacket pkt = {0};
-    pkt.data = extradata;
-    pkt.size = extradata_size;
-    pkt.pts = 0;
-    if (!decoder_->Process(&pkt, false)) {
+  }  // if (!ret)
+  AVPacket sps_pps;
+  if (GetSpsPpsPacket(&sps_pps)) {
+    if (!Decode(&sps_pps)) {
+      av_packet_unref(&packet_);
       return false;
     }
     insert_spspps_whenidr_ = true;
   }
-  if (!decoder_->Process(&packet_, false)) {
-    if (bitstream_filter_ctx_) {
-      av_freep(&packet_.data);
+  return Decode(&packet_);
+}
+
+void DataHandlerFFmpeg::ReaderLoop() {
+  std::shared_ptr<PacketQueue> packet_queue = packet_queue_;
+  while (true) {
+    if (!Extract()) {
+      LOG(INFO) << "Read EOS from file";
+      if (!this->loop_) {
+        packet_queue->PushEnd(false);
+        return;
+      }
+      LOG(INFO) << "Clear resources and restart";
+      EnableFlowEos(false);
+      ClearResources(true);
+      if (!PrepareResources(true)) {
+        if (nullptr != module_)
+          module_->PostEvent(EVENT_ERROR, "Prepare codec resources failed, maybe codec resources not enough.");
+        packet_queue->PushEnd(true);
+        return;
+      }
+      LOG(INFO) << "Loop...";
+      continue;
     }
-    av_packet_unref(&packet_);
-    return false;
+    AVPacket sps_pps;
+    if (GetSpsPpsPacket(&sps_pps)) {
+      if (!packet_queue->Push(&sps_pps)) {
+        av_packet_unref(&packet_);
+        return;
+      }
+      insert_spspps_whenidr_ = true;
+    }
+    // fails when the queue is closed, the packet is unreferenced
+    if (!packet_queue->Push(&packet_)) return;
   }
+}
 
-  if (bitstream_filter_ctx_) {
-    av_freep(&packet_.data);
+void DataHandlerFFmpeg::StopReader() {
+  std::shared_ptr<PacketQueue> packet_queue;
+  {
+    std::lock_guard<std::mutex> lk(packet_queue_mutex_);
+    packet_queue = packet_queue_;
   }
-  av_packet_unref(&packet_);
-  return true;
+  if (packet_queue) packet_queue->Close();
+  if (reader_.joinable()) reader_.join();
+  std::lock_guard<std::mutex> lk(packet_queue_mutex_);
+  packet_queue_.reset();
 }
 
 }  // namespace cnstream
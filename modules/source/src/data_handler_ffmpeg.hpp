@@ -31,11 +31,15 @@ extern "C" {
 }
 #endif
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include "data_handler.hpp"
 #include "data_source.hpp"
 #include "ffmpeg_decoder.hpp"
+#include "packet_cache.hpp"
+#include "packet_queue.hpp"
 
 namespace cnstream {
 
@@ -47,6 +51,10 @@ class DataHandlerFFmpeg : public DataHandler {
 
  public:
   bool CheckTimeOut(uint64_t ul_current_time);
+  /**
+   * Gets the state of the packets read ahead of the decoder. Returns false if the packets are not read ahead.
+   */
+  bool GetReadAheadStat(ReadAheadStat* stat);
 
  private:
   // ffmpeg demuxer
@@ -55,6 +63,7 @@ class DataHandlerFFmpeg : public DataHandler {
   AVBitStreamFilterContext* bitstream_filter_ctx_ = nullptr;
   AVDictionary* options_ = NULL;
   AVPacket packet_;
+  AVRational time_base_ = {1, AV_TIME_BASE};
   int video_index_ = -1;
   bool first_frame_ = true;
   uint64_t last_receive_frame_time_ = 0;
@@ -72,8 +81,30 @@ class DataHandlerFFmpeg : public DataHandler {
   void ClearResources(bool demux_only = false) override;
   bool Process() override;
   bool Extract();
+  bool Decode(AVPacket* packet);
+  bool GetSpsPpsPacket(AVPacket* packet);
   size_t process_state_ = 0;
 
+ private:
+  // the packets are read ahead of the decoder by reader_
+  bool ReadAhead() const { return param_.readahead_packets_ > 0 || param_.readahead_bytes_ > 0; }
+  void ReaderLoop();
+  void StopReader();
+  std::shared_ptr<PacketQueue> packet_queue_ = nullptr;
+  std::mutex packet_queue_mutex_;
+  std::thread reader_;
+  AVPacket decode_packet_;
+
+ private:
+#ifdef UNIT_TEST
+ public:  // NOLINT
+#endif
+  // the looped stream replays the packets cached in memory instead of reopening the file
+  bool ExtractCached();
+  std::shared_ptr<PacketCache> cache_ = nullptr;
+  size_t cache_index_ = 0;
+  uint64_t cache_replay_ = 0;
+
  private:
   std::shared_ptr<FFmpegDecoder> decoder_ = nullptr;
 };
@@ -19,6 +19,7 @@
  *************************************************************************/
 #include "data_handler_raw.hpp"
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -28,6 +29,7 @@
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 namespace cnstream {
 
@@ -36,6 +38,9 @@ namespace cnstream {
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #endif
 
+/*the bytes read from the head of the file to detect the codec in chunk mode*/
+static constexpr size_t kDetectSize = 256 * 1024;
+
 bool DataHandlerRaw::PrepareResources(bool demux_only) {
   fd_ = open(filename_.c_str(), O_RDONLY);
   if (fd_ < 0) {
@@ -43,6 +48,7 @@ bool DataHandlerRaw::PrepareResources(bool demux_only) {
     return false;
   }
 
+  AnnexBParser::Codec codec = AnnexBParser::CODEC_UNKNOWN;
   if (param_.chunk_size_) {
     if (chunk_) delete[] chunk_;
     chunk_ = new (std::nothrow) uint8_t[param_.chunk_size_];
@@ -50,8 +56,30 @@ bool DataHandlerRaw::PrepareResources(bool demux_only) {
       LOG(ERROR) << "Failed to alloc memory";
       return false;
     }
+    std::vector<uint8_t> head(kDetectSize);
+    ssize_t len = pread(fd_, head.data(), head.size(), 0);
+    if (len > 0) codec = AnnexBParser::DetectCodec(head.data(), len);
   } else {
-    LOG(ERROR) << "By now, only raw chunk mode supported";
+    /*frame mode*/
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) != 0 || file_stat.st_size <= 0) {
+      LOG(ERROR) << "Failed to get the size of file: " << filename_;
+      return false;
+    }
+    map_size_ = file_stat.st_size;
+    void* map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (MAP_FAILED == map) {
+      LOG(ERROR) << "Failed to map file: " << filename_;
+      map_size_ = 0;
+      return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+    codec = AnnexBParser::DetectCodec(map_, map_size_);
+    parser_ = std::make_shared<AnnexBParser>(map_, map_size_, codec);
+  }
+  if (AnnexBParser::CODEC_UNKNOWN == codec) {
+    LOG(ERROR) << "Neither H264 nor H265 Annex-B stream: " << filename_;
     return false;
   }
 
@@ -65,17 +93,11 @@ bool DataHandlerRaw::PrepareResources(bool demux_only) {
   }
   if (decoder_.get()) {
     DecoderContext ctx;
-    // FIXME, parse bitstream to get decoder parametesrs...
-    if (filename_.find(".h264") != std::string::npos || filename_.find(".264") != std::string::npos) {
+    // FIXME, parse bitstream to get the resolution...
+    if (AnnexBParser::CODEC_H264 == codec) {
       ctx.codec_id = DecoderContext::CN_CODEC_ID_H264;
-    } else if (filename_.find(".h265") != std::string::npos) {
-      ctx.codec_id = DecoderContext::CN_CODEC_ID_HEVC;
-      /*} else if(filename_.find(".jpg") != std::string::npos) {
-        ctx.codec_id = DecoderContext::CN_CODEC_ID_JPEG;
-      */
     } else {
-      LOG(ERROR) << "unsupported raw file format";
-      return false;
+      ctx.codec_id = DecoderContext::CN_CODEC_ID_HEVC;
     }
     ctx.pix_fmt = DecoderContext::CN_PIX_FMT_NV21;
     ctx.interlaced = param_.interlaced_;
@@ -85,6 +107,8 @@ bool DataHandlerRaw::PrepareResources(bool demux_only) {
     bool ret = decoder_->Create(&ctx);
     if (ret) {
       decoder_->ResetCount(this->interval_);
+      // frame mode, the access units before the first key frame can not be decoded
+      if (0 == param_.chunk_size_) decoder_->Resync();
 #ifdef CNS_MLU100
       /*MLU100 does not have chunk-mode, use stream-mode instead*/
       if (param_.chunk_size_ <= ctx.width * ctx.height * 3 / 4) {
@@ -113,6 +137,11 @@ void DataHandlerRaw::ClearResources(bool demux_only) {
   if (chunk_) {
     delete[] chunk_, chunk_ = nullptr;
   }
+  parser_.reset();
+  if (map_) {
+    munmap(map_, map_size_), map_ = nullptr;
+    map_size_ = 0;
+  }
 }
 
 bool DataHandlerRaw::Extract() {
@@ -133,8 +162,20 @@ bool DataHandlerRaw::Extract() {
     return true;
   }
   /*frame mode*/
-  /*FIXME*/
-  return false;
+  AnnexBParser::AccessUnit au;
+  if (!parser_ || !parser_->Next(&au)) {
+    // EOF reached
+    packet_.data = nullptr;
+    packet_.size = 0;
+    packet_.pts = 0;
+    return false;
+  }
+  // read only, the decoder copies it to its input buffer
+  packet_.data = const_cast<uint8_t*>(au.data);
+  packet_.size = au.size;
+  packet_.pts = pts_++;
+  packet_.flags = au.key ? RAW_PACKET_FLAG_KEY : 0;
+  return true;
 }
 
 bool DataHandlerRaw::Process() {
@@ -145,8 +186,18 @@ bool DataHandlerRaw::Process() {
     if (this->loop_) {
       LOG(INFO) << "Clear resources and restart";
       EnableFlowEos(false);
-      ClearResources(true);
-      PrepareResources(true);
+      if (parser_) {
+        // frame mode, the file is still mapped, restart decoding from its first key frame
+        parser_->Reset();
+        decoder_->Resync();
+      } else {
+        ClearResources(true);
+        if (!PrepareResources(true)) {
+          if (nullptr != module_)
+            module_->PostEvent(EVENT_ERROR, "Prepare codec resources failed, maybe codec resources not enough.");
+          return false;
+        }
+      }
       demux_eos_.store(0);
       LOG(INFO) << "Loop...";
       return true;
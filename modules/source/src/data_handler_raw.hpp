@@ -24,6 +24,7 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include "annexb_parser.hpp"
 #include "data_handler.hpp"
 #include "data_source.hpp"
 #include "raw_decoder.hpp"
@@ -38,11 +39,14 @@ class DataHandlerRaw : public DataHandler {
 
  private:
   std::string filename_;
-  RawPacket packet_;
   uint8_t* chunk_ = nullptr;  // for chunk mode
   size_t chunk_size_ = 0;
   uint64_t pts_ = 0;
   int fd_ = -1;
+  // for frame mode, the access units point into the mapped file
+  uint8_t* map_ = nullptr;
+  size_t map_size_ = 0;
+  std::shared_ptr<AnnexBParser> parser_ = nullptr;
 
  private:
 #ifdef UNIT_TEST
@@ -52,6 +56,7 @@ class DataHandlerRaw : public DataHandler {
   void ClearResources(bool demux_only = false) override;
   bool Process() override;
   bool Extract();
+  RawPacket packet_;
 
  private:
   std::shared_ptr<RawDecoder> decoder_ = nullptr;
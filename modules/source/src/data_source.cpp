@@ -24,11 +24,15 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "data_handler_ffmpeg.hpp"
 #include "data_handler_raw.hpp"
 #include "glog/logging.h"
+#include "stream_worker_pool.hpp"
 
 namespace cnstream {
 
@@ -48,6 +52,10 @@ DataSource::DataSource(const std::string &name) : SourceModule(name) {
   param_register_.Register("reuse_cndec_buf",
                            "This parameter decides whether the codec buffer that stores output data"
                            "will be held and reused by the framework afterwards. It should be true or false.");
+  param_register_.Register("reuse_cpudec_buf",
+                           "When decoder_type and output_type are cpu, this parameter decides whether the FFmpeg"
+                           " frame buffers will be referenced by the output frames instead of being copied."
+                           " It should be true or false.");
   param_register_.Register("chunk_size",
                            "How many bytes will be sent to codec once."
                            " Chunk size is used when source_type is raw.");
@@ -62,10 +70,64 @@ DataSource::DataSource(const std::string &name) : SourceModule(name) {
   param_register_.Register("output_buf_number",
                            "Codec buffer number for storing output data."
                            " Basically, we do not need to set it, as it will be allocated automatically.");
+  param_register_.Register("admission_policy",
+                           "What to do with the decoded frames when the frames of a stream in flight reach the limit."
+                           " It could be block or drop, block by default.");
+  param_register_.Register("decode_threads",
+                           "How many threads the cpu decoder of each stream uses, 0 means as many as the cpu cores."
+                           " It is 1 by default.");
+  param_register_.Register("decode_thread_type",
+                           "How the cpu decoder is multi-threaded. It could be frame or slice, frame by default.");
+  param_register_.Register("worker_num",
+                           "How many workers demux and decode all the streams. 0 means each stream has a thread of"
+                           " its own, 0 by default.");
+  param_register_.Register("decode_skip",
+                           "Which frames the cpu decoder skips decoding. It could be none, nonref (skip non-reference"
+                           " frames) or nonkey (decode key frames only), none by default.");
+  param_register_.Register("readahead_packets",
+                           "When source_type is ffmpeg, how many packets of each stream are read ahead of the decoder"
+                           " by a reader thread. 0 means not bounded by packets, 0 by default.");
+  param_register_.Register("readahead_bytes",
+                           "When source_type is ffmpeg, how many bytes of the packets of each stream are read ahead"
+                           " of the decoder. 0 means not bounded by bytes, 0 by default. The packets are read ahead"
+                           " if either readahead_packets or readahead_bytes is greater than 0.");
+  param_register_.Register("pacing",
+                           "How the streams are paced. It could be framerate (by the frame rate of the stream) or pts"
+                           " (by the timestamps of the packets), framerate by default.");
+  param_register_.Register("speed",
+                           "When pacing is pts, the playback speed, e.g. 2 for replaying twice as fast. It should be"
+                           " greater than 0, 1 by default.");
+  param_register_.Register("loop_cache",
+                           "When source_type is ffmpeg and the stream is looped, whether the file is demuxed once into"
+                           " memory and replayed instead of being reopened at the end. It should be true or false.");
+  param_register_.Register("renditions",
+                           "When decoder_type is cpu, the scaled renditions attached to each frame, e.g."
+                           " analytics:640x360,preview:320x180. The modules select a rendition by name.");
 }
 
 DataSource::~DataSource() {}
 
+/* parses renditions in the format of name:WIDTHxHEIGHT[,name:WIDTHxHEIGHT...] */
+static bool ParseRenditions(const std::string &str, std::vector<RenditionParam> *renditions) {
+  std::set<std::string> names;
+  std::stringstream list(str);
+  std::string item;
+  while (std::getline(list, item, ',')) {
+    size_t colon = item.find(':');
+    if (colon == std::string::npos || 0 == colon) return false;
+    RenditionParam rendition;
+    rendition.name = item.substr(0, colon);
+    std::stringstream ss(item.substr(colon + 1));
+    char x = 0;
+    ss >> rendition.width >> x >> rendition.height;
+    if (ss.fail() || !ss.eof() || 'x' != x) return false;
+    if (rendition.width <= 0 || rendition.height <= 0 || rendition.width % 2 || rendition.height % 2) return false;
+    if (!names.insert(rendition.name).second) return false;
+    renditions->push_back(rendition);
+  }
+  return !renditions->empty();
+}
+
 static int GetDeviceId(ModuleParamSet paramSet) {
   if (paramSet.find("device_id") == paramSet.end()) {
     return -1;
@@ -164,6 +226,53 @@ bool DataSource::Open(ModuleParamSet paramSet) {
     }
   }
 
+  param_.pacing_ = PACING_FRAME_RATE;
+  if (paramSet.find("pacing") != paramSet.end()) {
+    std::string pacing = paramSet["pacing"];
+    if (pacing == "framerate") {
+      param_.pacing_ = PACING_FRAME_RATE;
+    } else if (pacing == "pts") {
+      param_.pacing_ = PACING_PTS;
+    } else {
+      LOG(ERROR) << "pacing " << pacing << " not supported";
+      return false;
+    }
+  }
+  param_.speed_ = 1.0;
+  if (paramSet.find("speed") != paramSet.end()) {
+    std::stringstream ss;
+    ss << paramSet["speed"];
+    ss >> param_.speed_;
+    if (ss.fail() || param_.speed_ <= 0) {
+      LOG(ERROR) << "speed " << paramSet["speed"] << " invalid";
+      return false;
+    }
+  }
+
+  param_.loop_cache_ = false;
+  if (paramSet.find("loop_cache") != paramSet.end() && paramSet["loop_cache"] == "true") {
+    param_.loop_cache_ = true;
+  }
+
+  param_.renditions_.clear();
+  if (paramSet.find("renditions") != paramSet.end()) {
+    if (!ParseRenditions(paramSet["renditions"], &param_.renditions_)) {
+      LOG(ERROR) << "renditions " << paramSet["renditions"] << " invalid";
+      return false;
+    }
+    if (param_.decoder_type_ != DECODER_CPU) {
+      LOG(WARNING) << "renditions are produced by the cpu decoder only, ignored";
+      param_.renditions_.clear();
+    }
+  }
+
+  param_.reuse_cpudec_buf = false;
+  if (param_.decoder_type_ == DECODER_CPU && param_.output_type_ == OUTPUT_CPU) {
+    if (paramSet.find("reuse_cpudec_buf") != paramSet.end() && paramSet["reuse_cpudec_buf"] == "true") {
+      param_.reuse_cpudec_buf = true;
+    }
+  }
+
   if (param_.source_type_ == SOURCE_RAW) {
     if (paramSet.find("chunk_size") == paramSet.end() || paramSet.find("width") == paramSet.end() ||
         paramSet.find("height") == paramSet.end() || paramSet.find("interlaced") == paramSet.end()) {
@@ -207,11 +316,100 @@ bool DataSource::Open(ModuleParamSet paramSet) {
     ss >> param_.output_buf_number_;
   }
 
+  if (paramSet.find("admission_policy") != paramSet.end()) {
+    std::string policy = paramSet["admission_policy"];
+    if (policy == "block") {
+      param_.admission_policy_ = ADMISSION_BLOCK;
+    } else if (policy == "drop") {
+      param_.admission_policy_ = ADMISSION_DROP;
+    } else {
+      LOG(ERROR) << "admission_policy " << policy << " not supported";
+      return false;
+    }
+  }
+
+  if (paramSet.find("decode_threads") != paramSet.end()) {
+    std::stringstream ss;
+    ss << paramSet["decode_threads"];
+    ss >> param_.decode_threads_;
+    if (ss.fail() || param_.decode_threads_ < 0) {
+      LOG(ERROR) << "decode_threads " << paramSet["decode_threads"] << " invalid";
+      return false;
+    }
+  }
+
+  if (paramSet.find("decode_thread_type") != paramSet.end()) {
+    std::string thread_type = paramSet["decode_thread_type"];
+    if (thread_type == "frame") {
+      param_.decode_thread_type_ = DECODE_THREAD_FRAME;
+    } else if (thread_type == "slice") {
+      param_.decode_thread_type_ = DECODE_THREAD_SLICE;
+    } else {
+      LOG(ERROR) << "decode_thread_type " << thread_type << " not supported";
+      return false;
+    }
+  }
+
+  if (paramSet.find("decode_skip") != paramSet.end()) {
+    std::string skip = paramSet["decode_skip"];
+    if (skip == "none") {
+      param_.decode_skip_ = DECODE_SKIP_NONE;
+    } else if (skip == "nonref") {
+      param_.decode_skip_ = DECODE_SKIP_NONREF;
+    } else if (skip == "nonkey") {
+      param_.decode_skip_ = DECODE_SKIP_NONKEY;
+    } else {
+      LOG(ERROR) << "decode_skip " << skip << " not supported";
+      return false;
+    }
+  }
+
+  if (paramSet.find("worker_num") != paramSet.end()) {
+    std::stringstream ss;
+    ss << paramSet["worker_num"];
+    ss >> param_.worker_num_;
+    if (ss.fail() || param_.worker_num_ < 0) {
+      LOG(ERROR) << "worker_num " << paramSet["worker_num"] << " invalid";
+      return false;
+    }
+  }
+  for (auto key : {"readahead_packets", "readahead_bytes"}) {
+    if (paramSet.find(key) == paramSet.end()) continue;
+    std::stringstream ss;
+    int64_t value = 0;
+    ss << paramSet[key];
+    ss >> value;
+    if (ss.fail() || value < 0) {
+      LOG(ERROR) << key << " " << paramSet[key] << " invalid";
+      return false;
+    }
+    if (std::string(key) == "readahead_packets") {
+      param_.readahead_packets_ = static_cast<uint32_t>(value);
+    } else {
+      param_.readahead_bytes_ = static_cast<uint64_t>(value);
+    }
+  }
+
+  if (param_.worker_num_ > 0) {
+    // the streams added before keep the workers they are using
+    if (!worker_pool_ || worker_pool_->GetWorkerNum() != param_.worker_num_) {
+      worker_pool_ = std::make_shared<StreamWorkerPool>(this, param_.worker_num_);
+    }
+  } else {
+    worker_pool_.reset();
+  }
+
   return true;
 }
 
 void DataSource::Close() { RemoveSources(); }
 
+bool DataSource::GetReadAheadStat(const std::string &stream_id, ReadAheadStat *stat) {
+  auto handler = std::dynamic_pointer_cast<DataHandlerFFmpeg>(GetSourceHandler(stream_id));
+  if (!handler || !stat) return false;
+  return handler->GetReadAheadStat(stat);
+}
+
 std::shared_ptr<SourceHandler> DataSource::CreateSource(const std::string &stream_id, const std::string &filename,
                                                         int framerate, bool loop) {
   if (stream_id.empty() || filename.empty()) {
@@ -308,6 +506,92 @@ bool DataSource::CheckParamSet(const ModuleParamSet &paramSet) const {
     }
   }
 
+  if (paramSet.find("reuse_cpudec_buf") != paramSet.end()) {
+    std::string reuse = paramSet.at("reuse_cpudec_buf");
+    if (reuse != "true" && reuse != "false") {
+      LOG(ERROR) << "[DataSource] [reuse_cpudec_buf] must be true or false";
+      return false;
+    }
+  }
+
+  if (paramSet.find("pacing") != paramSet.end()) {
+    std::string pacing = paramSet.at("pacing");
+    if (pacing != "framerate" && pacing != "pts") {
+      LOG(ERROR) << "[DataSource] [pacing] " << pacing << " not supported";
+      return false;
+    }
+  }
+
+  if (paramSet.find("speed") != paramSet.end()) {
+    if (!checker.IsNum({"speed"}, paramSet, err_msg, false) || std::stod(paramSet.at("speed")) <= 0) {
+      LOG(ERROR) << "[DataSource] [speed] must be a number greater than 0";
+      return false;
+    }
+  }
+
+  if (paramSet.find("loop_cache") != paramSet.end()) {
+    std::string loop_cache = paramSet.at("loop_cache");
+    if (loop_cache != "true" && loop_cache != "false") {
+      LOG(ERROR) << "[DataSource] [loop_cache] must be true or false";
+      return false;
+    }
+  }
+
+  if (paramSet.find("renditions") != paramSet.end()) {
+    std::vector<RenditionParam> renditions;
+    if (!ParseRenditions(paramSet.at("renditions"), &renditions)) {
+      LOG(ERROR) << "[DataSource] [renditions] must be name:WIDTHxHEIGHT separated by commas, with unique names and"
+                    " even sizes";
+      return false;
+    }
+  }
+
+  if (paramSet.find("admission_policy") != paramSet.end()) {
+    std::string policy = paramSet.at("admission_policy");
+    if (policy != "block" && policy != "drop") {
+      LOG(ERROR) << "[DataSource] [admission_policy] must be block or drop";
+      return false;
+    }
+  }
+
+  if (paramSet.find("decode_threads") != paramSet.end()) {
+    if (!checker.IsNum({"decode_threads"}, paramSet, err_msg, false) || std::stoi(paramSet.at("decode_threads")) < 0) {
+      LOG(ERROR) << "[DataSource] [decode_threads] must be a non-negative integer";
+      return false;
+    }
+  }
+
+  if (paramSet.find("decode_thread_type") != paramSet.end()) {
+    std::string thread_type = paramSet.at("decode_thread_type");
+    if (thread_type != "frame" && thread_type != "slice") {
+      LOG(ERROR) << "[DataSource] [decode_thread_type] must be frame or slice";
+      return false;
+    }
+  }
+
+  if (paramSet.find("decode_skip") != paramSet.end()) {
+    std::string skip = paramSet.at("decode_skip");
+    if (skip != "none" && skip != "nonref" && skip != "nonkey") {
+      LOG(ERROR) << "[DataSource] [decode_skip] must be none, nonref or nonkey";
+      return false;
+    }
+  }
+
+  if (paramSet.find("worker_num") != paramSet.end()) {
+    if (!checker.IsNum({"worker_num"}, paramSet, err_msg, false) || std::stoi(paramSet.at("worker_num")) < 0) {
+      LOG(ERROR) << "[DataSource] [worker_num] must be a non-negative integer";
+      return false;
+    }
+  }
+
+  for (auto key : {"readahead_packets", "readahead_bytes"}) {
+    if (paramSet.find(key) == paramSet.end()) continue;
+    if (!checker.IsNum({key}, paramSet, err_msg, false) || std::stoll(paramSet.at(key)) < 0) {
+      LOG(ERROR) << "[DataSource] [" << key << "] must be a non-negative integer";
+      return false;
+    }
+  }
+
   return true;
 }
 
@@ -34,8 +34,12 @@ namespace cnstream {
 
 // FFMPEG use AVCodecParameters instead of AVCodecContext since from version 3.1(libavformat/version:57.40.100)
 #define FFMPEG_VERSION_3_1 AV_VERSION_INT(57, 40, 100)
+// FFMPEG decouples input and output of decoders with avcodec_send_packet/avcodec_receive_frame since version 3.1
+#define FFMPEG_SEND_RECEIVE_API (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100))
 
 static std::mutex decoder_mutex;
+/* the line alignment of the renditions, as used by av_frame_get_buffer */
+static const int kRenditionAlign = 32;
 static CNDataFormat PixelFmt2CnDataFormat(edk::PixelFmt pformat) {
   switch (pformat) {
     case edk::PixelFmt::NV12:
@@ -85,7 +89,7 @@ bool FFmpegMluDecoder::Create(AVStream *st) {
   instance_attr.input_buffer_num = handler_.InputBufNumber();
   instance_attr.output_buffer_num = handler_.OutputBufNumber();
   if (handler_.ReuseCNDecBuf()) {
-    instance_attr.output_buffer_num += cnstream::GetParallelism();  // FIXME
+    instance_attr.output_buffer_num += handler_.GetAdmission()->GetLimit();  // FIXME
   }
   instance_attr.dev_id = dev_ctx_.dev_id;
   instance_attr.silent = false;
@@ -158,13 +162,11 @@ bool FFmpegMluDecoder::Process(AVPacket *pkt, bool eos) {
 int FFmpegMluDecoder::ProcessFrame(const edk::CnFrame &frame, bool *reused) {
   *reused = false;
 
-  // FIXME, remove infinite-loop
-  std::shared_ptr<CNFrameInfo> data;
-  while (1) {
-    data = CNFrameInfo::Create(stream_id_);
-    if (data.get() != nullptr) break;
-    if (stream_id_.empty()) return -1;
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  std::shared_ptr<CNFrameInfo> data =
+      CNFrameInfo::Create(stream_id_, handler_.GetAdmission(), handler_.BlockOnAdmission());
+  if (!data) {
+    // dropped by the admission of the stream, or the stream is closed
+    return -1;
   }
   data->channel_idx = stream_idx_;
   data->frame.frame_id = frame_id_++;
@@ -239,7 +241,28 @@ bool FFmpegCpuDecoder::Create(AVStream *st) {
   }
   av_codec_set_pkt_timebase(instance_, st->time_base);
 #endif
-  if (avcodec_open2(instance_, dec, NULL) < 0) {
+  instance_->thread_count = handler_.DecodeThreads();
+  instance_->thread_type = handler_.GetDecodeThreadType() == DECODE_THREAD_SLICE ? FF_THREAD_SLICE : FF_THREAD_FRAME;
+  // the skipped frames are dropped by the decoder before being decoded, they never reach ProcessFrame
+  switch (handler_.GetDecodeSkipMode()) {
+    case DECODE_SKIP_NONREF:
+      instance_->skip_frame = AVDISCARD_NONREF;
+      break;
+    case DECODE_SKIP_NONKEY:
+      instance_->skip_frame = AVDISCARD_NONKEY;
+      break;
+    default:
+      instance_->skip_frame = AVDISCARD_DEFAULT;
+      break;
+  }
+  AVDictionary *decoder_opts = nullptr;
+  if (handler_.ReuseCpuDecBuf()) {
+    // the output frames are referenced by CNDataFrame, the decoder must not overwrite them
+    av_dict_set(&decoder_opts, "refcounted_frames", "1", 0);
+  }
+  int ret = avcodec_open2(instance_, dec, &decoder_opts);
+  av_dict_free(&decoder_opts);
+  if (ret < 0) {
     LOG(ERROR) << "Failed to open codec";
     return false;
   }
@@ -248,6 +271,16 @@ bool FFmpegCpuDecoder::Create(AVStream *st) {
     LOG(ERROR) << "Could not alloc frame";
     return false;
   }
+  sws_ctxs_.assign(handler_.GetRenditions().size(), nullptr);
+  for (const RenditionParam &param : handler_.GetRenditions()) {
+    int size = av_image_get_buffer_size(AV_PIX_FMT_NV21, param.width, param.height, kRenditionAlign);
+    AVBufferPool *pool = size > 0 ? av_buffer_pool_init(size, nullptr) : nullptr;
+    if (!pool) {
+      LOG(ERROR) << "FFmpegCpuDecoder: Failed to create the buffer pool of rendition " << param.name;
+      return false;
+    }
+    rendition_pools_.push_back(pool);
+  }
   return true;
 }
 
@@ -274,10 +307,43 @@ void FFmpegCpuDecoder::Destroy() {
   if (nullptr != nv21_data_) {
     delete[] nv21_data_, nv21_data_ = nullptr;
   }
+  for (auto &sws_ctx : sws_ctxs_) {
+    sws_freeContext(sws_ctx);
+  }
+  sws_ctxs_.clear();
+  // the pools are freed once the buffers still referenced by the frames are returned
+  for (auto &pool : rendition_pools_) {
+    av_buffer_pool_uninit(&pool);
+  }
+  rendition_pools_.clear();
 }
 
 bool FFmpegCpuDecoder::Process(AVPacket *pkt, bool eos) {
   LOG_IF(INFO, eos) << "[FFmpegCpuDecoder] stream_id " << stream_id_ << " send eos.";
+#if FFMPEG_SEND_RECEIVE_API
+  if (eos) {
+    // enter draining mode, the frames buffered by the decoder threads are flushed
+    int ret = avcodec_send_packet(instance_, nullptr);
+    if (ret < 0 && ret != AVERROR_EOF) {
+      LOG(ERROR) << "[FFmpegCpuDecoder] stream_id " << stream_id_ << " failed to send eos to decoder";
+    } else {
+      ReceiveFrames();
+    }
+    handler_.SendFlowEos();
+    eos_got_.store(1);
+    return false;
+  }
+  if (!pkt->data && !pkt->size) {
+    // an empty packet would put the decoder into draining mode
+    return true;
+  }
+  int ret = avcodec_send_packet(instance_, pkt);
+  if (ret < 0) {
+    LOG(ERROR) << "avcodec_send_packet failed";
+    return false;
+  }
+  return ReceiveFrames();
+#else
   if (eos) {
     AVPacket packet;
     av_init_packet(&packet);
@@ -305,25 +371,44 @@ bool FFmpegCpuDecoder::Process(AVPacket *pkt, bool eos) {
     ProcessFrame(av_frame_);
   }
   return true;
+#endif
 }
 
+#if FFMPEG_SEND_RECEIVE_API
+bool FFmpegCpuDecoder::ReceiveFrames() {
+  while (true) {
+    int ret = avcodec_receive_frame(instance_, av_frame_);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+      return true;
+    }
+    if (ret < 0) {
+      LOG(ERROR) << "avcodec_receive_frame failed";
+      return false;
+    }
+    ProcessFrame(av_frame_);
+    av_frame_unref(av_frame_);
+  }
+  return true;
+}
+#endif
+
 bool FFmpegCpuDecoder::ProcessFrame(AVFrame *frame) {
   if (frame_count_++ % interval_ != 0) {
     return true;  // discard frames
   }
 
-  // FIXME, remove infinite-loop
-  std::shared_ptr<CNFrameInfo> data;
-  while (1) {
-    data = CNFrameInfo::Create(stream_id_);
-    if (data != nullptr) {
-      break;
-    }
-    if (stream_id_.empty()) return false;
-    std::this_thread::sleep_for(std::chrono::microseconds(5));
+  std::shared_ptr<CNFrameInfo> data =
+      CNFrameInfo::Create(stream_id_, handler_.GetAdmission(), handler_.BlockOnAdmission());
+  if (!data) {
+    // dropped by the admission of the stream, or the stream is closed
+    return false;
   }
   data->channel_idx = stream_idx_;
 
+  if (DevContext::CPU == dev_ctx_.dev_type && handler_.ReuseCpuDecBuf()) {
+    return ProcessFrameByRef(frame, data);
+  }
+
   if (instance_->pix_fmt != AV_PIX_FMT_YUV420P && instance_->pix_fmt != AV_PIX_FMT_YUVJ420P) {
     LOG(ERROR) << "FFmpegCpuDecoder only supports AV_PIX_FMT_YUV420P at this moment";
     return false;
@@ -356,47 +441,26 @@ bool FFmpegCpuDecoder::ProcessFrame(AVFrame *frame) {
       *vu++ = *v++;
       *vu++ = *u++;
     }
-    CALL_CNRT_BY_CONTEXT(cnrtMalloc(&data->frame.mlu_data, y_size_ * 3 / 2), dev_ctx_.dev_id, dev_ctx_.ddr_channel);
-    if (nullptr == data->frame.mlu_data) {
-      LOG(ERROR) << "FFmpegCpuDecoder: Failed to alloc mlu memory";
-      return false;
-    }
-    CALL_CNRT_BY_CONTEXT(cnrtMemcpy(data->frame.mlu_data, nv21_data_, y_size_ * 3 / 2, CNRT_MEM_TRANS_DIR_HOST2DEV),
-                         dev_ctx_.dev_id, dev_ctx_.ddr_channel);
-
-    auto t = reinterpret_cast<uint8_t *>(data->frame.mlu_data);
+    // the buffers and the synced memory are reused from the previous frame when the frame is recycled
+    data->frame.AllocSyncMem();
+    uint8_t *src = nv21_data_;
     for (int i = 0; i < data->frame.GetPlanes(); ++i) {
       size_t plane_size = data->frame.GetPlaneBytes(i);
-      CNSyncedMemory *CNSyncedMemory_ptr =
-          new (std::nothrow) CNSyncedMemory(plane_size, dev_ctx_.dev_id, dev_ctx_.ddr_channel);
-      LOG_IF(FATAL, nullptr == CNSyncedMemory_ptr) << "FFmpegCpuDecoder::ProcessFrame() new CNSyncedMemory failed";
-      data->frame.data[i].reset(CNSyncedMemory_ptr);
-      data->frame.data[i]->SetMluData(t);
-      t += plane_size;
+      CALL_CNRT_BY_CONTEXT(
+          cnrtMemcpy(data->frame.data[i]->GetMutableMluData(), src, plane_size, CNRT_MEM_TRANS_DIR_HOST2DEV),
+          dev_ctx_.dev_id, dev_ctx_.ddr_channel);
+      src += plane_size;
     }
   } else if (DevContext::CPU == dev_ctx_.dev_type) {
-    CNStreamMallocHost(&data->frame.cpu_data, frame->linesize[0] * frame->height * 3 / 2);
-    if (!data->frame.cpu_data) {
-      LOG(WARNING) << "CNStreamMallocHost failed";
-      return false;
-    }
-    memcpy(data->frame.cpu_data, frame->data[0], frame->linesize[0] * frame->height);
+    data->frame.AllocSyncMem();
+    memcpy(data->frame.data[0]->GetMutableCpuData(), frame->data[0], frame->linesize[0] * frame->height);
     uint8_t *u = frame->data[1];
     uint8_t *v = frame->data[2];
-    uint8_t *vu = reinterpret_cast<uint8_t *>(data->frame.cpu_data) + frame->linesize[0] * frame->height;
+    uint8_t *vu = reinterpret_cast<uint8_t *>(data->frame.data[1]->GetMutableCpuData());
     for (int i = 0; i < frame->linesize[1] * frame->height / 2; i++) {
       *vu++ = *v++;
       *vu++ = *u++;
     }
-    auto t = reinterpret_cast<uint8_t *>(data->frame.cpu_data);
-    for (int i = 0; i < data->frame.GetPlanes(); ++i) {
-      size_t plane_size = data->frame.GetPlaneBytes(i);
-      CNSyncedMemory *CNSyncedMemory_ptr = new (std::nothrow) CNSyncedMemory(plane_size);
-      LOG_IF(FATAL, nullptr == CNSyncedMemory_ptr) << "FFmpegCpuDecoder::ProcessFrame() new CNSyncedMemory failed";
-      data->frame.data[i].reset(CNSyncedMemory_ptr);
-      data->frame.data[i]->SetCpuData(t);
-      t += plane_size;
-    }
   } else {
     LOG(ERROR) << "DevContex::INVALID";
     return false;
@@ -404,8 +468,105 @@ bool FFmpegCpuDecoder::ProcessFrame(AVFrame *frame) {
 
   data->frame.frame_id = frame_id_++;
   data->frame.timestamp = frame->pts;
+  if (!ScaleRenditions(frame, data.get())) {
+    return false;
+  }
   handler_.SendData(data);
   return true;
 }
 
+bool FFmpegCpuDecoder::ProcessFrameByRef(AVFrame *frame, std::shared_ptr<CNFrameInfo> data) {
+  CNDataFormat fmt;
+  switch (frame->format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+      fmt = CN_PIXEL_FORMAT_YUV420P;
+      break;
+    case AV_PIX_FMT_NV12:
+      fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+      break;
+    case AV_PIX_FMT_NV21:
+      fmt = CN_PIXEL_FORMAT_YUV420_NV21;
+      break;
+    case AV_PIX_FMT_GRAY8:
+      fmt = CN_PIXEL_FORMAT_GRAY8;
+      break;
+    default:
+      LOG(ERROR) << "FFmpegCpuDecoder: pixel format " << frame->format << " is not supported";
+      return false;
+  }
+
+  // hold a reference to the decoder buffers until the frame is released
+  AVFrame *ref_frame = av_frame_alloc();
+  if (!ref_frame || av_frame_ref(ref_frame, frame) < 0) {
+    LOG(ERROR) << "FFmpegCpuDecoder: Failed to reference the decoded frame";
+    av_frame_free(&ref_frame);
+    return false;
+  }
+  data->frame.deAllocator_ = std::make_shared<AVFrameDeallocator>(ref_frame);
+
+  // the planes are used in the native layout of the decoder, no copy and no repacking
+  data->frame.ctx = dev_ctx_;
+  data->frame.fmt = fmt;
+  data->frame.width = ref_frame->width;
+  data->frame.height = ref_frame->height;
+  for (int i = 0; i < data->frame.GetPlanes(); ++i) {
+    data->frame.stride[i] = ref_frame->linesize[i];
+    data->frame.ptr_cpu[i] = ref_frame->data[i];
+  }
+  data->frame.CopyToSyncMem();
+
+  data->frame.frame_id = frame_id_++;
+  data->frame.timestamp = frame->pts;
+  if (!ScaleRenditions(frame, data.get())) {
+    return false;
+  }
+  handler_.SendData(data);
+  return true;
+}
+
+bool FFmpegCpuDecoder::ScaleRenditions(AVFrame *frame, CNFrameInfo *data) {
+  const std::vector<RenditionParam> &renditions = handler_.GetRenditions();
+  for (size_t i = 0; i < sws_ctxs_.size(); ++i) {
+    const RenditionParam &param = renditions[i];
+    // scaling and converting to NV21 in one pass, the context is rebuilt only when the decoded frames change
+    sws_ctxs_[i] = sws_getCachedContext(sws_ctxs_[i], frame->width, frame->height,
+                                        static_cast<AVPixelFormat>(frame->format), param.width, param.height,
+                                        AV_PIX_FMT_NV21, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws_ctxs_[i]) {
+      LOG(ERROR) << "FFmpegCpuDecoder: Failed to create the scaler of rendition " << param.name;
+      return false;
+    }
+    // the buffers of the previous frames are reused once the frames are released
+    AVBufferRef *buf = av_buffer_pool_get(rendition_pools_[i]);
+    if (!buf) {
+      LOG(ERROR) << "FFmpegCpuDecoder: Failed to alloc the buffer of rendition " << param.name;
+      return false;
+    }
+    uint8_t *dst_data[4];
+    int dst_linesize[4];
+    av_image_fill_arrays(dst_data, dst_linesize, buf->data, AV_PIX_FMT_NV21, param.width, param.height,
+                         kRenditionAlign);
+    sws_scale(sws_ctxs_[i], frame->data, frame->linesize, 0, frame->height, dst_data, dst_linesize);
+
+    // the rendition references the scaled buffer in host memory, no copy
+    std::shared_ptr<CNDataFrame> rendition = std::make_shared<CNDataFrame>();
+    rendition->deAllocator_ = std::make_shared<AVBufferDeallocator>(buf);
+    rendition->stream_id = stream_id_;
+    rendition->ctx.dev_type = DevContext::CPU;
+    rendition->fmt = CN_PIXEL_FORMAT_YUV420_NV21;
+    rendition->width = param.width;
+    rendition->height = param.height;
+    for (int plane = 0; plane < rendition->GetPlanes(); ++plane) {
+      rendition->stride[plane] = dst_linesize[plane];
+      rendition->ptr_cpu[plane] = dst_data[plane];
+    }
+    rendition->CopyToSyncMem();
+    rendition->frame_id = data->frame.frame_id;
+    rendition->timestamp = data->frame.timestamp;
+    data->renditions[param.name] = rendition;
+  }
+  return true;
+}
+
 }  // namespace cnstream
@@ -29,6 +29,7 @@ extern "C" {
 #include <libavutil/avutil.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/pixfmt.h>
+#include <libswscale/swscale.h>
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +38,7 @@ extern "C" {
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 #include "cnstream_frame.hpp"
 #include "cnstream_timer.hpp"
 #include "data_handler.hpp"
@@ -133,13 +135,35 @@ class FFmpegCpuDecoder : public FFmpegDecoder {
  public:  // NOLINT
 #endif
   bool ProcessFrame(AVFrame *frame);
+  bool ProcessFrameByRef(AVFrame *frame, std::shared_ptr<CNFrameInfo> data);
+  bool ScaleRenditions(AVFrame *frame, CNFrameInfo *data);
 
  private:
+  bool ReceiveFrames();
+  class AVFrameDeallocator : public cnstream::IDataDeallocator {
+   public:
+    explicit AVFrameDeallocator(AVFrame *frame) : frame_(frame) {}
+    ~AVFrameDeallocator() { av_frame_free(&frame_); }
+
+   private:
+    AVFrame *frame_;
+  };
+  class AVBufferDeallocator : public cnstream::IDataDeallocator {
+   public:
+    explicit AVBufferDeallocator(AVBufferRef *buf) : buf_(buf) {}
+    ~AVBufferDeallocator() { av_buffer_unref(&buf_); }
+
+   private:
+    AVBufferRef *buf_;
+  };
+
   AVCodecContext *instance_ = nullptr;
   AVFrame *av_frame_ = nullptr;
   std::atomic<int> eos_got_{0};
   uint8_t *nv21_data_ = nullptr;
   int y_size_ = 0;
+  std::vector<SwsContext *> sws_ctxs_;  // one for each rendition
+  std::vector<AVBufferPool *> rendition_pools_;  // one for each rendition, the buffers are returned when released
 };
 }  // namespace cnstream
 
@@ -39,3 +39,32 @@ void FrController::Control() {
   }
   Start();
 }
+
+/*the timestamps jumping forward further than it restart the timeline*/
+static constexpr int64_t kMaxPtsGapUs = 5 * 1000 * 1000;
+/*the data falling behind further than it restart the timeline instead of being sent in a burst*/
+static constexpr std::chrono::milliseconds kMaxLate(500);
+
+std::chrono::steady_clock::time_point PtsController::GetDueTime(int64_t timestamp,
+                                                                std::chrono::steady_clock::time_point now) {
+  if (!started_) {
+    started_ = true;
+    base_ts_ = last_ts_ = timestamp;
+    base_time_ = last_due_ = now;
+    return now;
+  }
+  if (timestamp < last_ts_ || timestamp - last_ts_ > kMaxPtsGapUs) {
+    // the data keeps the pace of the data before
+    base_ts_ = timestamp;
+    base_time_ = last_due_;
+  }
+  last_ts_ = timestamp;
+  auto offset = std::chrono::duration<double, std::micro>((timestamp - base_ts_) / speed_);
+  auto due = base_time_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+  if (due + kMaxLate < now) {
+    base_ts_ = timestamp;
+    base_time_ = due = now;
+  }
+  last_due_ = due;
+  return due;
+}
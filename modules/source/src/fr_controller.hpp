@@ -41,4 +41,32 @@ class FrController {
   std::chrono::time_point<std::chrono::steady_clock> start_, end_;
 };  // class FrController
 
+/***********************************************************************
+ * @brief PtsController gets the time to send the data by the timestamps of the data.
+ *
+ * The time between the data follows the time between their timestamps, divided by the speed. The timestamps going
+ * backwards or jumping forward (e.g. the file is looped), and the data falling far behind, restart the timeline.
+ ***********************************************************************/
+class PtsController {
+ public:
+  explicit PtsController(double speed = 1.0) : speed_(speed) {}
+  /**
+   * @param timestamp The timestamp of the data in microseconds.
+   * @param now The current time.
+   *
+   * @return Returns the time to send the data.
+   */
+  std::chrono::steady_clock::time_point GetDueTime(int64_t timestamp,
+                                                   std::chrono::steady_clock::time_point now);
+  void Reset() { started_ = false; }
+  inline double GetSpeed() const { return speed_; }
+
+ private:
+  double speed_ = 1.0;
+  bool started_ = false;
+  int64_t base_ts_ = 0;
+  int64_t last_ts_ = 0;
+  std::chrono::steady_clock::time_point base_time_, last_due_;
+};  // class PtsController
+
 #endif  // MODULES_SOURCE_INCLUDE_FR_CONTROLLER_HPP_
@@ -0,0 +1,147 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "packet_cache.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace cnstream {
+
+/* the cache of a file, loaded by the first stream of the file while the other streams of the file wait */
+struct CacheEntry {
+  std::mutex mutex;
+  std::weak_ptr<PacketCache> cache;
+  // the streams getting the cache, guarded by cache_mutex
+  size_t getters = 0;
+};
+
+static std::mutex cache_mutex;
+static std::map<std::string, std::shared_ptr<CacheEntry>> cache_map;
+
+/* files cached with more bytes are warned about, the whole file is kept in memory while it is looped */
+static const size_t kLargeCacheBytes = 512 * 1024 * 1024;
+
+/* erases the entry of a file once no stream holds its cache or is getting it */
+static void ReleaseEntry(const std::string &filename, bool getter) {
+  std::lock_guard<std::mutex> lk(cache_mutex);
+  auto it = cache_map.find(filename);
+  if (it == cache_map.end()) return;
+  if (getter) --it->second->getters;
+  if (0 == it->second->getters && it->second->cache.expired()) cache_map.erase(it);
+}
+
+std::shared_ptr<PacketCache> PacketCache::Get(const std::string &filename, const Loader &loader) {
+  std::shared_ptr<CacheEntry> entry;
+  {
+    std::lock_guard<std::mutex> lk(cache_mutex);
+    std::shared_ptr<CacheEntry> &it = cache_map[filename];
+    if (!it) it = std::make_shared<CacheEntry>();
+    ++it->getters;
+    entry = it;
+  }
+  std::shared_ptr<PacketCache> cache;
+  bool loaded = false;
+  {
+    // only the streams of the same file wait for the one loading it
+    std::lock_guard<std::mutex> lk(entry->mutex);
+    cache = entry->cache.lock();
+    if (!cache) {
+      cache.reset(new PacketCache(), [filename](PacketCache *p) {
+        delete p;
+        ReleaseEntry(filename, false);
+      });
+      if (loader(cache.get()) && cache->Size()) {
+        cache->Finish();
+        entry->cache = cache;
+        loaded = true;
+      } else {
+        cache.reset();
+      }
+    }
+  }
+  ReleaseEntry(filename, true);
+  if (loaded) {
+    if (cache->Bytes() > kLargeCacheBytes) {
+      LOG(WARNING) << "Cached " << cache->Size() << " packets, " << cache->Bytes() << " bytes of file: " << filename
+                   << ", consider disabling loop_cache for large files";
+    } else {
+      LOG(INFO) << "Cached " << cache->Size() << " packets, " << cache->Bytes() << " bytes of file: " << filename;
+    }
+  }
+  return cache;
+}
+
+size_t PacketCache::CachedFileNumber() {
+  std::lock_guard<std::mutex> lk(cache_mutex);
+  return cache_map.size();
+}
+
+PacketCache::~PacketCache() {
+  for (auto &packet : packets_) {
+    av_packet_unref(&packet);
+  }
+}
+
+void PacketCache::Add(AVPacket *packet) {
+  if (!packet->buf) {
+    // the data belongs to the demuxer, copied
+    AVPacket copy;
+    av_init_packet(&copy);
+    if (av_packet_ref(&copy, packet) < 0) {
+      av_packet_unref(packet);
+      return;
+    }
+    av_packet_unref(packet);
+    *packet = copy;
+  }
+  bytes_ += packet->size;
+  packets_.push_back(*packet);
+  av_init_packet(packet);
+  packet->data = nullptr;
+  packet->size = 0;
+}
+
+void PacketCache::Finish() {
+  int64_t min_pts = INT64_MAX, max_pts = INT64_MIN;
+  size_t pts_num = 0;
+  for (auto &packet : packets_) {
+    if (AV_NOPTS_VALUE == packet.pts) continue;
+    min_pts = std::min(min_pts, packet.pts);
+    max_pts = std::max(max_pts, packet.pts);
+    ++pts_num;
+  }
+  if (pts_num > 1) {
+    // one more frame after the last one
+    duration_ = (max_pts - min_pts) + (max_pts - min_pts) / static_cast<int64_t>(pts_num - 1);
+  }
+  if (duration_ <= 0) duration_ = 1;
+}
+
+bool PacketCache::Ref(size_t index, uint64_t replay, AVPacket *packet) const {
+  if (index >= packets_.size()) return false;
+  if (av_packet_ref(packet, &packets_[index]) < 0) return false;
+  int64_t offset = static_cast<int64_t>(replay) * duration_;
+  if (AV_NOPTS_VALUE != packet->pts) packet->pts += offset;
+  if (AV_NOPTS_VALUE != packet->dts) packet->dts += offset;
+  return true;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,95 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_SOURCE_PACKET_CACHE_HPP_
+#define MODULES_SOURCE_PACKET_CACHE_HPP_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavcodec/avcodec.h>
+#ifdef __cplusplus
+}
+#endif
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cnstream_common.hpp"
+
+namespace cnstream {
+
+/**
+ * The demuxed packets of a file kept in memory, replayed by the looped streams of the file.
+ *
+ * The cache of a file is shared by all the streams of the file, the packets are referenced, not copied.
+ */
+class PacketCache {
+ public:
+  using Loader = std::function<bool(PacketCache *cache)>;
+  /**
+   * Gets the cache of a file, the cache is loaded by ``loader`` if the file is not cached by other streams.
+   *
+   * @return Returns nullptr if ``loader`` fails or adds no packet.
+   */
+  static std::shared_ptr<PacketCache> Get(const std::string &filename, const Loader &loader);
+  /**
+   * @return Returns the number of files cached or being loaded. A file is dropped when the last stream releases
+   * its cache.
+   */
+  static size_t CachedFileNumber();
+
+  PacketCache() = default;
+  ~PacketCache();
+  /**
+   * Takes the packet over and resets it. The packet should be reference counted.
+   */
+  void Add(AVPacket *packet);
+  size_t Size() const { return packets_.size(); }
+  /**
+   * @return Returns the bytes of the packets cached.
+   */
+  size_t Bytes() const { return bytes_; }
+  /**
+   * References a packet of a replay. The timestamps of the packet are shifted by the duration of the replays before,
+   * so that the timestamps keep increasing from one replay to the next.
+   *
+   * @param index The index of the packet.
+   * @param replay How many times the packets are replayed before.
+   * @param packet The packet referencing the cached one, which should be unreferenced by the caller.
+   */
+  bool Ref(size_t index, uint64_t replay, AVPacket *packet) const;
+  /**
+   * @return Returns the duration of a replay in the time base of the stream.
+   */
+  int64_t GetDuration() const { return duration_; }
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(PacketCache);
+  void Finish();
+  std::vector<AVPacket> packets_;
+  int64_t duration_ = 0;
+  size_t bytes_ = 0;
+};  // class PacketCache
+
+}  // namespace cnstream
+
+#endif  // MODULES_SOURCE_PACKET_CACHE_HPP_
@@ -0,0 +1,112 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "packet_queue.hpp"
+
+#include <algorithm>
+
+namespace cnstream {
+
+PacketQueue::PacketQueue(uint32_t max_packets, uint64_t max_bytes) : max_packets_(max_packets), max_bytes_(max_bytes) {}
+
+PacketQueue::~PacketQueue() {
+  for (auto &packet : packets_) {
+    av_packet_unref(&packet);
+  }
+}
+
+bool PacketQueue::Push(AVPacket *packet) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  auto full = [&] {
+    if (packets_.empty()) return false;
+    if (max_packets_ && packets_.size() >= max_packets_) return true;
+    return max_bytes_ && bytes_ + packet->size > max_bytes_;
+  };
+  if (!closed_ && full()) {
+    // the decoder is slower than the input
+    stat_.reader_waits++;
+    auto start = Clock::now();
+    room_cond_.wait(lk, [&] { return closed_ || !full(); });
+    reader_wait_ += Clock::now() - start;
+  }
+  if (closed_) {
+    lk.unlock();
+    av_packet_unref(packet);
+    return false;
+  }
+  packets_.push_back(*packet);
+  bytes_ += packet->size;
+  stat_.max_packets = std::max(stat_.max_packets, static_cast<uint32_t>(packets_.size()));
+  lk.unlock();
+  packet_cond_.notify_one();
+
+  av_init_packet(packet);
+  packet->data = nullptr;
+  packet->size = 0;
+  return true;
+}
+
+void PacketQueue::PushEnd(bool error) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    end_ = true;
+    error_ = error;
+  }
+  packet_cond_.notify_one();
+}
+
+PacketQueue::PopResult PacketQueue::Pop(AVPacket *packet) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (!closed_ && !end_ && packets_.empty()) {
+    // the input is slower than the decoder
+    stat_.decoder_waits++;
+    auto start = Clock::now();
+    packet_cond_.wait(lk, [this] { return closed_ || end_ || !packets_.empty(); });
+    decoder_wait_ += Clock::now() - start;
+  }
+  if (closed_) return POP_CLOSED;
+  if (packets_.empty()) return error_ ? POP_ERROR : POP_EOS;
+  *packet = packets_.front();
+  packets_.pop_front();
+  bytes_ -= packet->size;
+  lk.unlock();
+  room_cond_.notify_one();
+  return POP_PACKET;
+}
+
+void PacketQueue::Close() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    closed_ = true;
+  }
+  room_cond_.notify_all();
+  packet_cond_.notify_all();
+}
+
+ReadAheadStat PacketQueue::GetStat() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  ReadAheadStat stat = stat_;
+  stat.packets = static_cast<uint32_t>(packets_.size());
+  stat.bytes = bytes_;
+  stat.reader_wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(reader_wait_).count();
+  stat.decoder_wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(decoder_wait_).count();
+  return stat;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,103 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_SOURCE_PACKET_QUEUE_HPP_
+#define MODULES_SOURCE_PACKET_QUEUE_HPP_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavcodec/avcodec.h>
+#ifdef __cplusplus
+}
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "cnstream_common.hpp"
+#include "data_source.hpp"
+
+namespace cnstream {
+
+/**
+ * The bounded packet queue between the reader and the decoder of a stream.
+ *
+ * The reader pushes the demuxed packets and the end of the stream, the decoder pops them. The queue is bounded by
+ * the number of packets and by the bytes of the packets, the bound which is 0 is not applied. One packet is always
+ * accepted by an empty queue, however large it is.
+ */
+class PacketQueue {
+ public:
+  enum PopResult {
+    POP_PACKET,  ///< A packet is popped.
+    POP_EOS,     ///< The reader reached the end of the stream.
+    POP_ERROR,   ///< The reader stopped for an error.
+    POP_CLOSED   ///< The queue is closed.
+  };
+
+  PacketQueue(uint32_t max_packets, uint64_t max_bytes);
+  ~PacketQueue();
+
+  /**
+   * Takes the packet over and resets it. Waits until there is room for the packet.
+   *
+   * @return Returns false if the queue is closed, the packet is unreferenced.
+   */
+  bool Push(AVPacket *packet);
+  /**
+   * Marks the end of the packets, for the end of the stream or an error.
+   */
+  void PushEnd(bool error);
+  /**
+   * Waits for a packet, the end of the packets or the queue being closed.
+   *
+   * @param packet Takes the popped packet, which should be unreferenced by the caller.
+   */
+  PopResult Pop(AVPacket *packet);
+  /**
+   * Wakes up the reader and the decoder, Push() and Pop() fail afterwards.
+   */
+  void Close();
+
+  ReadAheadStat GetStat();
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(PacketQueue);
+  using Clock = std::chrono::steady_clock;
+  uint32_t max_packets_;
+  uint64_t max_bytes_;
+  std::deque<AVPacket> packets_;
+  uint64_t bytes_ = 0;
+  bool end_ = false;
+  bool error_ = false;
+  bool closed_ = false;
+  ReadAheadStat stat_;
+  Clock::duration reader_wait_ = Clock::duration::zero();
+  Clock::duration decoder_wait_ = Clock::duration::zero();
+  std::mutex mutex_;
+  std::condition_variable room_cond_;
+  std::condition_variable packet_cond_;
+};  // class PacketQueue
+
+}  // namespace cnstream
+
+#endif  // MODULES_SOURCE_PACKET_QUEUE_HPP_
@@ -71,7 +71,7 @@ bool RawMluDecoder::Create(DecoderContext *ctx) {
   instance_attr.input_buffer_num = handler_.InputBufNumber();
   instance_attr.output_buffer_num = handler_.OutputBufNumber();
   if (handler_.ReuseCNDecBuf()) {
-    instance_attr.output_buffer_num += cnstream::GetParallelism();  // FIXME
+    instance_attr.output_buffer_num += handler_.GetAdmission()->GetLimit();  // FIXME
   }
   instance_attr.dev_id = dev_ctx_.dev_id;
   instance_attr.silent = false;
@@ -118,11 +118,25 @@ void RawMluDecoder::Destroy() {
   }
 }
 
+bool RawDecoder::SkipUntilKey(const RawPacket *pkt) {
+  if (!wait_key_) return false;
+  if (!(pkt->flags & RAW_PACKET_FLAG_KEY)) {
+    skipped_packets_++;
+    return true;
+  }
+  LOG_IF(INFO, skipped_packets_) << "[RawDecoder] stream_id " << stream_id_ << " skipped " << skipped_packets_
+                                 << " packets before the key frame.";
+  wait_key_ = false;
+  skipped_packets_ = 0;
+  return false;
+}
+
 bool RawMluDecoder::Process(RawPacket *pkt, bool eos) {
   LOG_IF(INFO, eos) << "[RawMluDecoder] stream_id " << stream_id_ << " send eos.";
   try {
     edk::CnPacket packet;
     if (pkt && !eos) {
+      if (SkipUntilKey(pkt)) return true;
       packet.data = pkt->data;
       packet.length = pkt->size;
       packet.pts = pkt->pts;
@@ -143,15 +157,11 @@ bool RawMluDecoder::Process(RawPacket *pkt, bool eos) {
 int RawMluDecoder::ProcessFrame(const edk::CnFrame &frame, bool *reused) {
   *reused = false;
 
-  // FIXME, remove infinite-loop
-  std::shared_ptr<CNFrameInfo> data;
-  while (1) {
-    data = CNFrameInfo::Create(stream_id_);
-    if (data.get() != nullptr) {
-      break;
-    }
-    if (stream_id_.empty()) return -1;
-    std::this_thread::sleep_for(std::chrono::microseconds(5));
+  std::shared_ptr<CNFrameInfo> data =
+      CNFrameInfo::Create(stream_id_, handler_.GetAdmission(), handler_.BlockOnAdmission());
+  if (!data) {
+    // dropped by the admission of the stream, or the stream is closed
+    return -1;
   }
   data->channel_idx = stream_idx_;
   data->frame.frame_id = frame_id_++;
@@ -34,6 +34,10 @@
 
 namespace cnstream {
 
+enum RawPacketFlag : uint32_t {
+  RAW_PACKET_FLAG_KEY = 1 << 0  // the packet is a whole access unit with an IDR or IRAP picture
+};
+
 struct RawPacket {
   uint8_t *data = nullptr;
   size_t size = 0;
@@ -66,8 +70,17 @@ class RawDecoder {
     frame_id_ = 0;
     interval_ = interval;
   }
+  /**
+   * Drops the packets until the next key packet (see RAW_PACKET_FLAG_KEY), so that decoding starts from a key frame
+   * instead of frames referring to pictures the decoder has not seen. Only for the packets of whole access units.
+   */
+  void Resync() { wait_key_ = true; }
+  bool IsWaitingForKey() const { return wait_key_; }
 
  protected:
+  /* returns true if the packet is dropped as the decoder is waiting for a key packet */
+  bool SkipUntilKey(const RawPacket *pkt);
+
   std::string stream_id_;
   DataHandler &handler_;
 
@@ -76,6 +89,8 @@ class RawDecoder {
   size_t interval_ = 1;
   size_t frame_count_ = 0;
   uint64_t frame_id_ = 0;
+  bool wait_key_ = false;
+  uint64_t skipped_packets_ = 0;
 };
 
 class RawMluDecoder : public RawDecoder {
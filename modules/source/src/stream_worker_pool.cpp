@@ -0,0 +1,131 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "stream_worker_pool.hpp"
+
+#include <glog/logging.h>
+
+#include "cnstream_module.hpp"
+#include "data_handler.hpp"
+
+namespace cnstream {
+
+StreamWorkerPool::StreamWorkerPool(Module *module, int worker_num) : module_(module) {
+  LOG_IF(FATAL, worker_num <= 0) << "StreamWorkerPool: worker number must be greater than 0";
+  timer_wheel_.reset(new TimerWheel());
+  for (int i = 0; i < worker_num; ++i) {
+    workers_.emplace_back(&StreamWorkerPool::WorkLoop, this);
+  }
+}
+
+StreamWorkerPool::~StreamWorkerPool() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) worker.join();
+  }
+  timer_wheel_.reset();
+  LOG_IF(WARNING, !states_.empty()) << "StreamWorkerPool: " << states_.size() << " streams are not closed";
+}
+
+void StreamWorkerPool::Push(DataHandler *handler, StreamState *state, Clock::time_point due) {
+  // the tasks pushed before are stale, they are skipped by the workers
+  state->token = ++token_seq_;
+  Task task = {state->token, handler};
+  if (due <= Clock::now()) {
+    tasks_.push_back(task);
+    return;
+  }
+  timer_wheel_->Schedule(due, [this, task] {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      tasks_.push_back(task);
+    }
+    cond_.notify_one();
+  });
+}
+
+void StreamWorkerPool::Add(DataHandler *handler) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    Push(handler, &states_[handler], Clock::now());
+  }
+  cond_.notify_one();
+}
+
+void StreamWorkerPool::Kick(DataHandler *handler) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto iter = states_.find(handler);
+    if (iter == states_.end()) return;
+    if (iter->second.busy) {
+      // rescheduled right after the running step
+      iter->second.kicked = true;
+      return;
+    }
+    Push(handler, &iter->second, Clock::now());
+  }
+  cond_.notify_one();
+}
+
+void StreamWorkerPool::WorkLoop() {
+  if (module_) module_->BindThread();
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    if (!running_) break;
+    if (tasks_.empty()) {
+      cond_.wait(lk);
+      continue;
+    }
+    Task task = tasks_.front();
+    tasks_.pop_front();
+    auto iter = states_.find(task.handler);
+    if (iter == states_.end() || iter->second.token != task.token) continue;
+    iter->second.busy = true;
+    lk.unlock();
+
+    Clock::time_point due;
+    bool again = task.handler->Step(&due);
+
+    lk.lock();
+    iter = states_.find(task.handler);
+    if (!again) {
+      states_.erase(iter);
+      lk.unlock();
+      // the handler could be destroyed right after this call
+      task.handler->OnUnscheduled();
+      lk.lock();
+      continue;
+    }
+    iter->second.busy = false;
+    if (iter->second.kicked) {
+      iter->second.kicked = false;
+      due = Clock::now();
+    }
+    Push(task.handler, &iter->second, due);
+    // another worker may be waiting
+    cond_.notify_one();
+  }
+}
+
+}  // namespace cnstream
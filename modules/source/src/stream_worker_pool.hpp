@@ -0,0 +1,95 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_SOURCE_STREAM_WORKER_POOL_HPP_
+#define MODULES_SOURCE_STREAM_WORKER_POOL_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "cnstream_common.hpp"
+#include "timer_wheel.hpp"
+
+namespace cnstream {
+
+class DataHandler;
+class Module;
+
+/**
+ * A fixed number of workers demuxing and decoding all the streams of a DataSource.
+ *
+ * Each stream is a schedulable unit. A worker runs one step of a stream (read a packet, decode and send the frames),
+ * then the stream is queued again at the time its next frame is due, by a timer wheel shared by the streams. A stream
+ * is never run by two workers at the same time, so the frames of a stream keep their order.
+ */
+class StreamWorkerPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  StreamWorkerPool(Module *module, int worker_num);
+  ~StreamWorkerPool();
+
+  /**
+   * Starts scheduling the stream. DataHandler::OnUnscheduled is called once the stream stops.
+   */
+  void Add(DataHandler *handler);
+  /**
+   * Runs the stream as soon as possible, e.g. to let a closing stream leave its pacing wait.
+   */
+  void Kick(DataHandler *handler);
+
+  int GetWorkerNum() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(StreamWorkerPool);
+  struct Task {
+    uint64_t token;
+    DataHandler *handler;
+  };
+  struct StreamState {
+    uint64_t token = 0;
+    bool busy = false;
+    bool kicked = false;
+  };
+  void Push(DataHandler *handler, StreamState *state, Clock::time_point due);
+  void WorkLoop();
+
+  Module *module_ = nullptr;
+  bool running_ = true;
+  uint64_t token_seq_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // the tasks due
+  std::deque<Task> tasks_;
+  std::unordered_map<DataHandler *, StreamState> states_;
+  std::vector<std::thread> workers_;
+  // the timers queue the tasks when they are due
+  std::unique_ptr<TimerWheel> timer_wheel_;
+};  // class StreamWorkerPool
+
+}  // namespace cnstream
+
+#endif  // MODULES_SOURCE_STREAM_WORKER_POOL_HPP_
@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "timer_wheel.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace cnstream {
+
+TimerWheel::TimerWheel(Clock::duration tick, size_t slot_num) : tick_(tick), start_(Clock::now()) {
+  LOG_IF(FATAL, tick_ <= Clock::duration::zero() || 0 == slot_num) << "TimerWheel: invalid tick or slot number";
+  slots_.resize(slot_num);
+  thread_ = std::thread(&TimerWheel::Run, this);
+}
+
+TimerWheel::~TimerWheel() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+void TimerWheel::Schedule(Clock::time_point due, Callback callback) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (0 == pending_) {
+      // the thread is sleeping, catches up the ticks passed
+      current_tick_ = std::max(current_tick_, static_cast<uint64_t>((Clock::now() - start_) / tick_));
+    }
+    // rounded up, not earlier than the due time
+    uint64_t tick = 0;
+    if (due > start_) tick = (due - start_ + tick_ - Clock::duration(1)) / tick_;
+    // the current tick is visited, the timer is run by the next one
+    if (tick <= current_tick_) tick = current_tick_ + 1;
+    slots_[tick % slots_.size()].push_back({tick, std::move(callback)});
+    wake = 0 == pending_++;
+  }
+  // the thread sleeps while there is no timer
+  if (wake) cond_.notify_one();
+}
+
+size_t TimerWheel::GetPendingNumber() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return pending_;
+}
+
+void TimerWheel::Run() {
+  std::vector<Callback> expired;
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (running_) {
+    if (0 == pending_) {
+      cond_.wait(lk, [this] { return !running_ || pending_ > 0; });
+      continue;
+    }
+    auto next = start_ + tick_ * (current_tick_ + 1);
+    if (Clock::now() < next) {
+      cond_.wait_until(lk, next);
+      continue;
+    }
+    // visits the slots of the ticks passed
+    uint64_t now_tick = (Clock::now() - start_) / tick_;
+    // all the slots are visited in a round
+    if (now_tick - current_tick_ > slots_.size()) current_tick_ = now_tick - slots_.size();
+    while (current_tick_ < now_tick) {
+      ++current_tick_;
+      auto &slot = slots_[current_tick_ % slots_.size()];
+      // the timers of later rounds are kept in order
+      auto kept = slot.begin();
+      for (auto iter = slot.begin(); iter != slot.end(); ++iter) {
+        if (iter->tick <= current_tick_) {
+          expired.push_back(std::move(iter->callback));
+        } else {
+          if (kept != iter) *kept = std::move(*iter);
+          ++kept;
+        }
+      }
+      slot.erase(kept, slot.end());
+    }
+    if (expired.empty()) continue;
+    pending_ -= expired.size();
+    lk.unlock();
+    for (auto &callback : expired) callback();
+    expired.clear();
+    lk.lock();
+  }
+}
+
+}  // namespace cnstream
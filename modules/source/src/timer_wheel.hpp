@@ -0,0 +1,83 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_SOURCE_TIMER_WHEEL_HPP_
+#define MODULES_SOURCE_TIMER_WHEEL_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cnstream_common.hpp"
+
+namespace cnstream {
+
+/**
+ * A hashed timer wheel running the callbacks of many timers on one thread.
+ *
+ * A timer is put into the slot of its tick in O(1), and the thread visits one slot per tick. The callbacks are run no
+ * earlier than their due time and at most about one tick later. The thread sleeps while there is no timer.
+ */
+class TimerWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  /**
+   * @param tick The time of a tick.
+   * @param slot_num The number of slots. The timers due later than a round of the wheel wait for more rounds.
+   */
+  explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1), size_t slot_num = 1024);
+  /**
+   * Stops the thread, the timers not due yet are dropped.
+   */
+  ~TimerWheel();
+  /**
+   * Runs ``callback`` on the thread of the wheel at ``due``. The callback should be short.
+   */
+  void Schedule(Clock::time_point due, Callback callback);
+  /**
+   * @return Returns the number of the timers not run yet.
+   */
+  size_t GetPendingNumber();
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(TimerWheel);
+  struct Timer {
+    uint64_t tick;
+    Callback callback;
+  };
+  void Run();
+  Clock::duration tick_;
+  Clock::time_point start_;
+  uint64_t current_tick_ = 0;
+  size_t pending_ = 0;
+  bool running_ = true;
+  std::vector<std::vector<Timer>> slots_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread thread_;
+};  // class TimerWheel
+
+}  // namespace cnstream
+
+#endif  // MODULES_SOURCE_TIMER_WHEEL_HPP_
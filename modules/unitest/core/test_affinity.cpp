@@ -0,0 +1,85 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sched.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "cnstream_affinity.hpp"
+#include "cnstream_common.hpp"
+#include "cnstream_syncmem.hpp"
+
+namespace cnstream {
+
+TEST(CoreAffinity, ParseCpuList) {
+  EXPECT_EQ(ParseCpuList("0-3,8,10-11\n"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCpuList("5"), std::vector<int>({5}));
+  EXPECT_TRUE(ParseCpuList("").empty());
+  EXPECT_TRUE(ParseCpuList("3-1").empty());
+  EXPECT_TRUE(ParseCpuList("a,1").empty());
+  EXPECT_TRUE(ParseCpuList("1-2x").empty());
+}
+
+TEST(CoreAffinity, NumaNode) {
+  int node_count = GetNumaNodeCount();
+  ASSERT_GE(node_count, 1);
+  EXPECT_FALSE(GetNumaNodeCpus(0).empty());
+  EXPECT_TRUE(GetNumaNodeCpus(node_count).empty());
+  EXPECT_TRUE(GetNumaNodeCpus(-1).empty());
+  for (uint32_t stream_idx = 0; stream_idx < 8; ++stream_idx) {
+    EXPECT_EQ(GetStreamNumaNode(stream_idx), static_cast<int>(stream_idx % node_count));
+  }
+}
+
+TEST(CoreAffinity, SetThreadAffinity) {
+  std::thread([]() {
+    EXPECT_FALSE(SetThreadAffinity({}));
+    EXPECT_FALSE(SetThreadAffinity({-1}));
+    ASSERT_TRUE(SetThreadAffinity({0}));
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpuset), &cpuset), 0);
+    EXPECT_EQ(CPU_COUNT(&cpuset), 1);
+    EXPECT_TRUE(CPU_ISSET(0, &cpuset));
+  }).join();
+}
+
+TEST(CoreAffinity, MallocHostOnNode) {
+  std::thread([]() {
+    EXPECT_EQ(GetThreadMemoryNode(), -1);
+    SetThreadMemoryNode(0);
+    EXPECT_EQ(GetThreadMemoryNode(), 0);
+    const size_t size = 1 << 20;
+    void* ptr = nullptr;
+    CNStreamMallocHost(&ptr, size);
+    ASSERT_NE(ptr, nullptr);
+    memset(ptr, 1, size);
+    CNStreamFreeHost(ptr);
+    CNStreamMallocHost(&ptr, 16);
+    ASSERT_NE(ptr, nullptr);
+    CNStreamFreeHost(ptr);
+  }).join();
+  EXPECT_FALSE(BindHostMemory(nullptr, 4096, 0));
+}
+
+}  // namespace cnstream
@@ -18,9 +18,13 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <ctime>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -174,4 +178,259 @@ TEST(CoreConveyor, PopAllData) {
   delete conveyor;
 }
 
+TEST(CoreConveyor, PopDataBufferBatch) {
+  for (ConveyorQueueType queue_type : {QUEUE_MUTEX, QUEUE_LOCKFREE, QUEUE_FAIR}) {
+    Connector connector(1, 8, queue_type);
+    Conveyor* conveyor = connector.GetConveyor(0);
+    std::vector<CNFrameInfoPtr> sdata_vec;
+    for (uint32_t i = 0; i < 5; i++) {
+      sdata_vec.push_back(CNFrameInfo::Create(std::to_string(0)));
+      EXPECT_TRUE(conveyor->PushDataBuffer(sdata_vec.back()));
+    }
+    std::vector<CNFrameInfoPtr> rdata_vec = conveyor->PopDataBufferBatch(3, std::chrono::microseconds(0));
+    ASSERT_EQ(rdata_vec.size(), 3u);
+    rdata_vec = conveyor->TryPopDataBufferBatch(3);
+    ASSERT_EQ(rdata_vec.size(), 2u);
+    EXPECT_EQ(rdata_vec[0], sdata_vec[3]);
+    EXPECT_EQ(rdata_vec[1], sdata_vec[4]);
+    EXPECT_TRUE(conveyor->TryPopDataBufferBatch(3).empty());
+
+    // waits for more data after the first one
+    std::thread push_thread([&]() {
+      EXPECT_TRUE(conveyor->PushDataBuffer(sdata_vec[0]));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      EXPECT_TRUE(conveyor->PushDataBuffer(sdata_vec[1]));
+    });
+    rdata_vec = conveyor->PopDataBufferBatch(2, std::chrono::seconds(5));
+    push_thread.join();
+    EXPECT_EQ(rdata_vec, std::vector<CNFrameInfoPtr>({sdata_vec[0], sdata_vec[1]}));
+
+    // returns what it has when the wait times out
+    EXPECT_TRUE(conveyor->PushDataBuffer(sdata_vec[2]));
+    auto start = std::chrono::steady_clock::now();
+    rdata_vec = conveyor->PopDataBufferBatch(2, std::chrono::milliseconds(10));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+    EXPECT_EQ(rdata_vec, std::vector<CNFrameInfoPtr>({sdata_vec[2]}));
+
+    connector.Stop();
+    EXPECT_TRUE(conveyor->PopDataBufferBatch(2, std::chrono::milliseconds(10)).empty());
+  }
+}
+
+TEST(CoreConveyor, WakeUpOnStop) {
+  for (ConveyorQueueType queue_type : {QUEUE_MUTEX, QUEUE_LOCKFREE, QUEUE_FAIR}) {
+    Connector connector(1, 1, queue_type);
+    Conveyor* conveyor = connector.GetConveyor(0);
+    EXPECT_TRUE(conveyor->PushDataBuffer(CNFrameInfo::Create(std::to_string(0))));
+    // blocked on full queue and empty queue
+    std::thread push_thread([&]() { EXPECT_FALSE(conveyor->PushDataBuffer(CNFrameInfo::Create(std::to_string(0)))); });
+    Connector empty_connector(1, 1, queue_type);
+    std::thread pop_thread([&]() { EXPECT_EQ(empty_connector.PopDataBufferFromConveyor(0), nullptr); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto start = std::chrono::steady_clock::now();
+    connector.Stop();
+    empty_connector.Stop();
+    push_thread.join();
+    pop_thread.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+    EXPECT_GT(conveyor->GetPushBlockedTime(), 0u);
+    EXPECT_GT(empty_connector.GetConveyor(0)->GetPopBlockedTime(), 0u);
+  }
+}
+
+TEST(CoreConveyor, WakeUpOnData) {
+  for (ConveyorQueueType queue_type : {QUEUE_MUTEX, QUEUE_LOCKFREE, QUEUE_FAIR}) {
+    Connector connector(1, 1, queue_type);
+    Conveyor* conveyor = connector.GetConveyor(0);
+    CNFrameInfoPtr sdata = CNFrameInfo::Create(std::to_string(0));
+    std::chrono::steady_clock::time_point pop_time;
+    std::thread pop_thread([&]() {
+      EXPECT_EQ(conveyor->PopDataBuffer(), sdata);
+      pop_time = std::chrono::steady_clock::now();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto push_time = std::chrono::steady_clock::now();
+    EXPECT_TRUE(conveyor->PushDataBuffer(sdata));
+    pop_thread.join();
+    EXPECT_LT(pop_time - push_time, std::chrono::milliseconds(10));
+  }
+}
+
+TEST(CoreConveyor, BlockTimeout) {
+  for (ConveyorQueueType queue_type : {QUEUE_MUTEX, QUEUE_LOCKFREE, QUEUE_FAIR}) {
+    Connector connector(1, 1, queue_type);
+    connector.SetBlockTimeout(10);
+    EXPECT_EQ(connector.GetBlockTimeout(), 10u);
+    Conveyor* conveyor = connector.GetConveyor(0);
+    // pop times out on empty queue
+    EXPECT_EQ(conveyor->PopDataBuffer(), nullptr);
+    EXPECT_GE(conveyor->GetPopBlockedTime(), 10000u);
+    // push times out on full queue, the data is dropped
+    CNFrameInfoPtr sdata = CNFrameInfo::Create(std::to_string(0));
+    EXPECT_TRUE(conveyor->PushDataBuffer(sdata));
+    EXPECT_FALSE(conveyor->PushDataBuffer(CNFrameInfo::Create(std::to_string(0))));
+    EXPECT_GE(conveyor->GetPushBlockedTime(), 10000u);
+    EXPECT_EQ(conveyor->GetPushTimeoutCount(), 1u);
+    EXPECT_EQ(conveyor->GetBufferSize(), 1u);
+    EXPECT_EQ(conveyor->PopDataBuffer(), sdata);
+  }
+}
+
+static CNFrameInfoPtr CreateStreamData(uint32_t chn_idx, const std::shared_ptr<CNStreamAdmission>& admission) {
+  CNFrameInfoPtr data = CNFrameInfo::Create(std::to_string(chn_idx), admission);
+  data->channel_idx = chn_idx;
+  return data;
+}
+
+TEST(CoreConveyor, FairQueueRoundRobin) {
+  Connector connector(1, 12, QUEUE_FAIR);
+  Conveyor* conveyor = connector.GetConveyor(0);
+  auto admission_a = std::make_shared<CNStreamAdmission>(0);
+  auto admission_b = std::make_shared<CNStreamAdmission>(0);
+  // stream 0 bursts before stream 1 comes
+  for (int i = 0; i < 8; ++i) EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(0, admission_a)));
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(1, admission_b)));
+  EXPECT_EQ(conveyor->GetBufferSize(), 12u);
+  // the capacity bounds all streams
+  EXPECT_FALSE(conveyor->TryPushDataBuffer(CreateStreamData(0, admission_a)));
+  EXPECT_FALSE(conveyor->TryPushDataBuffer(CreateStreamData(2, admission_b)));
+  std::string order;
+  for (int i = 0; i < 12; ++i) order += std::to_string(conveyor->PopDataBuffer()->channel_idx);
+  EXPECT_EQ(order, "010101010000");
+
+  // stream 0 weighted 3 to 1
+  admission_a->SetWeight(3);
+  EXPECT_EQ(admission_a->GetWeight(), 3u);
+  for (int i = 0; i < 8; ++i) EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(0, admission_a)));
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(1, admission_b)));
+  order.clear();
+  for (auto& data : conveyor->PopAllDataBuffer()) order += std::to_string(data->channel_idx);
+  EXPECT_EQ(order, "000100010011");
+  EXPECT_EQ(conveyor->GetBufferSize(), 0u);
+
+  // the frames without admission are weighted 1, and dropping keeps the data of the other streams
+  Conveyor drop_conveyor(&connector, 2, true, QUEUE_FAIR);
+  for (int i = 0; i < 4; ++i) {
+    CNFrameInfoPtr data = CNFrameInfo::Create(std::to_string(0));
+    data->channel_idx = 0;
+    data->frame.frame_id = i;
+    EXPECT_TRUE(drop_conveyor.PushDataBuffer(data));
+  }
+  CNFrameInfoPtr data = CreateStreamData(1, admission_b);
+  data->frame.frame_id = 0;
+  EXPECT_TRUE(drop_conveyor.PushDataBuffer(data));
+  order.clear();
+  for (auto& data : drop_conveyor.PopAllDataBuffer()) {
+    order += std::to_string(data->channel_idx) + ":" + std::to_string(data->frame.frame_id) + ",";
+  }
+  // stream 1 has nothing to drop, the stream having the most data loses its oldest one
+  EXPECT_EQ(order, "0:3,1:0,");
+}
+
+TEST(CoreConveyor, FairQueueCapacity) {
+  Connector connector(1, 4, QUEUE_FAIR);
+  Conveyor* conveyor = connector.GetConveyor(0);
+  auto admission_a = std::make_shared<CNStreamAdmission>(0);
+  auto admission_b = std::make_shared<CNStreamAdmission>(0);
+  // stream 0 takes the whole capacity while it is alone
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(0, admission_a)));
+  std::atomic<int> pushed_a{0}, pushed_b{0};
+  std::thread push_b([&] {
+    EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(1, admission_b)));
+    pushed_b++;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::thread push_a([&] {
+    EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(0, admission_a)));
+    pushed_a++;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(pushed_a.load() + pushed_b.load(), 0);
+  EXPECT_EQ(conveyor->GetBufferSize(), 4u);
+  // the space goes to stream 1 waiting, as stream 0 holds more than its share
+  EXPECT_EQ(conveyor->PopDataBuffer()->channel_idx, 0u);
+  push_b.join();
+  EXPECT_EQ(pushed_a.load(), 0);
+  EXPECT_EQ(conveyor->GetBufferSize(), 4u);
+  EXPECT_EQ(conveyor->PopDataBuffer()->channel_idx, 0u);
+  push_a.join();
+  EXPECT_EQ(conveyor->GetBufferSize(), 4u);
+
+  // the queue of a stream is released after its eos
+  EXPECT_EQ(conveyor->PopAllDataBuffer().size(), 4u);
+  auto eos = CNFrameInfo::Create(std::to_string(1), true);
+  eos->channel_idx = 1;
+  EXPECT_TRUE(conveyor->PushDataBuffer(eos));
+  EXPECT_EQ(conveyor->PopDataBuffer(), eos);
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(conveyor->PushDataBuffer(CreateStreamData(0, admission_a)));
+  EXPECT_EQ(conveyor->GetBufferSize(), 4u);
+}
+
+/*
+  A bursty stream pushes as fast as possible while another stream pushes now and then, the consumer is slower than
+  the bursty stream. Returns the most data popped between pushing a data of the slow stream and popping it.
+ */
+static uint64_t MaxDelayOfSlowStream(ConveyorQueueType queue_type) {
+  Connector connector(1, 16, queue_type);
+  Conveyor* conveyor = connector.GetConveyor(0);
+  auto admission_a = std::make_shared<CNStreamAdmission>(0);
+  auto admission_b = std::make_shared<CNStreamAdmission>(0);
+  constexpr int kSlowNum = 20;
+  // the count of the data popped is taken with the push of the slow stream and with the pop in one step
+  std::mutex count_mutex;
+  uint64_t popped = 0;
+  std::atomic<bool> done{false};
+  std::atomic<int> slow_popped{0};
+  std::thread bursty([&] {
+    while (!done.load()) {
+      if (!conveyor->PushDataBuffer(CreateStreamData(0, admission_a))) break;
+    }
+  });
+  std::thread slow([&] {
+    for (int i = 0; i < kSlowNum; ++i) {
+      // one data of the slow stream in the queue at a time, so that only the bursty stream is waited for
+      while (!done.load() && slow_popped.load() < i) std::this_thread::sleep_for(std::chrono::microseconds(50));
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      CNFrameInfoPtr data = CreateStreamData(1, admission_b);
+      {
+        // the time waiting for space counts
+        std::lock_guard<std::mutex> lk(count_mutex);
+        data->frame.timestamp = popped;
+      }
+      if (!conveyor->PushDataBuffer(data)) break;
+    }
+  });
+  uint64_t max_delay = 0;
+  int slow_num = 0;
+  while (slow_num < kSlowNum) {
+    std::unique_lock<std::mutex> lk(count_mutex);
+    CNFrameInfoPtr data = conveyor->PopDataBuffer();
+    if (!data) {
+      ADD_FAILURE() << "the connector stopped";
+      break;
+    }
+    uint64_t index = popped++;
+    lk.unlock();
+    if (1 == data->channel_idx) {
+      slow_popped.store(++slow_num);
+      max_delay = std::max(max_delay, index - static_cast<uint64_t>(data->frame.timestamp));
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  done.store(true);
+  connector.Stop();
+  bursty.join();
+  slow.join();
+  return max_delay;
+}
+
+TEST(CoreConveyor, FairQueueNoStarvation) {
+  uint64_t fifo_delay = MaxDelayOfSlowStream(QUEUE_MUTEX);
+  uint64_t fair_delay = MaxDelayOfSlowStream(QUEUE_FAIR);
+  // in one fifo, the slow stream waits behind the whole burst
+  EXPECT_GE(fifo_delay, 8u);
+  // in the fair queue, it waits for one data popped to free the space, and the data of the bursty stream in its turn
+  EXPECT_LE(fair_delay, 2u);
+}
+
 }  // namespace cnstream
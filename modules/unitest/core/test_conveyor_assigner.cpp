@@ -0,0 +1,81 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "connector.hpp"
+#include "conveyor.hpp"
+#include "conveyor_assigner.hpp"
+
+namespace cnstream {
+
+TEST(CoreConveyorAssigner, ByStreamIndex) {
+  Connector connector(4);
+  ConveyorAssigner* assigner = connector.GetAssigner();
+  ASSERT_NE(assigner, nullptr);
+  EXPECT_EQ(assigner->GetPolicy(), ASSIGN_BY_STREAM_INDEX);
+  EXPECT_EQ(assigner->GetConveyorIdx(5), 1u);
+  EXPECT_EQ(assigner->GetConveyorIdx(2), 2u);
+  EXPECT_EQ(assigner->GetConveyorIdx(5), 1u);
+  EXPECT_EQ(assigner->GetAssignment(), (std::map<uint32_t, uint32_t>{{2, 2}, {5, 1}}));
+  assigner->Release(5);
+  EXPECT_EQ(assigner->GetAssignment(), (std::map<uint32_t, uint32_t>{{2, 2}}));
+  // the streams out of range are not recorded
+  EXPECT_EQ(assigner->GetConveyorIdx(INVALID_STREAM_IDX), INVALID_STREAM_IDX % 4);
+  EXPECT_EQ(assigner->GetAssignment().size(), 1u);
+}
+
+TEST(CoreConveyorAssigner, LeastLoaded) {
+  Connector connector(3, 10);
+  ConveyorAssigner* assigner = connector.GetAssigner();
+  assigner->SetPolicy(ASSIGN_LEAST_LOADED);
+  // no load yet, the streams are spread by number
+  EXPECT_EQ(assigner->GetConveyorIdx(0), 0u);
+  EXPECT_EQ(assigner->GetConveyorIdx(1), 1u);
+  EXPECT_EQ(assigner->GetConveyorIdx(2), 2u);
+
+  // conveyor 0 and 1 are busy
+  connector.GetConveyor(0)->AddProcessTime(1000000);
+  connector.GetConveyor(1)->AddProcessTime(1000000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(ConveyorAssigner::kSampleIntervalMs + 10));
+  EXPECT_EQ(assigner->GetConveyorIdx(3), 2u);
+
+  // the queue of conveyor 2 is full
+  for (int i = 0; i < 10; ++i) {
+    auto data = CNFrameInfo::Create("3");
+    data->channel_idx = 3;
+    EXPECT_TRUE(connector.GetConveyor(2)->TryPushDataBuffer(data));
+  }
+  EXPECT_EQ(assigner->GetConveyorIdx(4), 0u);
+  // the assigned streams keep their conveyors
+  EXPECT_EQ(assigner->GetConveyorIdx(3), 2u);
+
+  // the stream is assigned again after it is released, conveyor 0 got stream 4 after the sample
+  assigner->Release(3);
+  EXPECT_EQ(assigner->GetConveyorIdx(3), 1u);
+  EXPECT_EQ(assigner->GetAssignment(), (std::map<uint32_t, uint32_t>{{0, 0}, {1, 1}, {2, 2}, {3, 1}, {4, 0}}));
+}
+
+}  // namespace cnstream
@@ -18,9 +18,12 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <chrono>
+#include <cstring>
 #include <ctime>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -102,6 +105,51 @@ TEST(CoreFrame, ConvertImageToBGRFailed) {
 }
 #endif
 
+TEST(CoreFrame, PlanarAndGrayFormats) {
+  EXPECT_EQ(CNGetPlanes(CN_PIXEL_FORMAT_YUV420P), 3);
+  EXPECT_EQ(CNGetPlanes(CN_PIXEL_FORMAT_GRAY8), 1);
+
+  CNDataFrame frame;
+  frame.ctx.dev_type = DevContext::CPU;
+  frame.fmt = CN_PIXEL_FORMAT_YUV420P;
+  frame.width = 1920;
+  frame.height = 1080;
+  frame.stride[0] = 1920;
+  frame.stride[1] = frame.stride[2] = 960;
+  EXPECT_EQ(frame.GetPlaneBytes(0), 1920u * 1080);
+  EXPECT_EQ(frame.GetPlaneBytes(1), 960u * 1080 / 2);
+  EXPECT_EQ(frame.GetPlaneBytes(2), 960u * 1080 / 2);
+  EXPECT_EQ(frame.GetBytes(), 1920u * 1080 * 3 / 2);
+  std::vector<uint8_t> planes[3];
+  for (int i = 0; i < 3; ++i) {
+    planes[i].assign(frame.GetPlaneBytes(i), 16 * (i + 1));
+    frame.ptr_cpu[i] = planes[i].data();
+  }
+  frame.CopyToSyncMem();
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(reinterpret_cast<const uint8_t*>(frame.data[i]->GetCpuData())[0], 16 * (i + 1));
+  }
+#ifdef HAVE_OPENCV
+  EXPECT_NE(frame.ImageBGR(), nullptr);
+#endif
+
+  CNDataFrame gray;
+  gray.ctx.dev_type = DevContext::CPU;
+  gray.fmt = CN_PIXEL_FORMAT_GRAY8;
+  gray.width = 1920;
+  gray.height = 1080;
+  gray.stride[0] = 1920;
+  EXPECT_EQ(gray.GetBytes(), 1920u * 1080);
+  std::vector<uint8_t> luma(gray.GetBytes(), 128);
+  gray.ptr_cpu[0] = luma.data();
+  gray.CopyToSyncMem();
+#ifdef HAVE_OPENCV
+  cv::Mat* bgr = gray.ImageBGR();
+  ASSERT_NE(bgr, nullptr);
+  EXPECT_EQ(bgr->at<cv::Vec3b>(0, 0)[0], 128);
+#endif
+}
+
 TEST(CoreFrameDeathTest, CopyToSyncMemFailed) {
   CNDataFrame frame;
   InitFrame(&frame, 0);
@@ -116,6 +164,30 @@ TEST(CoreFrameDeathTest, CopyToSyncMemFailed) {
   free(frame.ptr_cpu[0]);
 }
 
+TEST(CoreFrame, CopyToSyncMemByRef) {
+  class TestDeallocator : public IDataDeallocator {
+   public:
+    explicit TestDeallocator(CNDataFrame* frame) : frame_(frame) {}
+    ~TestDeallocator() {
+      free(frame_->ptr_cpu[0]);
+      free(frame_->ptr_cpu[1]);
+    }
+
+   private:
+    CNDataFrame* frame_;
+  };
+  CNDataFrame frame;
+  InitFrame(&frame, 1);
+  frame.fmt = CN_PIXEL_FORMAT_YUV420_NV12;
+  frame.deAllocator_ = std::make_shared<TestDeallocator>(&frame);
+
+  frame.CopyToSyncMem();
+  // the planes are referenced, not copied
+  EXPECT_EQ(frame.cpu_data, nullptr);
+  EXPECT_EQ(frame.data[0]->GetCpuData(), frame.ptr_cpu[0]);
+  EXPECT_EQ(frame.data[1]->GetCpuData(), frame.ptr_cpu[1]);
+}
+
 TEST(CoreFrame, InferObjAddAttribute) {
   CNInferObject infer_obj;
   std::string key = "test_key";
@@ -227,24 +299,222 @@ TEST(CoreFrame, CreateFrameInfo) {
 TEST(CoreFrame, CreateFrameInfoMultiParal) {
   uint32_t seed = (uint32_t)time(0);
   int paral = rand_r(&seed) % 64 + 1;
+  auto admission = std::make_shared<CNStreamAdmission>(paral);
   {
-    SetParallelism(paral);
-    EXPECT_EQ(GetParallelism(), paral);
     std::vector<std::shared_ptr<CNFrameInfo>> frame_info_ptrs;
     for (int i = 0; i < paral; i++) {
       // create frame
-      frame_info_ptrs.push_back(CNFrameInfo::Create("0"));
+      frame_info_ptrs.push_back(CNFrameInfo::Create("0", admission, false));
       EXPECT_NE(frame_info_ptrs[i], nullptr);
       frame_info_ptrs[i]->frame.ctx.dev_type = DevContext::CPU;
     }
+    EXPECT_EQ(admission->GetInflightNumber(), paral);
 
     // exceed parallelism
-    EXPECT_EQ(CNFrameInfo::Create("0"), nullptr);
+    EXPECT_EQ(CNFrameInfo::Create("0", admission, false), nullptr);
 
     // create eos frame
     EXPECT_NE(CNFrameInfo::Create("0", true), nullptr);
   }
-  SetParallelism(0);
+  EXPECT_EQ(admission->GetInflightNumber(), 0);
+}
+
+TEST(CoreFrame, FrameInfoPool) {
+  CNFrameInfoPool pool(2);
+  EXPECT_EQ(pool.GetCapacity(), 2u);
+  std::vector<std::shared_ptr<CNFrameInfo>> frames;
+  for (int i = 0; i < 3; ++i) {
+    frames.push_back(pool.Acquire());
+    ASSERT_NE(frames.back(), nullptr);
+  }
+  EXPECT_EQ(pool.GetHitCount(), 0u);
+  EXPECT_EQ(pool.GetMissCount(), 3u);
+  CNFrameInfo* first = frames[0].get();
+  frames[0]->frame.stream_id = "0";
+  frames[0]->frame.flags = CN_FRAME_FLAG_EOS;
+  frames[0]->channel_idx = 0;
+  frames[0]->objs.push_back(std::make_shared<CNInferObject>());
+  frames[0]->renditions["small"] = std::make_shared<CNDataFrame>();
+  frames.clear();
+  // keeps at most capacity idle frames
+  EXPECT_EQ(pool.GetIdleNumber(), 2u);
+
+  std::shared_ptr<CNFrameInfo> frame = pool.Acquire();
+  EXPECT_EQ(pool.GetHitCount(), 1u);
+  EXPECT_EQ(pool.GetIdleNumber(), 1u);
+  // recycled frames are reset
+  if (frame.get() == first) {
+    EXPECT_TRUE(frame->frame.stream_id.empty());
+    EXPECT_EQ(frame->frame.flags, 0u);
+    EXPECT_EQ(frame->channel_idx, INVALID_STREAM_IDX);
+    EXPECT_EQ(frame->objs.size(), 0u);
+    EXPECT_TRUE(frame->renditions.empty());
+  }
+  EXPECT_EQ(frame->frame.ctx.dev_type, DevContext::INVALID);
+}
+
+TEST(CoreFrame, GetRendition) {
+  auto data = CNFrameInfo::Create("0");
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(data->GetRendition(""), &data->frame);
+  // falls back to the full-resolution frame
+  EXPECT_EQ(data->GetRendition("small"), &data->frame);
+  std::shared_ptr<CNDataFrame> small = std::make_shared<CNDataFrame>();
+  data->renditions["small"] = small;
+  EXPECT_EQ(data->GetRendition("small"), small.get());
+  EXPECT_EQ(data->GetRendition("large"), &data->frame);
+  EXPECT_EQ(data->GetRendition(""), &data->frame);
+}
+
+TEST(CoreFrame, FrameInfoPoolReuseStorage) {
+  CNFrameInfoPool pool(1);
+  void* cpu_data = nullptr;
+  CNSyncedMemory* synced_mem = nullptr;
+  for (int i = 0; i < 2; ++i) {
+    std::shared_ptr<CNFrameInfo> frame = pool.Acquire();
+    InitFrame(&frame->frame, 0);
+    frame->frame.fmt = CN_PIXEL_FORMAT_BGR24;
+    frame->frame.CopyToSyncMem();
+    if (0 == i) {
+      cpu_data = frame->frame.cpu_data;
+      synced_mem = frame->frame.data[0].get();
+    } else {
+      EXPECT_EQ(pool.GetHitCount(), 1u);
+      EXPECT_EQ(frame->frame.cpu_data, cpu_data);
+      EXPECT_EQ(frame->frame.data[0].get(), synced_mem);
+      EXPECT_EQ(frame->frame.data[0]->GetCpuData(), cpu_data);
+    }
+    free(frame->frame.ptr_cpu[0]);
+  }
+}
+
+TEST(CoreFrame, FrameInfoPoolAllocSyncMem) {
+  CNFrameInfoPool pool(1);
+  void* cpu_data = nullptr;
+  CNSyncedMemory* synced_mem[2] = {nullptr, nullptr};
+  for (int i = 0; i < 2; ++i) {
+    std::shared_ptr<CNFrameInfo> frame = pool.Acquire();
+    frame->frame.ctx.dev_type = DevContext::CPU;
+    frame->frame.fmt = CN_PIXEL_FORMAT_YUV420_NV21;
+    frame->frame.width = frame->frame.stride[0] = frame->frame.stride[1] = 1920;
+    frame->frame.height = 1080;
+    frame->frame.AllocSyncMem();
+    // the planes are written in place by the producer
+    for (int plane = 0; plane < 2; ++plane) {
+      memset(frame->frame.data[plane]->GetMutableCpuData(), i, frame->frame.GetPlaneBytes(plane));
+      EXPECT_EQ(frame->frame.data[plane]->GetSize(), frame->frame.GetPlaneBytes(plane));
+    }
+    if (0 == i) {
+      cpu_data = frame->frame.cpu_data;
+      synced_mem[0] = frame->frame.data[0].get();
+      synced_mem[1] = frame->frame.data[1].get();
+    } else {
+      EXPECT_EQ(pool.GetHitCount(), 1u);
+      EXPECT_EQ(frame->frame.cpu_data, cpu_data);
+      EXPECT_EQ(frame->frame.data[0].get(), synced_mem[0]);
+      EXPECT_EQ(frame->frame.data[1].get(), synced_mem[1]);
+      EXPECT_EQ(frame->frame.data[0]->GetCpuData(), cpu_data);
+    }
+  }
+}
+
+TEST(CoreFrame, FrameInfoPoolSharedPlanes) {
+  CNFrameInfoPool pool(1);
+  std::shared_ptr<CNSyncedMemory> plane;
+  void* cpu_data = nullptr;
+  for (int i = 0; i < 2; ++i) {
+    std::shared_ptr<CNFrameInfo> frame = pool.Acquire();
+    InitFrame(&frame->frame, 0);
+    frame->frame.fmt = CN_PIXEL_FORMAT_BGR24;
+    memset(frame->frame.ptr_cpu[0], i + 1, frame->frame.GetBytes());
+    frame->frame.CopyToSyncMem();
+    if (0 == i) {
+      // the plane is still referenced after the frame is recycled
+      plane = frame->frame.data[0];
+      cpu_data = frame->frame.cpu_data;
+    } else {
+      EXPECT_EQ(pool.GetHitCount(), 1u);
+      EXPECT_NE(frame->frame.cpu_data, cpu_data);
+      EXPECT_NE(frame->frame.data[0], plane);
+    }
+    free(frame->frame.ptr_cpu[0]);
+  }
+  // the memory of the recycled frame is kept for the plane and not overwritten by the next frame
+  ASSERT_EQ(plane->GetCpuData(), cpu_data);
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(plane->GetCpuData());
+  EXPECT_EQ(bytes[0], 1);
+  EXPECT_EQ(bytes[plane->GetSize() - 1], 1);
+}
+
+TEST(CoreFrame, FrameInfoPoolOutlivedByFrames) {
+  std::shared_ptr<CNFrameInfo> frame;
+  {
+    CNFrameInfoPool pool(4);
+    frame = pool.Acquire();
+    ASSERT_NE(frame, nullptr);
+  }
+  frame->frame.stream_id = "0";
+  frame.reset();
+}
+
+TEST(CoreFrame, CreateFrameInfoFromStreamPool) {
+  int paral = 4;
+  auto admission = std::make_shared<CNStreamAdmission>(paral);
+  CNFrameInfoPool* pool = admission->GetPool();
+  // the pool is sized by the frames in flight
+  EXPECT_EQ(pool->GetCapacity(), static_cast<size_t>(paral));
+  std::vector<std::shared_ptr<CNFrameInfo>> frames;
+  for (int i = 0; i < paral; i++) {
+    frames.push_back(CNFrameInfo::Create("0", admission, false));
+    ASSERT_NE(frames[i], nullptr);
+  }
+  // releasing a frame gives back its slot and the frame is reused
+  frames.pop_back();
+  EXPECT_EQ(admission->GetInflightNumber(), paral - 1);
+  std::shared_ptr<CNFrameInfo> frame = CNFrameInfo::Create("0", admission, false);
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(frame->frame.stream_id, "0");
+  EXPECT_EQ(pool->GetHitCount(), 1u);
+  EXPECT_EQ(pool->GetMissCount(), static_cast<uint64_t>(paral));
+  // frames outlive the admission
+  admission.reset();
+  frames.clear();
+  frame.reset();
+}
+
+TEST(CoreFrame, StreamAdmission) {
+  auto admission = std::make_shared<CNStreamAdmission>(1);
+  std::shared_ptr<CNFrameInfo> frame = CNFrameInfo::Create("0", admission);
+  ASSERT_NE(frame, nullptr);
+  EXPECT_EQ(CNFrameInfo::Create("0", admission, false), nullptr);
+
+  // blocks until the frame in flight is released
+  std::thread release_thread([&frame] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    frame.reset();
+  });
+  std::shared_ptr<CNFrameInfo> next = CNFrameInfo::Create("0", admission);
+  EXPECT_NE(next, nullptr);
+  release_thread.join();
+  EXPECT_EQ(admission->GetInflightNumber(), 1);
+
+  // a higher limit lets more frames in
+  admission->SetLimit(2);
+  EXPECT_NE(CNFrameInfo::Create("0", admission, false), nullptr);
+  admission->SetLimit(0);
+  EXPECT_EQ(admission->GetLimit(), 0);
+  EXPECT_NE(CNFrameInfo::Create("0", admission, false), nullptr);
+
+  // close wakes up the waiting caller
+  admission->SetLimit(1);
+  std::thread close_thread([&admission] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    admission->Close();
+  });
+  EXPECT_EQ(CNFrameInfo::Create("0", admission), nullptr);
+  close_thread.join();
+  next.reset();
+  EXPECT_EQ(admission->GetInflightNumber(), 0);
 }
 
 }  // namespace cnstream
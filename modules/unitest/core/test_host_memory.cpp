@@ -0,0 +1,181 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cnstream_common.hpp"
+#include "cnstream_syncmem.hpp"
+#include "threadsafe_queue.hpp"
+
+namespace cnstream {
+
+static const size_t g_frame_bytes = 1920 * 1080 * 3 / 2;
+
+static int64_t GetMinorPageFaults() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+TEST(CoreHostMemory, MallocAligned) {
+  for (size_t size : {1, 100, 4096, 65536, 3 * 1024 * 1024, 70 * 1024 * 1024}) {
+    void* ptr = nullptr;
+    CNStreamMallocHost(&ptr, size);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 64, 0u);
+    memset(ptr, 0xff, size);
+    CNStreamFreeHost(ptr);
+  }
+  CNStreamFreeHost(nullptr);
+}
+
+TEST(CoreHostMemory, ReuseFreedBlocks) {
+  void* ptr = nullptr;
+  CNStreamMallocHost(&ptr, g_frame_bytes);
+  CNStreamFreeHost(ptr);
+  CNHostMemoryStats stats = GetHostMemoryStats();
+  // the block is kept by this thread and reused by the frames of the same size class
+  void* reused = nullptr;
+  CNStreamMallocHost(&reused, g_frame_bytes - 100);
+  EXPECT_EQ(reused, ptr);
+  EXPECT_EQ(GetHostMemoryStats().hit_count, stats.hit_count + 1);
+  EXPECT_EQ(GetHostMemoryStats().miss_count, stats.miss_count);
+  CNStreamFreeHost(reused);
+}
+
+TEST(CoreHostMemory, FreeOnOtherThread) {
+  std::vector<void*> ptrs(4, nullptr);
+  for (auto& ptr : ptrs) CNStreamMallocHost(&ptr, g_frame_bytes);
+  // the blocks go to the shared free lists when the freeing thread exits
+  std::thread([&ptrs] {
+    for (auto ptr : ptrs) CNStreamFreeHost(ptr);
+  }).join();
+  CNHostMemoryStats stats = GetHostMemoryStats();
+  EXPECT_GE(stats.cached_bytes, ptrs.size() * g_frame_bytes);
+  for (auto& ptr : ptrs) CNStreamMallocHost(&ptr, g_frame_bytes);
+  EXPECT_EQ(GetHostMemoryStats().hit_count, stats.hit_count + ptrs.size());
+  for (auto ptr : ptrs) CNStreamFreeHost(ptr);
+  ReleaseHostMemoryCache();
+}
+
+TEST(CoreHostMemory, HighWater) {
+  CNHostMemoryStats stats = GetHostMemoryStats();
+  std::vector<void*> ptrs(8, nullptr);
+  for (auto& ptr : ptrs) CNStreamMallocHost(&ptr, g_frame_bytes);
+  EXPECT_GE(GetHostMemoryStats().in_use_bytes, stats.in_use_bytes + ptrs.size() * g_frame_bytes);
+  for (auto ptr : ptrs) CNStreamFreeHost(ptr);
+  CNHostMemoryStats after = GetHostMemoryStats();
+  EXPECT_EQ(after.in_use_bytes, stats.in_use_bytes);
+  EXPECT_GE(after.high_water_bytes, stats.in_use_bytes + ptrs.size() * g_frame_bytes);
+  ReleaseHostMemoryCache();
+}
+
+TEST(CoreHostMemory, CacheLimit) {
+  SetHostMemoryCacheLimit(0);
+  std::vector<void*> ptrs(4, nullptr);
+  for (auto& ptr : ptrs) CNStreamMallocHost(&ptr, g_frame_bytes);
+  size_t cached_bytes = GetHostMemoryStats().cached_bytes;
+  std::thread([&ptrs] {
+    for (auto ptr : ptrs) CNStreamFreeHost(ptr);
+  }).join();
+  // nothing is kept beyond the limit
+  EXPECT_EQ(GetHostMemoryStats().cached_bytes, cached_bytes);
+  SetHostMemoryCacheLimit(512 * 1024 * 1024);
+}
+
+TEST(CoreHostMemory, HugePages) {
+  SetHostMemoryHugePages(true);
+  void* ptr = nullptr;
+  CNStreamMallocHost(&ptr, 8 * 1024 * 1024);
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 64, 0u);
+  memset(ptr, 0, 8 * 1024 * 1024);
+  CNStreamFreeHost(ptr);
+  SetHostMemoryHugePages(false);
+  ReleaseHostMemoryCache();
+}
+
+/*
+  A source thread allocates and fills 1080p NV12 frames, which are freed by another thread with up to 8 frames in
+  flight, with malloc and with CNStreamMallocHost.
+ */
+static int64_t RunFramePipeline(std::function<void*(size_t)> alloc, std::function<void(void*)> release) {
+  const int frame_num = 400;
+  const int inflight = 8;
+  ThreadSafeQueue<void*> queue;
+  std::atomic<int> released{0};
+  int64_t faults = GetMinorPageFaults();
+  std::thread consumer([&] {
+    for (int i = 0; i < frame_num; ++i) {
+      void* ptr = nullptr;
+      queue.WaitAndPop(ptr);
+      release(ptr);
+      released.fetch_add(1);
+    }
+  });
+  for (int i = 0; i < frame_num; ++i) {
+    while (i - released.load() >= inflight) std::this_thread::yield();
+    void* ptr = alloc(g_frame_bytes + (i % 3) * 4096);
+    memset(ptr, i, g_frame_bytes);
+    queue.Push(ptr);
+  }
+  consumer.join();
+  return GetMinorPageFaults() - faults;
+}
+
+TEST(CoreHostMemory, PageFaultBenchmark) {
+  auto host_alloc = [](size_t size) {
+    void* ptr = nullptr;
+    CNStreamMallocHost(&ptr, size);
+    return ptr;
+  };
+  // warm up, with as many frames as the frames in flight at most
+  std::vector<void*> ptrs(16, nullptr);
+  for (auto& ptr : ptrs) {
+    ptr = host_alloc(g_frame_bytes);
+    memset(ptr, 0, g_frame_bytes);
+  }
+  std::thread([&ptrs] {
+    for (auto ptr : ptrs) CNStreamFreeHost(ptr);
+  }).join();
+  RunFramePipeline(malloc, free);
+  RunFramePipeline(host_alloc, CNStreamFreeHost);
+
+  int64_t malloc_faults = RunFramePipeline(malloc, free);
+  int64_t pool_faults = RunFramePipeline(host_alloc, CNStreamFreeHost);
+  std::cout << "[Minor page faults] malloc: " << malloc_faults << ", CNStreamMallocHost: " << pool_faults
+            << std::endl;
+  // the pages of the recycled blocks are faulted in once
+  EXPECT_LT(pool_faults, static_cast<int64_t>(g_frame_bytes / 4096));
+  ReleaseHostMemoryCache();
+}
+
+}  // namespace cnstream
@@ -0,0 +1,178 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "connector.hpp"
+#include "conveyor.hpp"
+#include "lockfree_queue.hpp"
+#include "threadsafe_queue.hpp"
+
+namespace cnstream {
+
+TEST(CoreLockFreeQueue, Capacity) {
+  EXPECT_EQ(LockFreeQueue<int>(1).Capacity(), 2u);
+  EXPECT_EQ(LockFreeQueue<int>(20).Capacity(), 32u);
+  EXPECT_EQ(LockFreeQueue<int>(64).Capacity(), 64u);
+}
+
+TEST(CoreLockFreeQueue, PushPopFullEmpty) {
+  LockFreeQueue<int> queue(8);
+  int value = -1;
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.TryPop(value));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.TryPush(i));
+  }
+  EXPECT_EQ(queue.Size(), 8u);
+  EXPECT_FALSE(queue.TryPush(8));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.TryPop(value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_TRUE(queue.Empty());
+  // wrap around
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(queue.TryPush(i));
+    EXPECT_TRUE(queue.TryPop(value));
+    EXPECT_EQ(value, i);
+  }
+}
+
+TEST(CoreLockFreeQueue, ReleaseElementOnPop) {
+  LockFreeQueue<std::shared_ptr<int>> queue(4);
+  std::shared_ptr<int> data = std::make_shared<int>(1);
+  EXPECT_TRUE(queue.TryPush(data));
+  EXPECT_EQ(data.use_count(), 2);
+  std::shared_ptr<int> out;
+  EXPECT_TRUE(queue.TryPop(out));
+  out.reset();
+  EXPECT_EQ(data.use_count(), 1);
+}
+
+TEST(CoreLockFreeQueue, MultiProducerMultiConsumer) {
+  const int producer_num = 4, consumer_num = 4, data_num = 10000;
+  LockFreeQueue<int> queue(16);
+  std::vector<std::atomic<int>> received(producer_num * data_num);
+  for (auto& it : received) it.store(0);
+  std::atomic<int> pop_count{0};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producer_num; ++p) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < data_num; ++i) {
+        while (!queue.TryPush(p * data_num + i)) std::this_thread::yield();
+      }
+    });
+  }
+  for (int c = 0; c < consumer_num; ++c) {
+    threads.emplace_back([&]() {
+      int value;
+      while (pop_count.load() < producer_num * data_num) {
+        if (queue.TryPop(value)) {
+          received[value]++;
+          pop_count++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& it : threads) it.join();
+  EXPECT_TRUE(queue.Empty());
+  for (auto& it : received) EXPECT_EQ(it.load(), 1);
+}
+
+TEST(CoreLockFreeQueue, ConveyorPushPop) {
+  Connector connector(1, 10, QUEUE_LOCKFREE);
+  EXPECT_EQ(connector.GetConveyorQueueType(), QUEUE_LOCKFREE);
+  Conveyor* conveyor = connector.GetConveyor(0);
+  std::vector<CNFrameInfoPtr> sdata_vec;
+  for (int i = 0; i < 5; ++i) {
+    sdata_vec.push_back(CNFrameInfo::Create(std::to_string(0)));
+    conveyor->PushDataBuffer(sdata_vec.back());
+  }
+  EXPECT_EQ(conveyor->GetBufferSize(), 5u);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(conveyor->PopDataBuffer(), sdata_vec[i]);
+  }
+  connector.Stop();
+  EXPECT_EQ(conveyor->PopDataBuffer(), nullptr);
+}
+
+TEST(CoreLockFreeQueue, ConveyorDropWhenFull) {
+  Connector connector(1);
+  size_t max_size = 10;
+  // the capacity of ring buffer is 16, conveyor should still hold no more than max_size data.
+  Conveyor conveyor(&connector, max_size, true, QUEUE_LOCKFREE);
+  std::vector<CNFrameInfoPtr> sdata_vec;
+  for (uint32_t i = 0; i < max_size + 1; i++) {
+    sdata_vec.push_back(CNFrameInfo::Create(std::to_string(0)));
+    conveyor.PushDataBuffer(sdata_vec.back());
+  }
+  std::vector<CNFrameInfoPtr> rdata_vec = conveyor.PopAllDataBuffer();
+  ASSERT_EQ(rdata_vec.size(), max_size);
+  for (uint32_t i = 0; i < max_size; i++) {
+    EXPECT_EQ(sdata_vec[i + 1], rdata_vec[i]);
+  }
+}
+
+/**
+ * Compares the throughput of the conveyors with different queue types.
+ * Several producers push frames to one conveyor and one consumer pops them, like the upstream modules and
+ * the thread of downstream module do.
+ */
+static double ConveyorThroughput(ConveyorQueueType queue_type, int producer_num, int total_num) {
+  Connector connector(1, 20, queue_type);
+  Conveyor* conveyor = connector.GetConveyor(0);
+  CNFrameInfoPtr data = CNFrameInfo::Create(std::to_string(0));
+  const int data_num = total_num / producer_num;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_num; ++p) {
+    producers.emplace_back([&]() {
+      for (int i = 0; i < data_num; ++i) conveyor->PushDataBuffer(data);
+    });
+  }
+  for (int i = 0; i < data_num * producer_num; ++i) {
+    EXPECT_NE(conveyor->PopDataBuffer(), nullptr);
+  }
+  for (auto& it : producers) it.join();
+  std::chrono::duration<double> dura = std::chrono::steady_clock::now() - start;
+  return data_num * producer_num / dura.count();
+}
+
+TEST(CoreLockFreeQueue, ConveyorThroughput) {
+  const int total_num = 4800;
+  for (int producer_num : {1, 4, 16}) {
+    double mutex_fps = ConveyorThroughput(QUEUE_MUTEX, producer_num, total_num);
+    double lockfree_fps = ConveyorThroughput(QUEUE_LOCKFREE, producer_num, total_num);
+    std::cout << "producers: " << producer_num << ", mutex queue: " << static_cast<uint64_t>(mutex_fps)
+              << " frames/s, lock-free queue: " << static_cast<uint64_t>(lockfree_fps) << " frames/s" << std::endl;
+  }
+}
+
+}  // namespace cnstream
@@ -25,9 +25,12 @@
 #include <ctime>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "cnstream_affinity.hpp"
 #include "cnstream_module.hpp"
 #include "cnstream_pipeline.hpp"
 
@@ -68,22 +71,65 @@ TEST(CoreModule, ModuleMask) {
   uint32_t seed = (uint32_t)time(0);
   const uint32_t mask_len = 32;
   TestModuleBase module;
-  uint64_t mask = 0;
 
   ModuleParamSet params;
   ASSERT_TRUE(module.Open(params));
-  EXPECT_EQ(module.GetId(), (uint32_t)0);
+  // the id is allocated when the module is added to a pipeline
+  EXPECT_EQ(module.GetId(), INVALID_MODULE_ID);
   for (uint32_t i = 0; i < mask_len; ++i) {
     module.SetParentId(rand_r(&seed) % mask_len);
   }
+  // each upstream module takes the bit of its index in the parent ids
   std::vector<size_t> p_ids = module.GetParentIds();
-  for (auto &id : p_ids) {
-    mask |= (uint64_t)1 << id;
+  std::set<size_t> p_id_set(p_ids.begin(), p_ids.end());
+  EXPECT_EQ(p_id_set.size(), p_ids.size());
+  uint64_t mask = 0;
+  for (size_t i = 0; i < p_ids.size(); ++i) {
+    EXPECT_EQ(module.GetParentMask(p_ids[i]), (uint64_t)1 << i);
+    mask |= module.GetParentMask(p_ids[i]);
   }
+  EXPECT_EQ(module.GetParentMask(mask_len), 0u);
   EXPECT_EQ(module.GetModulesMask(), mask);
   module.Close();
 }
 
+TEST(CoreModule, BindThread) {
+  TestModuleBase module;
+  EXPECT_FALSE(module.BindThread());
+  EXPECT_EQ(GetThreadMemoryNode(), -1);
+
+  std::thread([&module]() {
+    module.SetAffinity({0});
+    EXPECT_EQ(module.GetCpuAffinity(), std::vector<int>({0}));
+    EXPECT_TRUE(module.BindThread());
+    EXPECT_EQ(sched_getcpu(), 0);
+  }).join();
+
+  std::thread([&module]() {
+    module.SetAffinity({}, 0);
+    EXPECT_EQ(module.GetNumaNode(), 0);
+    EXPECT_TRUE(module.BindThread());
+    EXPECT_EQ(GetThreadMemoryNode(), 0);
+  }).join();
+
+  // stream placement is a setting of the pipeline of the module, the other pipelines are not affected
+  Pipeline pipeline("pipeline"), other_pipeline("other_pipeline");
+  auto placed_module = std::make_shared<TestModuleBase>();
+  auto other_module = std::make_shared<TestModuleBase>();
+  EXPECT_TRUE(pipeline.AddModule(placed_module));
+  EXPECT_TRUE(other_pipeline.AddModule(other_module));
+  EXPECT_TRUE(pipeline.SetStreamNumaPlacement(true));
+  EXPECT_TRUE(pipeline.GetStreamNumaPlacement());
+  EXPECT_FALSE(other_pipeline.GetStreamNumaPlacement());
+  std::thread([&placed_module, &other_module]() {
+    uint32_t stream_idx = GetNumaNodeCount() * 2 - 1;
+    EXPECT_TRUE(placed_module->BindThread(stream_idx));
+    EXPECT_EQ(GetThreadMemoryNode(), GetNumaNodeCount() - 1);
+    EXPECT_FALSE(other_module->BindThread(stream_idx));
+    EXPECT_EQ(GetThreadMemoryNode(), -1);
+  }).join();
+}
+
 TEST(CoreModule, TransmitAttr) {
   TestModuleBase module;
   EXPECT_FALSE(module.HasTransmit());
@@ -19,15 +19,20 @@
  *************************************************************************/
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <ctime>
 #include <future>
+#include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <random>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "cnstream_frame.hpp"
@@ -146,11 +151,21 @@ class TestProcessor : public Module {
     cnts_[chn_idx]++;
     return 0;
   }
+  int ProcessBatch(std::vector<std::shared_ptr<CNFrameInfo>>& data) override {
+    EXPECT_FALSE(data.empty());
+    for (auto& it : data) {
+      EXPECT_FALSE(CNFrameFlag::CN_FRAME_FLAG_EOS & it->frame.flags);
+    }
+    batch_cnt_++;
+    return Module::ProcessBatch(data);
+  }
   std::vector<uint64_t> GetCnts() const { return cnts_; }
+  uint64_t GetBatchCnt() const { return batch_cnt_.load(); }
 
  private:
   bool opened_ = false;
   std::vector<uint64_t> cnts_;
+  std::atomic<uint64_t> batch_cnt_{0};
   static std::atomic<int> id_;
 };  // class TestProcessor
 
@@ -242,7 +257,7 @@ struct FailureDesc {
 };
 
 std::pair<std::vector<std::shared_ptr<Module>>, std::shared_ptr<Pipeline>> CreatePipelineByNeighborList(
-    const std::vector<std::list<int>>& neighbor_list, FailureDesc fdesc = {-1, -1}) {
+    const std::vector<std::list<int>>& neighbor_list, FailureDesc fdesc = {-1, -1}, uint32_t max_batch = 1) {
   std::default_random_engine e(time(NULL));
   std::uniform_int_distribution<> chns_randomer(__MIN_CHN_CNT__, __MAX_CHN_CNT__);
   auto chns = chns_randomer(e);
@@ -270,6 +285,7 @@ std::pair<std::vector<std::shared_ptr<Module>>, std::shared_ptr<Pipeline>> Creat
   for (size_t i = 1; i < modules.size(); i++) {
     uint32_t thread_num = ths_randomer(e);
     EXPECT_TRUE(pipeline->SetModuleAttribute(modules[i], thread_num));
+    EXPECT_TRUE(pipeline->SetModuleBatchAttribute(modules[i], max_batch, 100));
     // EXPECT_TRUE(pipeline->SetModuleAttribute(modules[i],
     // dynamic_cast<TestProcessor*>(modules[0].get())->GetCnts().size()));
     thread_nums.push_back(thread_num);
@@ -292,9 +308,11 @@ std::pair<std::vector<std::shared_ptr<Module>>, std::shared_ptr<Pipeline>> Creat
   return {modules, pipeline};
 }
 
-void TestProcess(const std::vector<std::list<int>>& neighbor_list) {
-  auto pipeline_and_modules = CreatePipelineByNeighborList(neighbor_list);
+void TestProcess(const std::vector<std::list<int>>& neighbor_list,
+                 PipelineExecutorType executor_type = EXECUTOR_THREAD_PER_CONVEYOR, uint32_t max_batch = 1) {
+  auto pipeline_and_modules = CreatePipelineByNeighborList(neighbor_list, {-1, -1}, max_batch);
   auto pipeline = pipeline_and_modules.second;
+  EXPECT_TRUE(pipeline->SetExecutorType(executor_type));
   auto modules = pipeline_and_modules.first;
   auto provider = dynamic_cast<TestProvider*>(modules[0].get());
   EXPECT_TRUE(nullptr != provider);
@@ -314,15 +332,21 @@ void TestProcess(const std::vector<std::list<int>>& neighbor_list) {
     for (size_t j = 0; j < processor->GetCnts().size(); ++j) {
       EXPECT_EQ(provider->GetFrameCnts()[j], processor->GetCnts()[j]);
     }
+    if (max_batch == 1) {
+      EXPECT_EQ(processor->GetBatchCnt(), 0u);
+    }
   }
 }
 
-void TestProcessFailure(const std::vector<std::list<int>>& neighbor_list, int process_ret) {
+void TestProcessFailure(const std::vector<std::list<int>>& neighbor_list, int process_ret,
+                        PipelineExecutorType executor_type = EXECUTOR_THREAD_PER_CONVEYOR, uint32_t max_batch = 1) {
   std::default_random_engine e(time(NULL));
   std::uniform_int_distribution<> randomer(1, neighbor_list.size() - 1);
   int failure_module_idx = randomer(e);
-  auto pipeline_and_modules = CreatePipelineByNeighborList(neighbor_list, {failure_module_idx, process_ret});
+  auto pipeline_and_modules =
+      CreatePipelineByNeighborList(neighbor_list, {failure_module_idx, process_ret}, max_batch);
   auto pipeline = pipeline_and_modules.second;
+  EXPECT_TRUE(pipeline->SetExecutorType(executor_type));
   auto modules = pipeline_and_modules.first;
   auto provider = dynamic_cast<TestProvider*>(modules[0].get());
   EXPECT_TRUE(nullptr != provider);
@@ -356,6 +380,67 @@ TEST(CorePipeline, Pipeline_TestProcessFailure2) { TestProcessFailure(g_neighbor
 TEST(CorePipeline, Pipeline_TestProcessFailure3) { TestProcessFailure(g_neighbor_lists[3], -1); }
 
 TEST(CorePipeline, Pipeline_TestProcessFailure4) { TestProcessFailure(g_neighbor_lists[4], -1); }
+
+TEST(CorePipeline, Pipeline_TestProcessWorkStealing) {
+  for (auto& neighbor_list : g_neighbor_lists) {
+    TestProcess(neighbor_list, EXECUTOR_WORK_STEALING);
+  }
+}
+
+TEST(CorePipeline, Pipeline_TestProcessFailureWorkStealing) {
+  for (auto& neighbor_list : g_neighbor_lists) {
+    TestProcessFailure(neighbor_list, -1, EXECUTOR_WORK_STEALING);
+  }
+}
+
+TEST(CorePipeline, Pipeline_TestProcessManyModules) {
+  /*
+    provider ---> 70 processors ---> 2 processors, more than 64 modules in the pipeline,
+    each of the last 2 modules has 35 upstream modules.
+   */
+  const int chns = 2, branch_num = 70;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  auto provider = std::make_shared<TestProvider>(chns, pipeline.get());
+  std::vector<std::shared_ptr<TestProcessor>> branches, joins;
+  EXPECT_TRUE(pipeline->AddModule(provider));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(provider, 0));
+  for (int i = 0; i < branch_num + 2; ++i) {
+    auto processor = std::make_shared<TestProcessor>("TestProcessor" + std::to_string(i), chns);
+    EXPECT_TRUE(pipeline->AddModule(processor));
+    EXPECT_TRUE(pipeline->SetModuleAttribute(processor, 1));
+    (i < branch_num ? branches : joins).push_back(processor);
+  }
+  for (int i = 0; i < branch_num; ++i) {
+    EXPECT_NE(pipeline->LinkModules(provider, branches[i]), "");
+    EXPECT_NE(pipeline->LinkModules(branches[i], joins[i % 2]), "");
+  }
+  MsgObserver msg_observer(chns, pipeline);
+  pipeline->SetStreamMsgObserver(reinterpret_cast<StreamMsgObserver*>(&msg_observer));
+
+  EXPECT_TRUE(pipeline->Start());
+  provider->StartSendData();
+  EXPECT_EQ(MsgObserver::STOP_BY_EOS, msg_observer.WaitForStop());
+  provider->StopSendData();
+  for (auto& processor : joins) {
+    EXPECT_EQ(provider->GetFrameCnts(), processor->GetCnts());
+  }
+}
+
+TEST(CorePipeline, Pipeline_TestProcessBatch) {
+  for (auto executor_type : {EXECUTOR_THREAD_PER_CONVEYOR, EXECUTOR_WORK_STEALING}) {
+    for (auto& neighbor_list : g_neighbor_lists) {
+      TestProcess(neighbor_list, executor_type, 8);
+    }
+  }
+}
+
+TEST(CorePipeline, Pipeline_TestProcessFailureBatch) {
+  for (auto executor_type : {EXECUTOR_THREAD_PER_CONVEYOR, EXECUTOR_WORK_STEALING}) {
+    for (auto& neighbor_list : g_neighbor_lists) {
+      TestProcessFailure(neighbor_list, -1, executor_type, 8);
+    }
+  }
+}
 /*************************************************************************************************
                                         unit test for each function
 **************************************************************************************************/
@@ -424,6 +509,8 @@ TEST(CorePipeline, ParseByJSONStrDefault) {
   EXPECT_EQ(m_cfg.className, "test");
   EXPECT_EQ(m_cfg.parallelism, 1);
   EXPECT_EQ(m_cfg.maxInputQueueSize, 20);
+  EXPECT_EQ(m_cfg.inputQueueType, QUEUE_MUTEX);
+  EXPECT_EQ(m_cfg.inputQueueBlockTimeout, 0u);
   EXPECT_EQ(m_cfg.next.size(), (unsigned int)0);
   EXPECT_EQ(m_cfg.parameters.size(), (unsigned int)0);
 }
@@ -472,6 +559,102 @@ TEST(CorePipeline, ParseByJSONStrMaxInputQueueError) {
   EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
 }
 
+TEST(CorePipeline, ParseByJSONStrInputQueueType) {
+  CNModuleConfig m_cfg;
+  std::string json_str = "{\"class_name\":\"test\",\"input_queue_type\":\"lockfree\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.inputQueueType, QUEUE_LOCKFREE);
+  json_str = "{\"class_name\":\"test\",\"input_queue_type\":\"mutex\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.inputQueueType, QUEUE_MUTEX);
+  json_str = "{\"class_name\":\"test\",\"input_queue_type\":\"fair\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.inputQueueType, QUEUE_FAIR);
+  // input queue type must be "mutex", "lockfree" or "fair"
+  json_str = "{\"class_name\":\"test\",\"input_queue_type\":\"spsc\"}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+  json_str = "{\"class_name\":\"test\",\"input_queue_type\":1}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+}
+
+TEST(CorePipeline, ParseByJSONStrInputQueueBlockTimeout) {
+  CNModuleConfig m_cfg;
+  std::string json_str = "{\"class_name\":\"test\",\"input_queue_block_timeout_ms\":100}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.inputQueueBlockTimeout, 100u);
+  // input queue block timeout must be uint type
+  json_str = "{\"class_name\":\"test\",\"input_queue_block_timeout_ms\":-1}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+}
+
+TEST(CorePipeline, ParseByJSONStrAffinity) {
+  CNModuleConfig m_cfg;
+  std::string json_str = "{\"class_name\":\"test\",\"cpu_affinity\":[0,1],\"numa_node\":0}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.cpuAffinity, std::vector<int>({0, 1}));
+  EXPECT_EQ(m_cfg.numaNode, 0);
+  json_str = "{\"class_name\":\"test\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_TRUE(m_cfg.cpuAffinity.empty());
+  EXPECT_EQ(m_cfg.numaNode, -1);
+  // cpu affinity must be an array of uint
+  json_str = "{\"class_name\":\"test\",\"cpu_affinity\":0}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+  json_str = "{\"class_name\":\"test\",\"cpu_affinity\":[0,-1]}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+  // numa node must be int type and less than the numa node number
+  json_str = "{\"class_name\":\"test\",\"numa_node\":\"0\"}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+  json_str = "{\"class_name\":\"test\",\"numa_node\":1024}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+}
+
+TEST(CorePipeline, ParseByJSONStrBatch) {
+  CNModuleConfig m_cfg;
+  std::string json_str = "{\"class_name\":\"test\",\"max_batch\":8,\"max_wait_us\":500}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.maxBatch, 8u);
+  EXPECT_EQ(m_cfg.maxWaitUs, 500u);
+  json_str = "{\"class_name\":\"test\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_EQ(m_cfg.maxBatch, 1u);
+  EXPECT_EQ(m_cfg.maxWaitUs, 0u);
+  // max batch must be uint type and greater than 0
+  json_str = "{\"class_name\":\"test\",\"max_batch\":0}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+  json_str = "{\"class_name\":\"test\",\"max_batch\":-1}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+  // max wait must be uint type
+  json_str = "{\"class_name\":\"test\",\"max_wait_us\":\"1\"}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+}
+
+TEST(CorePipeline, ParseByJSONStrEnableFusion) {
+  CNModuleConfig m_cfg;
+  std::string json_str = "{\"class_name\":\"test\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_TRUE(m_cfg.enableFusion);
+  json_str = "{\"class_name\":\"test\",\"enable_fusion\":false}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_FALSE(m_cfg.enableFusion);
+  // enable fusion must be Boolean type
+  json_str = "{\"class_name\":\"test\",\"enable_fusion\":0}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+}
+
+TEST(CorePipeline, ParseByJSONStrFrameParallel) {
+  CNModuleConfig m_cfg;
+  std::string json_str = "{\"class_name\":\"test\"}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_FALSE(m_cfg.frameParallel);
+  json_str = "{\"class_name\":\"test\",\"frame_parallel\":true}";
+  EXPECT_TRUE(m_cfg.ParseByJSONStr(json_str));
+  EXPECT_TRUE(m_cfg.frameParallel);
+  // frame parallel must be Boolean type
+  json_str = "{\"class_name\":\"test\",\"frame_parallel\":1}";
+  EXPECT_FALSE(m_cfg.ParseByJSONStr(json_str));
+}
+
 TEST(CorePipeline, ParseByJSONStrNextModuleError) {
   CNModuleConfig m_cfg;
   // next module must be array
@@ -565,17 +748,17 @@ TEST(CorePipeline, ProvideDataFailed) {
 
 TEST(CorePipeline, AddModule) {
   Pipeline pipeline("test pipeline");
-  // pipeline is a special module, so id of pipeline 0
-  EXPECT_EQ(pipeline.GetId(), (uint32_t)0);
+  // module ids are allocated by the pipeline the module is added to
+  EXPECT_EQ(pipeline.GetId(), INVALID_MODULE_ID);
 
   uint32_t seed = (uint32_t)time(0);
-  // except pipeline itself, the pipeline could contain other (GetMaxModuleNumber - 1) modules
-  uint32_t module_num = rand_r(&seed) % (GetMaxModuleNumber() - 1) + 1;
+  uint32_t module_num = rand_r(&seed) % 256 + 1;
   for (uint32_t i = 0; i < module_num; i++) {
     auto module = std::make_shared<TestModule>("test_module" + std::to_string(i));
     EXPECT_EQ(module->GetName(), "test_module" + std::to_string(i));
+    EXPECT_EQ(module->GetId(), INVALID_MODULE_ID);
     EXPECT_TRUE(pipeline.AddModule(module));
-    EXPECT_EQ(module->GetId(), i + 1);
+    EXPECT_EQ(module->GetId(), i);
   }
 }
 
@@ -585,20 +768,38 @@ TEST(CorePipeline, AddModuleTwiceToPipeline) {
 
   // add module
   EXPECT_TRUE(pipeline.AddModule(module));
-  EXPECT_EQ(module->GetId(), (unsigned int)1);
+  EXPECT_EQ(module->GetId(), (unsigned int)0);
   // add the same module twice
   EXPECT_FALSE(pipeline.AddModule(module));
-  EXPECT_EQ(module->GetId(), (unsigned int)1);
+  EXPECT_EQ(module->GetId(), (unsigned int)0);
+}
+
+TEST(CorePipeline, AddModuleToTwoPipelines) {
+  auto module = std::make_shared<TestModule>("test_module");
+  {
+    Pipeline pipeline("test pipeline");
+    EXPECT_TRUE(pipeline.AddModule(std::make_shared<TestModule>("other_module")));
+    EXPECT_TRUE(pipeline.AddModule(module));
+    EXPECT_EQ(module->GetId(), (unsigned int)1);
+    // module ids are per pipeline
+    Pipeline other_pipeline("other pipeline");
+    EXPECT_FALSE(other_pipeline.AddModule(module));
+  }
+  // the module is released by the destroyed pipeline
+  EXPECT_EQ(module->GetId(), INVALID_MODULE_ID);
+  Pipeline pipeline("test pipeline");
+  EXPECT_TRUE(pipeline.AddModule(module));
+  EXPECT_EQ(module->GetId(), (unsigned int)0);
 }
 
 TEST(CorePipeline, AddModuleExcessPipelineCapacity) {
   Pipeline pipeline("test pipeline");
-  uint32_t module_num = GetMaxModuleNumber() - 1;
+  uint32_t module_num = GetMaxModuleNumber();
   for (uint32_t i = 0; i < module_num; i++) {
     auto module = std::make_shared<TestModule>("test_module" + std::to_string(i));
     EXPECT_EQ(module->GetName(), "test_module" + std::to_string(i));
     EXPECT_TRUE(pipeline.AddModule(module));
-    EXPECT_EQ(module->GetId(), i + 1);
+    EXPECT_EQ(module->GetId(), i);
   }
   // there are already GetMaxModuleNumber() modules, can not get id for this new module
   auto module = std::make_shared<TestModule>("test_module" + std::to_string(module_num));
@@ -624,6 +825,16 @@ TEST(CorePipeline, SetModuleAttributeFailed) {
   EXPECT_EQ(pipeline.GetModuleParallelism(module), (uint32_t)0);
 }
 
+TEST(CorePipeline, SetModuleBatchAttribute) {
+  Pipeline pipeline("test pipeline");
+  auto module = std::make_shared<TestModule>("test_module");
+  // can not find module in the pipeline
+  EXPECT_FALSE(pipeline.SetModuleBatchAttribute(module, 8));
+  EXPECT_TRUE(pipeline.AddModule(module));
+  EXPECT_TRUE(pipeline.SetModuleBatchAttribute(module, 8, 100));
+  EXPECT_FALSE(pipeline.SetModuleBatchAttribute(module, 0));
+}
+
 TEST(CorePipeline, LinkModules) {
   Pipeline pipeline("test pipeline");
   auto up_node = std::make_shared<TestModule>("up_node");
@@ -689,6 +900,17 @@ TEST(CorePipeline, LinkModulesFailed) {
   EXPECT_EQ(pipeline.LinkModules(up_node, down_node), "");
 }
 
+TEST(CorePipeline, LinkModulesExcessUpstreamModules) {
+  Pipeline pipeline("test pipeline");
+  auto down_node = std::make_shared<TestModule>("down_node");
+  EXPECT_TRUE(pipeline.AddModule(down_node));
+  for (uint32_t i = 0; i <= MAX_UPSTREAM_MODULE_NUM; ++i) {
+    auto up_node = std::make_shared<TestModule>("up_node" + std::to_string(i));
+    EXPECT_TRUE(pipeline.AddModule(up_node));
+    EXPECT_EQ(pipeline.LinkModules(up_node, down_node).empty(), i == MAX_UPSTREAM_MODULE_NUM);
+  }
+}
+
 TEST(CorePipeline, QueryLinkStatus) {
   Pipeline pipeline("test pipeline");
   auto up_node = std::make_shared<TestModule>("up_node");
@@ -707,6 +929,15 @@ TEST(CorePipeline, QueryLinkStatus) {
   EXPECT_EQ(status.cache_size.size(), (uint32_t)1);
   // data queue has 0 element
   EXPECT_EQ(status.cache_size[0], (uint32_t)0);
+  // no blocking yet
+  ASSERT_EQ(status.push_blocked_time.size(), (uint32_t)1);
+  EXPECT_EQ(status.push_blocked_time[0], (uint64_t)0);
+  ASSERT_EQ(status.pop_blocked_time.size(), (uint32_t)1);
+  EXPECT_EQ(status.pop_blocked_time[0], (uint64_t)0);
+  ASSERT_EQ(status.push_timeout_count.size(), (uint32_t)1);
+  EXPECT_EQ(status.push_timeout_count[0], (uint64_t)0);
+  ASSERT_EQ(status.process_time.size(), (uint32_t)1);
+  EXPECT_EQ(status.process_time[0], (uint64_t)0);
 
   auto down_node_2 = std::make_shared<TestModule>("down_node_2");
   uint32_t seed = (uint32_t)time(0);
@@ -1148,4 +1379,535 @@ TEST(CorePipeline, StreamMsgObserver) {
   pipeline.NotifyStreamMsg(msg);
 }
 
+class FusionTestModule : public Module {
+ public:
+  explicit FusionTestModule(const std::string& name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    std::lock_guard<std::mutex> lk(mtx_);
+    thread_ids_.insert(std::this_thread::get_id());
+    cnt_++;
+    return 0;
+  }
+  std::set<std::thread::id> GetThreadIds() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return thread_ids_;
+  }
+  uint32_t GetCnt() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return cnt_;
+  }
+
+ private:
+  std::mutex mtx_;
+  std::set<std::thread::id> thread_ids_;
+  uint32_t cnt_ = 0;
+};  // class FusionTestModule
+
+TEST(CorePipeline, ModuleFusion) {
+  Pipeline pipeline("pipeline");
+  auto source = std::make_shared<FusionTestModule>("source");
+  auto module_a = std::make_shared<FusionTestModule>("module_a");
+  auto module_b = std::make_shared<FusionTestModule>("module_b");
+  auto module_c = std::make_shared<FusionTestModule>("module_c");
+  auto module_d = std::make_shared<FusionTestModule>("module_d");
+  for (auto module : {source, module_a, module_b, module_c, module_d}) EXPECT_TRUE(pipeline.AddModule(module));
+  EXPECT_TRUE(pipeline.SetModuleAttribute(source, 0));
+  EXPECT_TRUE(pipeline.SetModuleAttribute(module_a, 2));
+  EXPECT_TRUE(pipeline.SetModuleAttribute(module_b, 2));
+  EXPECT_TRUE(pipeline.SetModuleAttribute(module_c, 2));
+  // module_d is not fused as its parallelism differs from module_c's
+  EXPECT_TRUE(pipeline.SetModuleAttribute(module_d, 4));
+  // module_c keeps its own threads
+  EXPECT_TRUE(pipeline.SetModuleFusion(module_c, false));
+  EXPECT_FALSE(pipeline.SetModuleFusion(std::make_shared<FusionTestModule>("not_added"), false));
+  EXPECT_NE(pipeline.LinkModules(source, module_a), "");
+  EXPECT_NE(pipeline.LinkModules(module_a, module_b), "");
+  EXPECT_NE(pipeline.LinkModules(module_b, module_c), "");
+  EXPECT_NE(pipeline.LinkModules(module_c, module_d), "");
+
+  ASSERT_TRUE(pipeline.Start());
+  const uint32_t frame_num = 32;
+  for (uint32_t i = 0; i < frame_num; ++i) {
+    auto data = CNFrameInfo::Create(std::to_string(i % 4));
+    data->channel_idx = i % 4;
+    data->frame.frame_id = i / 4;
+    EXPECT_TRUE(pipeline.ProvideData(source.get(), data));
+  }
+  auto start = std::chrono::steady_clock::now();
+  while (module_d->GetCnt() < frame_num && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  pipeline.Stop();
+
+  EXPECT_EQ(module_b->GetCnt(), frame_num);
+  EXPECT_EQ(module_c->GetCnt(), frame_num);
+  EXPECT_EQ(module_d->GetCnt(), frame_num);
+  // module_b is fused into module_a, module_c and module_d are not
+  EXPECT_EQ(module_a->GetThreadIds().size(), 2u);
+  EXPECT_EQ(module_b->GetThreadIds(), module_a->GetThreadIds());
+  for (auto& thread_id : module_c->GetThreadIds()) {
+    EXPECT_EQ(module_a->GetThreadIds().count(thread_id), 0u);
+  }
+  // module_d keeps its own 4 threads
+  EXPECT_EQ(module_d->GetThreadIds().size(), 4u);
+  for (auto& thread_id : module_d->GetThreadIds()) {
+    EXPECT_EQ(module_c->GetThreadIds().count(thread_id), 0u);
+  }
+}
+
+TEST(CorePipeline, SetExecutorType) {
+  Pipeline pipeline("test pipeline");
+  EXPECT_EQ(pipeline.GetExecutorType(), EXECUTOR_THREAD_PER_CONVEYOR);
+  EXPECT_TRUE(pipeline.SetExecutorType(EXECUTOR_WORK_STEALING, 2));
+  EXPECT_EQ(pipeline.GetExecutorType(), EXECUTOR_WORK_STEALING);
+  EXPECT_TRUE(pipeline.Start());
+  // can not be changed while running
+  EXPECT_FALSE(pipeline.SetExecutorType(EXECUTOR_THREAD_PER_CONVEYOR));
+  EXPECT_TRUE(pipeline.Stop());
+  EXPECT_TRUE(pipeline.SetExecutorType(EXECUTOR_THREAD_PER_CONVEYOR));
+}
+
+TEST(CorePipeline, ConveyorAssignPolicy) {
+  const int chn_cnt = 8;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  EXPECT_EQ(pipeline->GetConveyorAssignPolicy(), ASSIGN_BY_STREAM_INDEX);
+  EXPECT_TRUE(pipeline->SetConveyorAssignPolicy(ASSIGN_LEAST_LOADED));
+  EXPECT_EQ(pipeline->GetConveyorAssignPolicy(), ASSIGN_LEAST_LOADED);
+  auto source = std::make_shared<TestModule>("source");
+  auto module = std::make_shared<TestModule>("module");
+  EXPECT_TRUE(pipeline->AddModule(source));
+  EXPECT_TRUE(pipeline->AddModule(module));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(source, 0));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(module, 4));
+  EXPECT_NE(pipeline->LinkModules(source, module), "");
+  MsgObserver msg_observer(chn_cnt, pipeline);
+  pipeline->SetStreamMsgObserver(reinterpret_cast<StreamMsgObserver*>(&msg_observer));
+
+  EXPECT_TRUE(pipeline->Start());
+  EXPECT_FALSE(pipeline->SetConveyorAssignPolicy(ASSIGN_BY_STREAM_INDEX));
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+    data->channel_idx = chn_idx;
+    EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+  }
+  std::map<uint32_t, uint32_t> assignment = pipeline->GetStreamConveyors("module");
+  EXPECT_EQ(assignment.size(), static_cast<size_t>(chn_cnt));
+  for (auto& it : assignment) EXPECT_LT(it.second, 4u);
+  EXPECT_TRUE(pipeline->GetStreamConveyors("source").empty());
+  EXPECT_TRUE(pipeline->GetStreamConveyors("unknown").empty());
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    auto data = CNFrameInfo::Create(std::to_string(chn_idx), true);
+    data->channel_idx = chn_idx;
+    EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+  }
+  EXPECT_EQ(MsgObserver::STOP_BY_EOS, msg_observer.WaitForStop());
+  // the streams are released by their eos
+  EXPECT_TRUE(pipeline->GetStreamConveyors("module").empty());
+}
+
+/*
+  A module taking some time to process each frame, counts the processed frames.
+ */
+class CountingModule : public Module {
+ public:
+  CountingModule(const std::string& name, int process_ms) : Module(name), process_ms_(process_ms) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    if (process_ms_) std::this_thread::sleep_for(std::chrono::milliseconds(process_ms_));
+    ++processed_;
+    return 0;
+  }
+  uint64_t GetProcessedNumber() const { return processed_.load(); }
+
+ private:
+  int process_ms_;
+  std::atomic<uint64_t> processed_{0};
+};  // class CountingModule
+
+TEST(CorePipeline, MaxFrameAge) {
+  const int chn_cnt = 2, frame_cnt = 50;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  EXPECT_EQ(pipeline->GetMaxFrameAge(), 0u);
+  pipeline->SetMaxFrameAge(20);
+  EXPECT_EQ(pipeline->GetMaxFrameAge(), 20u);
+  auto source = std::make_shared<TestModule>("source");
+  auto slow = std::make_shared<CountingModule>("slow", 2);
+  auto sink = std::make_shared<CountingModule>("sink", 0);
+  EXPECT_TRUE(pipeline->AddModule(source));
+  EXPECT_TRUE(pipeline->AddModule(slow));
+  EXPECT_TRUE(pipeline->AddModule(sink));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(source, 0));
+  // all frames fit in the queue, so that the source never blocks and the frames wait there
+  EXPECT_TRUE(pipeline->SetModuleAttribute(slow, 1, 128));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(sink, 1, 128));
+  EXPECT_TRUE(pipeline->SetModuleFusion(sink, false));
+  EXPECT_NE(pipeline->LinkModules(source, slow), "");
+  EXPECT_NE(pipeline->LinkModules(slow, sink), "");
+  MsgObserver msg_observer(chn_cnt, pipeline);
+  pipeline->SetStreamMsgObserver(reinterpret_cast<StreamMsgObserver*>(&msg_observer));
+
+  EXPECT_TRUE(pipeline->Start());
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+      auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+      data->channel_idx = chn_idx;
+      data->frame.frame_id = frame_idx;
+      EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+    }
+  }
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    auto data = CNFrameInfo::Create(std::to_string(chn_idx), true);
+    data->channel_idx = chn_idx;
+    EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+  }
+  // the eos frames are never dropped
+  EXPECT_EQ(MsgObserver::STOP_BY_EOS, msg_observer.WaitForStop());
+
+  // processing all frames takes 200 ms, the frames waiting for more than 20 ms are dropped
+  uint64_t slow_stale = pipeline->GetStaleFrameCount("slow");
+  EXPECT_GT(slow_stale, 0u);
+  EXPECT_EQ(slow->GetProcessedNumber() + slow_stale, static_cast<uint64_t>(chn_cnt * frame_cnt));
+  EXPECT_EQ(pipeline->GetStaleFrameCount("slow", "0") + pipeline->GetStaleFrameCount("slow", "1"), slow_stale);
+  EXPECT_EQ(pipeline->GetStaleFrameCount("slow", "2"), 0u);
+  // the dropped frames are not transmitted
+  EXPECT_EQ(sink->GetProcessedNumber() + pipeline->GetStaleFrameCount("sink"), slow->GetProcessedNumber());
+  EXPECT_EQ(pipeline->GetStaleFrameCount("source"), 0u);
+}
+
+/*
+  A stateless module taking a random time to process each frame, records the threads processing each stream.
+ */
+class RandomDelayModule : public Module {
+ public:
+  explicit RandomDelayModule(const std::string& name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    int delay_us;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      thread_ids_[data->channel_idx].insert(std::this_thread::get_id());
+      delay_us = std::uniform_int_distribution<int>(0, 3000)(rng_);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    return 0;
+  }
+  size_t GetThreadNumber(uint32_t chn_idx) { return GetThreadIds(chn_idx).size(); }
+  std::set<std::thread::id> GetThreadIds(uint32_t chn_idx) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return thread_ids_[chn_idx];
+  }
+
+ private:
+  std::mutex mutex_;
+  std::mt19937 rng_{std::random_device{}()};
+  std::map<uint32_t, std::set<std::thread::id>> thread_ids_;
+};  // class RandomDelayModule
+
+/*
+  A module transmitting data by itself, records the frames of each stream in the order they arrive.
+ */
+class OrderRecordModule : public ModuleEx {
+ public:
+  explicit OrderRecordModule(const std::string& name) : ModuleEx(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      frame_ids_[data->channel_idx].push_back(data->frame.flags & CN_FRAME_FLAG_EOS ? -1 : data->frame.frame_id);
+    }
+    TransmitData(data);
+    return 1;
+  }
+  std::vector<int64_t> GetFrameIds(uint32_t chn_idx) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return frame_ids_[chn_idx];
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<uint32_t, std::vector<int64_t>> frame_ids_;
+};  // class OrderRecordModule
+
+TEST(CorePipeline, FrameParallel) {
+  const int chn_cnt = 3, frame_cnt = 100;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  auto source = std::make_shared<TestModule>("source");
+  auto worker = std::make_shared<RandomDelayModule>("worker");
+  auto sink = std::make_shared<OrderRecordModule>("sink");
+  EXPECT_TRUE(pipeline->AddModule(source));
+  EXPECT_TRUE(pipeline->AddModule(worker));
+  EXPECT_TRUE(pipeline->AddModule(sink));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(source, 0));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(worker, 4));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(sink, 1));
+  EXPECT_TRUE(pipeline->SetModuleFrameParallel(worker, true));
+  // the order of the frames transmitted by the module itself can not be restored
+  EXPECT_FALSE(pipeline->SetModuleFrameParallel(sink, true));
+  EXPECT_FALSE(pipeline->SetModuleFrameParallel(std::make_shared<TestModule>("not_added"), true));
+  EXPECT_NE(pipeline->LinkModules(source, worker), "");
+  EXPECT_NE(pipeline->LinkModules(worker, sink), "");
+  MsgObserver msg_observer(chn_cnt, pipeline);
+  pipeline->SetStreamMsgObserver(reinterpret_cast<StreamMsgObserver*>(&msg_observer));
+
+  EXPECT_TRUE(pipeline->Start());
+  EXPECT_FALSE(pipeline->SetModuleFrameParallel(worker, false));
+  std::vector<std::thread> threads;
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    threads.emplace_back([&, chn_idx]() {
+      for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+        auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+        data->channel_idx = chn_idx;
+        data->frame.frame_id = frame_idx;
+        EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+      }
+      auto data = CNFrameInfo::Create(std::to_string(chn_idx), true);
+      data->channel_idx = chn_idx;
+      EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+    });
+  }
+  for (auto& it : threads) it.join();
+  EXPECT_EQ(MsgObserver::STOP_BY_EOS, msg_observer.WaitForStop());
+
+  std::vector<int64_t> expected;
+  for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) expected.push_back(frame_idx);
+  // the eos arrives after all frames of its stream
+  expected.push_back(-1);
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    EXPECT_EQ(sink->GetFrameIds(chn_idx), expected) << "channel " << chn_idx;
+    // the frames of a stream are spread over the threads of the module
+    EXPECT_GT(worker->GetThreadNumber(chn_idx), 1u);
+  }
+}
+
+TEST(CorePipeline, FrameParallelSpread) {
+  const int chn_cnt = 4, frame_cnt = 8, parallelism = 4;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  auto source = std::make_shared<TestModule>("source");
+  auto worker = std::make_shared<RandomDelayModule>("worker");
+  auto sink = std::make_shared<OrderRecordModule>("sink");
+  EXPECT_TRUE(pipeline->AddModule(source));
+  EXPECT_TRUE(pipeline->AddModule(worker));
+  EXPECT_TRUE(pipeline->AddModule(sink));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(source, 0));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(worker, parallelism));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(sink, 1));
+  EXPECT_TRUE(pipeline->SetModuleFrameParallel(worker, true));
+  EXPECT_NE(pipeline->LinkModules(source, worker), "");
+  EXPECT_NE(pipeline->LinkModules(worker, sink), "");
+
+  EXPECT_TRUE(pipeline->Start());
+  // low-rate streams, each frame is processed before the next one is sent, so no stream ever has data pending
+  for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+    for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+      auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+      data->channel_idx = chn_idx;
+      data->frame.frame_id = frame_idx;
+      EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+      auto start = std::chrono::steady_clock::now();
+      while (sink->GetFrameIds(chn_idx).size() < static_cast<size_t>(frame_idx + 1) &&
+             std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+    // the first frames of the streams are processed by different threads
+    if (0 == frame_idx) {
+      std::set<std::thread::id> thread_ids;
+      for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+        for (auto& it : worker->GetThreadIds(chn_idx)) thread_ids.insert(it);
+      }
+      EXPECT_EQ(thread_ids.size(), static_cast<size_t>(chn_cnt));
+    }
+  }
+  pipeline->Stop();
+
+  // the frames of every stream still go round all threads
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    EXPECT_EQ(sink->GetFrameIds(chn_idx).size(), static_cast<size_t>(frame_cnt));
+    EXPECT_EQ(worker->GetThreadNumber(chn_idx), static_cast<size_t>(parallelism)) << "channel " << chn_idx;
+  }
+}
+
+/*
+  Compares the executors on a chain of 10 modules with parallelism 16, which uses 160 threads in
+  thread-per-conveyor mode, the modules are not fused. Each module does a little work, the last one records the
+  latency of each frame.
+ */
+class BenchProcessor : public Module {
+ public:
+  BenchProcessor(const std::string& name, bool is_sink) : Module(name), is_sink_(is_sink) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 2000; ++i) sum += i;
+    if (is_sink_) {
+      int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+      std::lock_guard<std::mutex> lk(mutex_);
+      latencies_.push_back(now - data->frame.timestamp);
+    }
+    return 0;
+  }
+  std::vector<int64_t> GetLatencies() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return latencies_;
+  }
+
+ private:
+  bool is_sink_;
+  std::mutex mutex_;
+  std::vector<int64_t> latencies_;
+};  // class BenchProcessor
+
+static void RunExecutorBench(PipelineExecutorType executor_type, const std::string& executor_name) {
+  const int chn_cnt = 16, frame_cnt = 200, module_cnt = 10, parallelism = 16;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  EXPECT_TRUE(pipeline->SetExecutorType(executor_type));
+  auto source = std::make_shared<TestModule>("bench_source");
+  std::vector<std::shared_ptr<BenchProcessor>> processors;
+  EXPECT_TRUE(pipeline->AddModule(source));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(source, 0));
+  std::shared_ptr<Module> up_node = source;
+  for (int i = 0; i < module_cnt; ++i) {
+    processors.push_back(std::make_shared<BenchProcessor>("bench_" + std::to_string(i), i == module_cnt - 1));
+    EXPECT_TRUE(pipeline->AddModule(processors.back()));
+    EXPECT_TRUE(pipeline->SetModuleAttribute(processors.back(), parallelism));
+    EXPECT_TRUE(pipeline->SetModuleFusion(processors.back(), false));
+    EXPECT_NE(pipeline->LinkModules(up_node, processors.back()), "");
+    up_node = processors.back();
+  }
+  MsgObserver msg_observer(chn_cnt, pipeline);
+  pipeline->SetStreamMsgObserver(reinterpret_cast<StreamMsgObserver*>(&msg_observer));
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(pipeline->Start());
+  std::vector<std::thread> threads;
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    threads.push_back(std::thread([&, chn_idx]() {
+      for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+        auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+        data->channel_idx = chn_idx;
+        data->frame.frame_id = frame_idx;
+        data->frame.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (!pipeline->ProvideData(source.get(), data)) return;
+      }
+      auto data = CNFrameInfo::Create(std::to_string(chn_idx), true);
+      data->channel_idx = chn_idx;
+      pipeline->ProvideData(source.get(), data);
+    }));
+  }
+  EXPECT_EQ(MsgObserver::STOP_BY_EOS, msg_observer.WaitForStop());
+  std::chrono::duration<double> dura = std::chrono::steady_clock::now() - start;
+  for (auto& it : threads) it.join();
+
+  std::vector<int64_t> latencies = processors.back()->GetLatencies();
+  ASSERT_EQ(latencies.size(), static_cast<size_t>(chn_cnt * frame_cnt));
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << executor_name << ": " << static_cast<int>(chn_cnt * frame_cnt / dura.count()) << " fps, latency p50 "
+            << latencies[latencies.size() / 2] / 1000.0 << " ms, p99 " << latencies[latencies.size() * 99 / 100] / 1000.0
+            << " ms" << std::endl;
+}
+
+TEST(CorePipeline, ExecutorBenchmark) {
+  RunExecutorBench(EXECUTOR_THREAD_PER_CONVEYOR, "thread-per-conveyor");
+  RunExecutorBench(EXECUTOR_WORK_STEALING, "work-stealing");
+}
+
+/*
+  Measures the cost of a hop between modules on a chain of 10 modules doing no work. The first module stamps each
+  frame, the last one records the time the frame took to go through the chain.
+  When the modules are fused, the frames go through the chain in one thread. Otherwise, each hop goes through the
+  input queue of the next module and wakes up its thread, only one frame is in the chain at a time, so that the
+  frames do not wait behind each other in the queues.
+ */
+class HopStampModule : public Module {
+ public:
+  HopStampModule(const std::string& name, bool is_first, bool is_last)
+      : Module(name), is_first_(is_first), is_last_(is_last) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    if (data->frame.flags & CN_FRAME_FLAG_EOS) return 0;
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (is_first_) data->frame.timestamp = now;
+    if (is_last_) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      durations_.push_back(now - data->frame.timestamp);
+    }
+    return 0;
+  }
+  std::vector<int64_t> GetDurations() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return durations_;
+  }
+  size_t GetDurationNumber() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return durations_.size();
+  }
+
+ private:
+  bool is_first_, is_last_;
+  std::mutex mutex_;
+  std::vector<int64_t> durations_;
+};  // class HopStampModule
+
+static void RunHopBench(bool fused, const std::string& bench_name) {
+  const int chn_cnt = fused ? 4 : 1, frame_cnt = fused ? 5000 : 2000, module_cnt = 10;
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  auto source = std::make_shared<TestModule>("hop_source");
+  std::vector<std::shared_ptr<HopStampModule>> modules;
+  EXPECT_TRUE(pipeline->AddModule(source));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(source, 0));
+  std::shared_ptr<Module> up_node = source;
+  for (int i = 0; i < module_cnt; ++i) {
+    modules.push_back(std::make_shared<HopStampModule>("hop_" + std::to_string(i), 0 == i, module_cnt - 1 == i));
+    EXPECT_TRUE(pipeline->AddModule(modules.back()));
+    EXPECT_TRUE(pipeline->SetModuleAttribute(modules.back(), 1, 1024));
+    EXPECT_TRUE(pipeline->SetModuleFusion(modules.back(), fused));
+    EXPECT_NE(pipeline->LinkModules(up_node, modules.back()), "");
+    up_node = modules.back();
+  }
+  MsgObserver msg_observer(chn_cnt, pipeline);
+  pipeline->SetStreamMsgObserver(reinterpret_cast<StreamMsgObserver*>(&msg_observer));
+
+  EXPECT_TRUE(pipeline->Start());
+  for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+    for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+      auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+      data->channel_idx = chn_idx;
+      data->frame.frame_id = frame_idx;
+      EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+    }
+    if (!fused) {
+      const size_t arrived = static_cast<size_t>((frame_idx + 1) * chn_cnt);
+      while (modules.back()->GetDurationNumber() < arrived) std::this_thread::yield();
+    }
+  }
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    auto data = CNFrameInfo::Create(std::to_string(chn_idx), true);
+    data->channel_idx = chn_idx;
+    EXPECT_TRUE(pipeline->ProvideData(source.get(), data));
+  }
+  EXPECT_EQ(MsgObserver::STOP_BY_EOS, msg_observer.WaitForStop());
+
+  std::vector<int64_t> durations = modules.back()->GetDurations();
+  ASSERT_EQ(durations.size(), static_cast<size_t>(chn_cnt * frame_cnt));
+  std::sort(durations.begin(), durations.end());
+  const int hop_cnt = module_cnt - 1;
+  std::cout << bench_name << " module hop: p50 " << durations[durations.size() / 2] / hop_cnt << " ns, p99 "
+            << durations[durations.size() * 99 / 100] / hop_cnt << " ns" << std::endl;
+}
+
+TEST(CorePipeline, TransmitHopBenchmark) {
+  RunHopBench(true, "fused");
+  RunHopBench(false, "unfused");
+}
+
 }  // namespace cnstream
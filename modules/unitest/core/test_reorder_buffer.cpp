@@ -0,0 +1,117 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "reorder_buffer.hpp"
+
+namespace cnstream {
+
+static CNFrameInfoPtr CreateFrame(uint32_t chn_idx, int64_t frame_id) {
+  auto data = CNFrameInfo::Create(std::to_string(chn_idx));
+  data->channel_idx = chn_idx;
+  data->frame.frame_id = frame_id;
+  return data;
+}
+
+TEST(CoreReorderBuffer, EmitInOrder) {
+  ReorderBuffer reorder_buffer;
+  std::vector<CNFrameInfoPtr> frames;
+  for (int i = 0; i < 4; ++i) {
+    frames.push_back(CreateFrame(0, i));
+    EXPECT_EQ(reorder_buffer.Push(frames.back()), static_cast<uint64_t>(i));
+  }
+  auto other = CreateFrame(1, 0);
+  EXPECT_EQ(reorder_buffer.Push(other), 0u);
+  EXPECT_EQ(reorder_buffer.GetPendingNumber(), 5u);
+
+  std::string order;
+  ReorderBuffer::Emitter emitter = [&](const CNFrameInfoPtr& data) {
+    order += std::to_string(data->channel_idx) + ":" + std::to_string(data->frame.frame_id) + ",";
+    return true;
+  };
+  EXPECT_TRUE(reorder_buffer.Done(frames[2], true, emitter));
+  EXPECT_TRUE(reorder_buffer.Done(frames[1], true, emitter));
+  // the streams are ordered separately
+  EXPECT_TRUE(reorder_buffer.Done(other, true, emitter));
+  EXPECT_EQ(order, "1:0,");
+  EXPECT_TRUE(reorder_buffer.Done(frames[0], true, emitter));
+  EXPECT_EQ(order, "1:0,0:0,0:1,0:2,");
+  // the dropped data are skipped
+  EXPECT_TRUE(reorder_buffer.Done(frames[3], false, emitter));
+  EXPECT_EQ(order, "1:0,0:0,0:1,0:2,");
+  EXPECT_EQ(reorder_buffer.GetPendingNumber(), 0u);
+  // the sequence number goes on after the stream has no data pending
+  EXPECT_EQ(reorder_buffer.Push(CreateFrame(0, 4)), 4u);
+  // the data not registered are emitted at once
+  EXPECT_TRUE(reorder_buffer.Done(CreateFrame(2, 0), true, emitter));
+  EXPECT_EQ(order, "1:0,0:0,0:1,0:2,2:0,");
+  EXPECT_FALSE(reorder_buffer.Done(CreateFrame(2, 1), true, [](const CNFrameInfoPtr&) { return false; }));
+}
+
+TEST(CoreReorderBuffer, ConcurrentDone) {
+  const int chn_cnt = 4, frame_cnt = 500, thread_cnt = 4;
+  ReorderBuffer reorder_buffer;
+  std::vector<std::vector<CNFrameInfoPtr>> queues(thread_cnt);
+  for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+    for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+      auto data = CreateFrame(chn_idx, frame_idx);
+      queues[reorder_buffer.Push(data) % thread_cnt].push_back(data);
+    }
+  }
+  std::mutex mutex;
+  std::vector<std::vector<int64_t>> emitted(chn_cnt);
+  ReorderBuffer::Emitter emitter = [&](const CNFrameInfoPtr& data) {
+    std::lock_guard<std::mutex> lk(mutex);
+    emitted[data->channel_idx].push_back(data->frame.frame_id);
+    return true;
+  };
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < thread_cnt; ++thread_idx) {
+    threads.emplace_back([&, thread_idx] {
+      std::mt19937 rng(thread_idx);
+      std::uniform_int_distribution<int> delay_us(0, 200);
+      for (auto& data : queues[thread_idx]) {
+        // random processing time, every tenth frame is dropped
+        std::this_thread::sleep_for(std::chrono::microseconds(delay_us(rng)));
+        EXPECT_TRUE(reorder_buffer.Done(data, data->frame.frame_id % 10 != 9, emitter));
+      }
+    });
+  }
+  for (auto& it : threads) it.join();
+  EXPECT_EQ(reorder_buffer.GetPendingNumber(), 0u);
+  for (int chn_idx = 0; chn_idx < chn_cnt; ++chn_idx) {
+    std::vector<int64_t> expected;
+    for (int frame_idx = 0; frame_idx < frame_cnt; ++frame_idx) {
+      if (frame_idx % 10 != 9) expected.push_back(frame_idx);
+    }
+    EXPECT_EQ(emitted[chn_idx], expected) << "channel " << chn_idx;
+  }
+}
+
+}  // namespace cnstream
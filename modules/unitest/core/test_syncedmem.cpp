@@ -140,6 +140,14 @@ TEST(CoreSyncedMem, SyncedMem) {
     EXPECT_EQ(memory->GetHead(), cnstream::CNSyncedMemory::HEAD_AT_MLU);
     EXPECT_EQ(memory->own_mlu_data_, false);
   });
+  funcs.push_back([&] {
+    size_t size = memory_random_number_generator(random_engine);
+    memory->Reset(size);
+    EXPECT_EQ(memory->GetSize(), size);
+    EXPECT_EQ(cnstream::CNSyncedMemory::UNINITIALIZED, memory->GetHead());
+    EXPECT_EQ(memory->own_cpu_data_, false);
+    EXPECT_EQ(memory->own_mlu_data_, false);
+  });
 
   auto __start_test_time = std::chrono::steady_clock::now();
   auto __last_time = __start_test_time;
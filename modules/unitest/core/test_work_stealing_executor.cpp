@@ -0,0 +1,78 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "work_stealing_executor.hpp"
+
+namespace cnstream {
+
+TEST(CoreWorkStealingExecutor, ThreadNum) {
+  WorkStealingExecutor executor(3);
+  EXPECT_EQ(executor.GetThreadNum(), 3u);
+  WorkStealingExecutor default_executor;
+  EXPECT_GT(default_executor.GetThreadNum(), 0u);
+}
+
+TEST(CoreWorkStealingExecutor, SubmitTasks) {
+  const int task_num = 1000, sub_task_num = 10;
+  WorkStealingExecutor executor(4);
+  EXPECT_FALSE(executor.InWorkerThread());
+  executor.Start();
+  std::atomic<int> count{0};
+  std::atomic<int> in_worker{0};
+  for (int i = 0; i < task_num; ++i) {
+    executor.Submit([&]() {
+      if (executor.InWorkerThread()) in_worker++;
+      // tasks submitted by workers go to their own queues
+      for (int j = 0; j < sub_task_num; ++j) {
+        executor.Submit([&]() { count++; });
+      }
+      count++;
+    });
+  }
+  while (count.load() < task_num * (sub_task_num + 1)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  executor.Stop();
+  EXPECT_EQ(count.load(), task_num * (sub_task_num + 1));
+  EXPECT_EQ(in_worker.load(), task_num);
+}
+
+TEST(CoreWorkStealingExecutor, StopAfterTasksDone) {
+  WorkStealingExecutor executor(2);
+  executor.Start();
+  std::atomic<int> count{0};
+  for (int i = 0; i < 100; ++i) {
+    executor.Submit([&]() {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      count++;
+    });
+  }
+  executor.Stop();
+  EXPECT_EQ(count.load(), 100);
+}
+
+}  // namespace cnstream
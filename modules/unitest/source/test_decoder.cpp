@@ -21,10 +21,15 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "cnrt.h"
 #include "cnstream_source.hpp"
@@ -158,6 +163,95 @@ class PrepareEnvRaw {
   RawPacket *raw_pkt;
 };  // PrepareEnvRaw
 
+class FrameCollector : public Module {
+ public:
+  explicit FrameCollector(const std::string &name) : Module(name) {}
+  bool Open(ModuleParamSet param_set) override { return true; }
+  void Close() override {}
+  int Process(std::shared_ptr<CNFrameInfo> data) override {
+    std::lock_guard<std::mutex> lk(mutex_);
+    frame_ids_.push_back(data->frame.frame_id);
+    timestamps_.push_back(data->frame.timestamp);
+    // e.g. "analytics:640x360,", the renditions not in NV21 host memory are marked invalid
+    std::string renditions;
+    for (auto &it : data->renditions) {
+      const CNDataFrame &rendition = *it.second;
+      bool valid = rendition.fmt == CN_PIXEL_FORMAT_YUV420_NV21 && rendition.frame_id == data->frame.frame_id &&
+                   rendition.stride[0] >= rendition.width && nullptr != rendition.data[0]->GetCpuData();
+      renditions += valid ? it.first + ":" + std::to_string(rendition.width) + "x" +
+                                std::to_string(rendition.height) + ","
+                          : "invalid,";
+    }
+    renditions_.push_back(renditions);
+    return 0;
+  }
+  std::vector<int64_t> GetFrameIds() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return frame_ids_;
+  }
+  std::vector<int64_t> GetTimestamps() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return timestamps_;
+  }
+  std::vector<std::string> GetRenditions() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return renditions_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<int64_t> frame_ids_;
+  std::vector<int64_t> timestamps_;
+  std::vector<std::string> renditions_;
+};  // class FrameCollector
+
+class EosObserver : public StreamMsgObserver {
+ public:
+  void Update(const StreamMsg &smsg) override {
+    if (smsg.type == StreamMsgType::EOS_MSG || smsg.type == StreamMsgType::ERROR_MSG) {
+      std::call_once(flag_, [&] { wakener_.set_value(smsg.type); });
+    }
+  }
+  StreamMsgType WaitForStop() { return wakener_.get_future().get(); }
+
+ private:
+  std::once_flag flag_;
+  std::promise<StreamMsgType> wakener_;
+};  // class EosObserver
+
+// decodes the whole file by a pipeline, returns the timestamps of the frames in output order
+std::vector<int64_t> DecodeByCpu(const ModuleParamSet &decode_params, std::vector<std::string> *renditions = nullptr) {
+  auto pipeline = std::make_shared<Pipeline>("pipeline");
+  auto src = std::make_shared<DataSource>(gname);
+  auto collector = std::make_shared<FrameCollector>("collector");
+  CNModuleConfig config;
+  config.name = gname;
+  config.parameters["source_type"] = "ffmpeg";
+  config.parameters["output_type"] = "cpu";
+  config.parameters["decoder_type"] = "cpu";
+  for (auto &it : decode_params) config.parameters[it.first] = it.second;
+  pipeline->AddModuleConfig(config);
+  EXPECT_TRUE(pipeline->AddModule(src));
+  EXPECT_TRUE(pipeline->AddModule(collector));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(src, 0));
+  EXPECT_TRUE(pipeline->SetModuleAttribute(collector, 1));
+  EXPECT_NE(pipeline->LinkModules(src, collector), "");
+  EosObserver observer;
+  pipeline->SetStreamMsgObserver(&observer);
+  EXPECT_TRUE(pipeline->Start());
+
+  EXPECT_EQ(src->AddVideoSource("0", GetExePath() + gmp4_path, 0, false), 0);
+  EXPECT_EQ(observer.WaitForStop(), StreamMsgType::EOS_MSG);
+  pipeline->Stop();
+
+  std::vector<int64_t> frame_ids = collector->GetFrameIds();
+  for (size_t i = 0; i < frame_ids.size(); ++i) {
+    EXPECT_EQ(frame_ids[i], static_cast<int64_t>(i));
+  }
+  if (renditions) *renditions = collector->GetRenditions();
+  return collector->GetTimestamps();
+}
+
 // Mlu FFmpeg Decoder
 TEST(SourceMluFFmpegDecoder, CreateDestroy) {
   PrepareEnv env(0);
@@ -330,6 +424,65 @@ TEST(SourceCpuFFmpegDecoder, ProcessEmptyFrame) {
   env.ffmpeg_cpu_decoder->Destroy();
 }
 
+TEST(SourceCpuFFmpegDecoder, MultiThreadDecode) {
+  std::vector<int64_t> expected = DecodeByCpu({{"decode_threads", "1"}});
+  ASSERT_FALSE(expected.empty());
+  for (size_t i = 1; i < expected.size(); ++i) {
+    EXPECT_LT(expected[i - 1], expected[i]);
+  }
+  // frame threading delays the output, but all the frames come out in the same order after draining
+  EXPECT_EQ(DecodeByCpu({{"decode_threads", "4"}, {"decode_thread_type", "frame"}}), expected);
+  EXPECT_EQ(DecodeByCpu({{"decode_threads", "4"}, {"decode_thread_type", "slice"}}), expected);
+  EXPECT_EQ(DecodeByCpu({{"decode_threads", "0"}}), expected);
+}
+
+TEST(SourceCpuFFmpegDecoder, DecodeSkip) {
+  std::vector<int64_t> all = DecodeByCpu({});
+  ASSERT_FALSE(all.empty());
+  EXPECT_EQ(DecodeByCpu({{"decode_skip", "none"}}), all);
+
+  // the decoded frames are a subset of all the frames, in the same order
+  for (std::string skip : {"nonref", "nonkey"}) {
+    std::vector<int64_t> decoded = DecodeByCpu({{"decode_skip", skip}});
+    ASSERT_FALSE(decoded.empty());
+    EXPECT_LE(decoded.size(), all.size());
+    auto iter = all.begin();
+    for (auto ts : decoded) {
+      iter = std::find(iter, all.end(), ts);
+      EXPECT_TRUE(iter != all.end()) << skip << " timestamp " << ts;
+    }
+  }
+  // the test video has a single key frame, it is the first frame
+  std::vector<int64_t> key_frames = DecodeByCpu({{"decode_skip", "nonkey"}});
+  ASSERT_EQ(key_frames.size(), 1u);
+  EXPECT_EQ(key_frames.front(), all.front());
+
+  // interval applies to the decoded frames
+  std::vector<int64_t> ref_frames = DecodeByCpu({{"decode_skip", "nonref"}});
+  std::vector<int64_t> sampled = DecodeByCpu({{"decode_skip", "nonref"}, {"interval", "2"}});
+  ASSERT_EQ(sampled.size(), (ref_frames.size() + 1) / 2);
+  for (size_t i = 0; i < sampled.size(); ++i) {
+    EXPECT_EQ(sampled[i], ref_frames[i * 2]);
+  }
+}
+
+TEST(SourceCpuFFmpegDecoder, Renditions) {
+  std::vector<std::string> renditions;
+  std::vector<int64_t> expected = DecodeByCpu({}, &renditions);
+  ASSERT_FALSE(expected.empty());
+  for (auto &it : renditions) EXPECT_TRUE(it.empty());
+
+  // each frame carries all the renditions, the frames are not changed
+  EXPECT_EQ(DecodeByCpu({{"renditions", "preview:64x36,analytics:128x72"}}, &renditions), expected);
+  ASSERT_EQ(renditions.size(), expected.size());
+  for (auto &it : renditions) EXPECT_EQ(it, "analytics:128x72,preview:64x36,");
+
+  // scaled from the referenced decoder buffers as well
+  EXPECT_EQ(DecodeByCpu({{"renditions", "analytics:128x72"}, {"reuse_cpudec_buf", "true"}}, &renditions), expected);
+  ASSERT_EQ(renditions.size(), expected.size());
+  for (auto &it : renditions) EXPECT_EQ(it, "analytics:128x72,");
+}
+
 TEST(SourceCpuFFmpegDecoder, ProcessFrameInvalidContext) {
   PrepareEnv env(1);
 #if LIBAVFORMAT_VERSION_INT >= TEST_FFMPEG_VERSION_3_1
@@ -350,6 +503,82 @@ TEST(SourceCpuFFmpegDecoder, ProcessFrameInvalidContext) {
   CNFrameInfo::Create("0", true);
 }
 
+TEST(SourceCpuFFmpegDecoder, ProcessFrameByRef) {
+  PrepareEnv env(1);
+  ModuleParamSet param;
+  param["source_type"] = "ffmpeg";
+  param["output_type"] = "cpu";
+  param["decoder_type"] = "cpu";
+  param["reuse_cpudec_buf"] = "true";
+  ASSERT_TRUE(env.src->Open(param));
+  env.ffmpeg_handler->Open();
+  env.ffmpeg_handler->Close();
+  ASSERT_TRUE(env.ffmpeg_handler->ReuseCpuDecBuf());
+  env.ffmpeg_cpu_decoder = std::make_shared<FFmpegCpuDecoder>(*env.ffmpeg_handler);
+
+  AVFrame *frame = av_frame_alloc();
+  ASSERT_TRUE(frame != nullptr);
+  frame->format = AV_PIX_FMT_YUV420P;
+  frame->width = 256;
+  frame->height = 256;
+  ASSERT_EQ(av_frame_get_buffer(frame, 32), 0);
+  memset(frame->data[0], 16, frame->linesize[0] * frame->height);
+  memset(frame->data[1], 1, frame->linesize[1] * frame->height / 2);
+  memset(frame->data[2], 2, frame->linesize[2] * frame->height / 2);
+  uint8_t *planes[3] = {frame->data[0], frame->data[1], frame->data[2]};
+
+  auto data = CNFrameInfo::Create("0");
+  EXPECT_TRUE(env.ffmpeg_cpu_decoder->ProcessFrameByRef(frame, data));
+  // the decoder buffer is still referenced by the frame
+  av_frame_free(&frame);
+  EXPECT_TRUE(data->frame.deAllocator_ != nullptr);
+  // the planes are neither copied nor repacked
+  EXPECT_EQ(data->frame.fmt, CN_PIXEL_FORMAT_YUV420P);
+  EXPECT_EQ(data->frame.GetPlanes(), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(data->frame.data[i]->GetCpuData(), planes[i]);
+  }
+  EXPECT_EQ(reinterpret_cast<const uint8_t *>(data->frame.data[0]->GetCpuData())[0], 16);
+  EXPECT_EQ(reinterpret_cast<const uint8_t *>(data->frame.data[1]->GetCpuData())[0], 1);
+  EXPECT_EQ(reinterpret_cast<const uint8_t *>(data->frame.data[2]->GetCpuData())[0], 2);
+
+  // NV12 frames are referenced without any copy
+  frame = av_frame_alloc();
+  frame->format = AV_PIX_FMT_NV12;
+  frame->width = 256;
+  frame->height = 256;
+  ASSERT_EQ(av_frame_get_buffer(frame, 32), 0);
+  data = CNFrameInfo::Create("0");
+  EXPECT_TRUE(env.ffmpeg_cpu_decoder->ProcessFrameByRef(frame, data));
+  EXPECT_EQ(data->frame.fmt, CN_PIXEL_FORMAT_YUV420_NV12);
+  EXPECT_EQ(data->frame.data[0]->GetCpuData(), frame->data[0]);
+  EXPECT_EQ(data->frame.data[1]->GetCpuData(), frame->data[1]);
+  av_frame_free(&frame);
+
+  // luma only
+  frame = av_frame_alloc();
+  frame->format = AV_PIX_FMT_GRAY8;
+  frame->width = 256;
+  frame->height = 256;
+  ASSERT_EQ(av_frame_get_buffer(frame, 32), 0);
+  data = CNFrameInfo::Create("0");
+  EXPECT_TRUE(env.ffmpeg_cpu_decoder->ProcessFrameByRef(frame, data));
+  EXPECT_EQ(data->frame.fmt, CN_PIXEL_FORMAT_GRAY8);
+  EXPECT_EQ(data->frame.GetBytes(), static_cast<size_t>(frame->linesize[0] * 256));
+  av_frame_free(&frame);
+
+  // unsupported pixel format
+  frame = av_frame_alloc();
+  frame->format = AV_PIX_FMT_RGB24;
+  data = CNFrameInfo::Create("0");
+  EXPECT_FALSE(env.ffmpeg_cpu_decoder->ProcessFrameByRef(frame, data));
+  av_frame_free(&frame);
+  data.reset();
+
+  // create eos frame for clear stream idx
+  CNFrameInfo::Create("0", true);
+}
+
 // Mlu Raw Decoder
 TEST(SourceMluRawDecoder, CreateDestroy) {
   PrepareEnvRaw env;
@@ -394,6 +623,27 @@ TEST(SourceMluRawDecoder, Process) {
   env.raw_mlu_decoder->Destroy();
 }
 
+TEST(SourceMluRawDecoder, ProcessFromKeyFrame) {
+  PrepareEnvRaw env;
+
+  EXPECT_TRUE(env.raw_mlu_decoder->Create(&env.decoder_ctx));
+  EXPECT_FALSE(env.raw_mlu_decoder->IsWaitingForKey());
+  env.raw_mlu_decoder->Resync();
+  // the packets before the key frame are dropped
+  env.raw_pkt->flags = 0;
+  EXPECT_TRUE(env.raw_mlu_decoder->Process(env.raw_pkt, false));
+  EXPECT_TRUE(env.raw_mlu_decoder->IsWaitingForKey());
+  env.raw_pkt->flags = RAW_PACKET_FLAG_KEY;
+  EXPECT_TRUE(env.raw_mlu_decoder->Process(env.raw_pkt, false));
+  EXPECT_FALSE(env.raw_mlu_decoder->IsWaitingForKey());
+  env.raw_pkt->flags = 0;
+  EXPECT_TRUE(env.raw_mlu_decoder->Process(env.raw_pkt, false));
+  EXPECT_FALSE(env.raw_mlu_decoder->IsWaitingForKey());
+  // eos
+  EXPECT_TRUE(env.raw_mlu_decoder->Process(env.raw_pkt, true));
+  env.raw_mlu_decoder->Destroy();
+}
+
 TEST(SourceMluRawDecoder, ProcessEmptyFrame) {
   PrepareEnvRaw env;
 
@@ -21,16 +21,20 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "cnrt.h"
 #include "cnstream_source.hpp"
 #include "easyinfer/mlu_context.h"
 #include "fr_controller.hpp"
 #include "test_base.hpp"
+#include "timer_wheel.hpp"
 
 namespace cnstream {
 
@@ -85,4 +89,72 @@ TEST(SourceFrController, Control) {
   }
 }
 
+TEST(SourcePtsController, GetDueTime) {
+  using std::chrono::milliseconds;
+  auto now = std::chrono::steady_clock::now();
+  PtsController pts_controller;
+  EXPECT_EQ(pts_controller.GetSpeed(), 1.0);
+  // the first data is sent at once
+  EXPECT_TRUE(pts_controller.GetDueTime(1000000, now) == now);
+  EXPECT_TRUE(pts_controller.GetDueTime(1040000, now) == now + milliseconds(40));
+  EXPECT_TRUE(pts_controller.GetDueTime(1080000, now) == now + milliseconds(80));
+  // timestamps going backwards (e.g. looped) keep the pace of the data before
+  EXPECT_TRUE(pts_controller.GetDueTime(0, now) == now + milliseconds(80));
+  EXPECT_TRUE(pts_controller.GetDueTime(40000, now) == now + milliseconds(120));
+  // timestamps jumping forward too far restart the timeline as well
+  EXPECT_TRUE(pts_controller.GetDueTime(100000000, now) == now + milliseconds(120));
+  // falling far behind restarts the timeline from now
+  auto later = now + std::chrono::seconds(2);
+  EXPECT_TRUE(pts_controller.GetDueTime(100040000, later) == later);
+  EXPECT_TRUE(pts_controller.GetDueTime(100080000, later) == later + milliseconds(40));
+
+  pts_controller.Reset();
+  EXPECT_TRUE(pts_controller.GetDueTime(0, now) == now);
+}
+
+TEST(SourcePtsController, Speed) {
+  using std::chrono::milliseconds;
+  auto now = std::chrono::steady_clock::now();
+  PtsController fast(2.0);
+  EXPECT_EQ(fast.GetSpeed(), 2.0);
+  EXPECT_TRUE(fast.GetDueTime(0, now) == now);
+  EXPECT_TRUE(fast.GetDueTime(40000, now) == now + milliseconds(20));
+  PtsController slow(0.5);
+  EXPECT_TRUE(slow.GetDueTime(0, now) == now);
+  EXPECT_TRUE(slow.GetDueTime(40000, now) == now + milliseconds(80));
+}
+
+TEST(SourceTimerWheel, Schedule) {
+  TimerWheel timer_wheel(std::chrono::milliseconds(1), 16);
+  std::mutex mutex;
+  std::vector<int> order;
+  std::atomic<int> early(0);
+  auto start = std::chrono::steady_clock::now();
+  // due times spread over more than one round of the wheel, and one already passed
+  std::vector<int> delays_ms = {30, 5, 0, 20, 45, 10};
+  for (int delay_ms : delays_ms) {
+    auto due = start + std::chrono::milliseconds(delay_ms);
+    timer_wheel.Schedule(due, [&, delay_ms, due] {
+      if (std::chrono::steady_clock::now() < due) early++;
+      std::lock_guard<std::mutex> lk(mutex);
+      order.push_back(delay_ms);
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(timer_wheel.GetPendingNumber(), 0u);
+  EXPECT_EQ(early.load(), 0);
+  std::lock_guard<std::mutex> lk(mutex);
+  EXPECT_EQ(order, std::vector<int>({0, 5, 10, 20, 30, 45}));
+}
+
+TEST(SourceTimerWheel, DropPending) {
+  std::atomic<int> count(0);
+  {
+    TimerWheel timer_wheel;
+    timer_wheel.Schedule(std::chrono::steady_clock::now() + std::chrono::seconds(10), [&] { count++; });
+    EXPECT_EQ(timer_wheel.GetPendingNumber(), 1u);
+  }
+  EXPECT_EQ(count.load(), 0);
+}
+
 }  // namespace cnstream
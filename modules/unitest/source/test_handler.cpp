@@ -20,17 +20,25 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "cnstream_source.hpp"
 #include "data_handler_ffmpeg.hpp"
 #include "data_handler_raw.hpp"
 #include "data_source.hpp"
+#include "stream_worker_pool.hpp"
 #include "test_base.hpp"
 
 namespace cnstream {
@@ -81,6 +89,18 @@ TEST(SourceHandler, GetStreamId) {
   EXPECT_EQ(handler_3->GetStreamIndex(), (unsigned int)2);
 }
 
+TEST(SourceHandler, Admission) {
+  DataSource src(gname);
+  EXPECT_EQ(src.SetStreamParallelism(std::to_string(0), 4), 0);
+  auto handler = std::make_shared<DataHandlerTest>(&src, std::to_string(0), 30, false);
+  ASSERT_TRUE(handler->GetAdmission() != nullptr);
+  EXPECT_EQ(handler->GetAdmission()->GetLimit(), 4);
+  // the streams without their own limit use the default one
+  auto handler_2 = std::make_shared<DataHandlerTest>(&src, std::to_string(1), 30, false);
+  ASSERT_TRUE(handler_2->GetAdmission() != nullptr);
+  EXPECT_EQ(handler_2->GetAdmission()->GetLimit(), GetParallelism());
+}
+
 TEST(SourceHandler, OpenClose) {
   DataSource *psrc = nullptr;
   auto handler_wrong = std::make_shared<DataHandlerTest>(psrc, std::to_string(0), 30, false);
@@ -170,6 +190,106 @@ TEST(SourceHandler, Loop) {
   handler->Close();
 }
 
+class StepCountingHandler : public DataHandler {
+ public:
+  StepCountingHandler(DataSource *module, const std::string &stream_id, int framerate, uint32_t steps)
+      : DataHandler(module, stream_id, framerate, false), steps_(steps) {}
+  ~StepCountingHandler() { Close(); }
+  uint32_t GetSteps() const { return processed_.load(); }
+  bool IsCleared() const { return cleared_.load(); }
+  std::set<std::thread::id> GetThreads() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return threads_;
+  }
+
+ private:
+  bool PrepareResources(bool demux_only = false) override { return true; }
+  void ClearResources(bool demux_only = false) override { cleared_.store(true); }
+  bool Process() override {
+    // a stream is never run by two workers at the same time
+    EXPECT_FALSE(in_process_.exchange(true));
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      threads_.insert(std::this_thread::get_id());
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    in_process_.store(false);
+    return ++processed_ < steps_;
+  }
+  uint32_t steps_;
+  std::atomic<uint32_t> processed_{0};
+  std::atomic<bool> cleared_{false};
+  std::atomic<bool> in_process_{false};
+  std::mutex mutex_;
+  std::set<std::thread::id> threads_;
+};
+
+static bool WaitFor(const std::function<bool()> &cond, int timeout_ms) {
+  auto start = std::chrono::steady_clock::now();
+  while (!cond()) {
+    if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(timeout_ms)) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+TEST(SourceHandler, WorkerPool) {
+  DataSource src(gname);
+  ModuleParamSet param;
+  param["source_type"] = "ffmpeg";
+  param["output_type"] = "cpu";
+  param["decoder_type"] = "cpu";
+  ASSERT_TRUE(src.Open(param));
+  EXPECT_TRUE(src.GetWorkerPool() == nullptr);
+  param["worker_num"] = "2";
+  ASSERT_TRUE(src.Open(param));
+  ASSERT_TRUE(src.GetWorkerPool() != nullptr);
+  EXPECT_EQ(src.GetWorkerPool()->GetWorkerNum(), 2);
+
+  // more streams than workers, each stream runs all its steps in order
+  constexpr uint32_t kStreamNum = 8;
+  constexpr uint32_t kSteps = 50;
+  std::vector<std::shared_ptr<StepCountingHandler>> handlers;
+  for (uint32_t i = 0; i < kStreamNum; ++i) {
+    handlers.push_back(std::make_shared<StepCountingHandler>(&src, std::to_string(i), 0, kSteps));
+    ASSERT_TRUE(handlers.back()->Open());
+  }
+  std::set<std::thread::id> threads;
+  for (auto &handler : handlers) {
+    EXPECT_TRUE(WaitFor([&] { return handler->IsCleared(); }, 5000));
+    EXPECT_EQ(handler->GetSteps(), kSteps);
+    auto handler_threads = handler->GetThreads();
+    threads.insert(handler_threads.begin(), handler_threads.end());
+    handler->Close();
+  }
+  EXPECT_LE(threads.size(), 2u);
+  handlers.clear();
+
+  // the streams are paced by the frame rate
+  auto paced = std::make_shared<StepCountingHandler>(&src, "paced", 100, 10);
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(paced->Open());
+  EXPECT_TRUE(WaitFor([&] { return paced->IsCleared(); }, 5000));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(80));
+  EXPECT_EQ(paced->GetSteps(), 10u);
+  paced->Close();
+
+  // closing a stream waiting for its next frame does not wait for the frame
+  auto slow = std::make_shared<StepCountingHandler>(&src, "slow", 1, 1000);
+  ASSERT_TRUE(slow->Open());
+  EXPECT_TRUE(WaitFor([&] { return slow->GetSteps() > 0; }, 5000));
+  start = std::chrono::steady_clock::now();
+  slow->Close();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+  EXPECT_TRUE(slow->IsCleared());
+  EXPECT_EQ(slow->GetSteps(), 1u);
+
+  // worker_num 0 goes back to one thread per stream
+  param["worker_num"] = "0";
+  ASSERT_TRUE(src.Open(param));
+  EXPECT_TRUE(src.GetWorkerPool() == nullptr);
+}
+
 TEST(SourceHandlerFFmpeg, CheckTimeOut) {
   const char *rtmp_path = "rtmp://";
   DataSource src(gname);
@@ -329,6 +449,129 @@ TEST(SourceHandlerFFmpeg, ProcessCpu) {
   ffmpeg_handler->ClearResources();
 }
 
+TEST(SourceHandlerFFmpeg, ReadAhead) {
+  DataSource src(gname);
+  std::string mp4_path = GetExePath() + "../../modules/unitest/source/data/cars_short.mp4";
+  auto ffmpeg_handler = std::make_shared<DataHandlerFFmpeg>(&src, std::to_string(0), mp4_path, 30, false);
+  ModuleParamSet param;
+  param["source_type"] = "ffmpeg";
+  param["output_type"] = "cpu";
+  param["decoder_type"] = "cpu";
+  param["readahead_packets"] = "4";
+
+  EXPECT_TRUE(src.Open(param));
+  EXPECT_TRUE(ffmpeg_handler->Open());
+  ffmpeg_handler->Close();
+  EXPECT_TRUE(ffmpeg_handler->PrepareResources());
+
+  // the reader fills the queue up to the bound, and waits for room as no packet is decoded yet
+  ReadAheadStat stat;
+  EXPECT_TRUE(WaitFor(
+      [&] { return ffmpeg_handler->GetReadAheadStat(&stat) && stat.packets == 4 && stat.reader_waits > 0; }, 5000));
+  EXPECT_GT(stat.bytes, 0u);
+  // cars.mp4 has 11 frames
+  for (uint32_t i = 0; i < 11; i++) {
+    EXPECT_TRUE(ffmpeg_handler->Process()) << i;
+  }
+  // loop is set to false, send eos and return false
+  EXPECT_FALSE(ffmpeg_handler->Process());
+  EXPECT_TRUE(ffmpeg_handler->GetReadAheadStat(&stat));
+  EXPECT_EQ(stat.packets, 0u);
+  EXPECT_EQ(stat.max_packets, 4u);
+  EXPECT_GT(stat.reader_waits, 0u);
+
+  ffmpeg_handler->ClearResources();
+  EXPECT_FALSE(ffmpeg_handler->GetReadAheadStat(&stat));
+
+  // one packet at a time when bounded by bytes only
+  param.erase("readahead_packets");
+  param["readahead_bytes"] = "1";
+  EXPECT_TRUE(src.Open(param));
+  ffmpeg_handler = std::make_shared<DataHandlerFFmpeg>(&src, std::to_string(0), mp4_path, 30, false);
+  EXPECT_TRUE(ffmpeg_handler->Open());
+  ffmpeg_handler->Close();
+  EXPECT_TRUE(ffmpeg_handler->PrepareResources());
+  for (uint32_t i = 0; i < 11; i++) {
+    EXPECT_TRUE(ffmpeg_handler->Process()) << i;
+  }
+  EXPECT_FALSE(ffmpeg_handler->Process());
+  EXPECT_TRUE(ffmpeg_handler->GetReadAheadStat(&stat));
+  EXPECT_EQ(stat.max_packets, 1u);
+  ffmpeg_handler->ClearResources();
+
+  // the reader reopens the file when loop is set to true, the decoder does not see it
+  ffmpeg_handler = std::make_shared<DataHandlerFFmpeg>(&src, std::to_string(0), mp4_path, 30, true);
+  EXPECT_TRUE(ffmpeg_handler->Open());
+  ffmpeg_handler->Close();
+  EXPECT_TRUE(ffmpeg_handler->PrepareResources());
+  for (uint32_t i = 0; i < 11 * 3; i++) {
+    EXPECT_TRUE(ffmpeg_handler->Process()) << i;
+  }
+  // stops the reader while it is reading
+  ffmpeg_handler->ClearResources();
+  EXPECT_FALSE(ffmpeg_handler->GetReadAheadStat(&stat));
+}
+
+TEST(SourceHandlerFFmpeg, LoopCache) {
+  DataSource src(gname);
+  std::string mp4_path = GetExePath() + "../../modules/unitest/source/data/cars_short.mp4";
+  ModuleParamSet param;
+  param["source_type"] = "ffmpeg";
+  param["output_type"] = "cpu";
+  param["decoder_type"] = "cpu";
+  param["loop_cache"] = "true";
+  EXPECT_TRUE(src.Open(param));
+
+  auto ffmpeg_handler = std::make_shared<DataHandlerFFmpeg>(&src, std::to_string(0), mp4_path, 30, true);
+  EXPECT_TRUE(ffmpeg_handler->Open());
+  ffmpeg_handler->Close();
+  EXPECT_TRUE(ffmpeg_handler->PrepareResources());
+  ASSERT_TRUE(ffmpeg_handler->cache_ != nullptr);
+  // cars.mp4 has 11 frames
+  EXPECT_EQ(ffmpeg_handler->cache_->Size(), 11u);
+  int64_t duration = ffmpeg_handler->cache_->GetDuration();
+  EXPECT_GT(duration, 0);
+
+  // the streams of the file share the packets
+  auto other_handler = std::make_shared<DataHandlerFFmpeg>(&src, std::to_string(1), mp4_path, 30, true);
+  EXPECT_TRUE(other_handler->Open());
+  other_handler->Close();
+  EXPECT_TRUE(other_handler->PrepareResources());
+  EXPECT_EQ(other_handler->cache_, ffmpeg_handler->cache_);
+  other_handler->ClearResources();
+
+  // the timestamps of a replay follow the ones of the replay before
+  std::vector<int64_t> pts;
+  for (uint32_t i = 0; i < 11 * 3; i++) {
+    ASSERT_TRUE(ffmpeg_handler->Extract()) << i;
+    pts.push_back(ffmpeg_handler->packet_.pts);
+    av_packet_unref(&ffmpeg_handler->packet_);
+  }
+  for (uint32_t i = 11; i < pts.size(); i++) {
+    EXPECT_EQ(pts[i], pts[i - 11] + duration) << i;
+  }
+  EXPECT_GT(*std::min_element(pts.begin() + 11, pts.begin() + 22), *std::max_element(pts.begin(), pts.begin() + 11));
+
+  // decodes without reopening the file
+  for (uint32_t i = 0; i < 11 * 3; i++) {
+    EXPECT_TRUE(ffmpeg_handler->Process()) << i;
+  }
+  EXPECT_EQ(ffmpeg_handler->cache_replay_, 5u);
+  EXPECT_EQ(PacketCache::CachedFileNumber(), 1u);
+  ffmpeg_handler->ClearResources();
+  EXPECT_TRUE(ffmpeg_handler->cache_ == nullptr);
+  // the file is dropped with the last stream
+  EXPECT_EQ(PacketCache::CachedFileNumber(), 0u);
+
+  // not cached without loop
+  ffmpeg_handler = std::make_shared<DataHandlerFFmpeg>(&src, std::to_string(0), mp4_path, 30, false);
+  EXPECT_TRUE(ffmpeg_handler->Open());
+  ffmpeg_handler->Close();
+  EXPECT_TRUE(ffmpeg_handler->PrepareResources());
+  EXPECT_TRUE(ffmpeg_handler->cache_ == nullptr);
+  ffmpeg_handler->ClearResources();
+}
+
 TEST(SourceHandlerRaw, PrepareResources) {
   DataSource src(gname);
   std::string h264_path = GetExePath() + "../../modules/unitest/source/data/raw.h264";
@@ -340,7 +583,7 @@ TEST(SourceHandlerRaw, PrepareResources) {
 
   raw_handler->ClearResources();
 
-  // no chunk size
+  // frame mode without mlu decoder
   raw_handler = std::make_shared<DataHandlerRaw>(&src, std::to_string(0), h264_path, 30, false);
   EXPECT_FALSE(raw_handler->PrepareResources());
 
@@ -385,11 +628,24 @@ TEST(SourceHandlerRaw, PrepareResources) {
   EXPECT_TRUE(raw_handler->PrepareResources());
   raw_handler->ClearResources();
 
-  // only support file with extension .h264 .264 and .h265
+  // only support H264 and H265 Annex-B streams
   raw_handler = std::make_shared<DataHandlerRaw>(&src, std::to_string(0), mp4_path, 30, false);
   EXPECT_FALSE(raw_handler->PrepareResources());
 
   raw_handler->ClearResources();
+
+  // frame mode
+  param["chunk_size"] = "0";
+  EXPECT_TRUE(src.Open(param));
+  EXPECT_TRUE(raw_handler->Open());
+  raw_handler->Close();
+  EXPECT_FALSE(raw_handler->PrepareResources());
+  raw_handler->ClearResources();
+  raw_handler = std::make_shared<DataHandlerRaw>(&src, std::to_string(0), h265_path, 30, false);
+  EXPECT_TRUE(raw_handler->Open());
+  raw_handler->Close();
+  EXPECT_TRUE(raw_handler->PrepareResources());
+  raw_handler->ClearResources();
 }
 
 TEST(SourceHandlerRaw, Extract) {
@@ -421,6 +677,88 @@ TEST(SourceHandlerRaw, Extract) {
   raw_handler->ClearResources();
 }
 
+TEST(SourceHandlerRaw, ExtractFrame) {
+  DataSource src(gname);
+  ModuleParamSet param;
+  param["source_type"] = "raw";
+  param["output_type"] = "mlu";
+  param["decoder_type"] = "mlu";
+  param["device_id"] = "0";
+  // frame mode
+  param["chunk_size"] = "0";
+  param["width"] = "256";
+  param["height"] = "256";
+  param["interlaced"] = "false";
+  EXPECT_TRUE(src.Open(param));
+
+  for (auto file : {"raw.h264", "raw.h265"}) {
+    std::string path = GetExePath() + "../../modules/unitest/source/data/" + file;
+    auto raw_handler = std::make_shared<DataHandlerRaw>(&src, std::to_string(0), path, 30, false);
+    EXPECT_TRUE(raw_handler->Open());
+    raw_handler->Close();
+    EXPECT_TRUE(raw_handler->PrepareResources());
+    // 5 access units, the first one is the key frame
+    size_t total = 0;
+    for (uint32_t i = 0; i < 5; i++) {
+      ASSERT_TRUE(raw_handler->Extract()) << file << " " << i;
+      EXPECT_EQ(raw_handler->packet_.pts, i);
+      EXPECT_EQ(raw_handler->packet_.flags, i == 0 ? RAW_PACKET_FLAG_KEY : 0u) << file << " " << i;
+      // whole access units with start codes
+      EXPECT_EQ(raw_handler->packet_.data[0], 0);
+      EXPECT_EQ(raw_handler->packet_.data[1], 0);
+      total += raw_handler->packet_.size;
+    }
+    EXPECT_FALSE(raw_handler->Extract());
+    struct stat file_stat;
+    ASSERT_EQ(stat(path.c_str(), &file_stat), 0);
+    EXPECT_EQ(total, static_cast<size_t>(file_stat.st_size));
+    raw_handler->ClearResources();
+  }
+}
+
+TEST(SourceHandlerRaw, AnnexBParser) {
+  // SPS, PPS, IDR with two slices, P, AUD and P with two slices, 4-byte and 3-byte start codes
+  const std::vector<uint8_t> h264 = {0xff, 0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x00, 0x00, 0x01, 0x68, 0xce,
+                                     0x38, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x00, 0x01, 0x65, 0x08, 0x84,
+                                     0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x21, 0x00, 0x00, 0x01, 0x09, 0x10, 0x00,
+                                     0x00, 0x00, 0x01, 0x41, 0x9a, 0x42, 0x00, 0x00, 0x01, 0x41, 0x1a, 0x42};
+  EXPECT_EQ(AnnexBParser::DetectCodec(h264.data(), h264.size()), AnnexBParser::CODEC_H264);
+  AnnexBParser parser(h264.data(), h264.size(), AnnexBParser::CODEC_H264);
+  std::vector<std::pair<size_t, bool>> expected = {{1, true}, {26, false}, {33, false}};
+  AnnexBParser::AccessUnit au;
+  for (int round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_TRUE(parser.Next(&au));
+      EXPECT_EQ(au.data, h264.data() + expected[i].first);
+      size_t end = i + 1 < expected.size() ? expected[i + 1].first : h264.size();
+      EXPECT_EQ(au.size, end - expected[i].first);
+      EXPECT_EQ(au.key, expected[i].second);
+    }
+    EXPECT_FALSE(parser.Next(&au));
+    parser.Reset();
+  }
+
+  // VPS, SPS, PPS, IDR_W_RADL, TRAIL_R
+  const std::vector<uint8_t> hevc = {0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01,
+                                     0x00, 0x00, 0x01, 0x44, 0x01, 0xc1, 0x00, 0x00, 0x01, 0x26, 0x01, 0xaf,
+                                     0x00, 0x00, 0x01, 0x02, 0x01, 0xd0};
+  EXPECT_EQ(AnnexBParser::DetectCodec(hevc.data(), hevc.size()), AnnexBParser::CODEC_HEVC);
+  parser = AnnexBParser(hevc.data(), hevc.size(), AnnexBParser::CODEC_HEVC);
+  ASSERT_TRUE(parser.Next(&au));
+  EXPECT_EQ(au.data, hevc.data());
+  EXPECT_EQ(au.size, 25u);
+  EXPECT_TRUE(au.key);
+  ASSERT_TRUE(parser.Next(&au));
+  EXPECT_EQ(au.size, 6u);
+  EXPECT_FALSE(au.key);
+  EXPECT_FALSE(parser.Next(&au));
+
+  // no parameter set
+  const std::vector<uint8_t> unknown = {0x00, 0x00, 0x01, 0x06, 0x05, 0x00, 0x00, 0x01, 0x41, 0x9a};
+  EXPECT_EQ(AnnexBParser::DetectCodec(unknown.data(), unknown.size()), AnnexBParser::CODEC_UNKNOWN);
+  EXPECT_EQ(AnnexBParser::DetectCodec(nullptr, 0), AnnexBParser::CODEC_UNKNOWN);
+}
+
 TEST(SourceHandlerRaw, Process) {
   int frame_rate = 30;
   DataSource src(gname);
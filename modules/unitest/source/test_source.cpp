@@ -99,6 +99,97 @@ TEST(Source, OpenClose) {
   param["reuse_cndex_buf"] = "false";
   ResetParam(param);
 
+  // invalid admission policy
+  param["admission_policy"] = "wait";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["admission_policy"] = "drop";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("admission_policy");
+
+  // invalid reuse_cpudec_buf
+  param["reuse_cpudec_buf"] = "yes";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  param["reuse_cpudec_buf"] = "true";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("reuse_cpudec_buf");
+
+  // invalid decode threads
+  param["decode_threads"] = "-1";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["decode_threads"] = "4";
+  param["decode_thread_type"] = "tile";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["decode_thread_type"] = "slice";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("decode_threads");
+  param.erase("decode_thread_type");
+
+  // invalid decode skip mode
+  param["decode_skip"] = "all";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["decode_skip"] = "nonkey";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("decode_skip");
+
+  // invalid worker number
+  param["worker_num"] = "-1";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["worker_num"] = "two";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  param["worker_num"] = "2";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("worker_num");
+
+  // invalid read-ahead bounds
+  param["readahead_packets"] = "-4";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["readahead_packets"] = "16";
+  param["readahead_bytes"] = "1MB";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  param["readahead_bytes"] = "1048576";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("readahead_packets");
+  param.erase("readahead_bytes");
+
+  // invalid loop cache
+  param["loop_cache"] = "yes";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  param["loop_cache"] = "true";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("loop_cache");
+
+  // invalid pacing
+  param["pacing"] = "slow";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["pacing"] = "pts";
+  param["speed"] = "0";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  EXPECT_FALSE(src->Open(param));
+  param["speed"] = "-1";
+  EXPECT_FALSE(src->CheckParamSet(param));
+  param["speed"] = "2";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("pacing");
+  param.erase("speed");
+
+  // invalid renditions
+  for (std::string renditions : {"small", "small:640", "small:640x360x2", ":640x360", "small:0x360", "small:641x360",
+                                 "small:640x360,small:320x180", "small:640X360"}) {
+    param["renditions"] = renditions;
+    EXPECT_FALSE(src->CheckParamSet(param)) << renditions;
+    EXPECT_FALSE(src->Open(param)) << renditions;
+  }
+  param["renditions"] = "analytics:640x360,preview:320x180";
+  EXPECT_TRUE(src->CheckParamSet(param));
+  param.erase("renditions");
+
   // raw decode without chunk params
   param.erase("chunk_size");
   EXPECT_FALSE(src->Open(param));
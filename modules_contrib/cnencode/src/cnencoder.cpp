@@ -62,6 +62,9 @@ CNEncoderContext *CNEncoder::GetCNEncoderContext(CNFrameInfoPtr data) {
         cn_format_ = CNEncoderStream::NV12;
         break;
       case cnstream::CNDataFormat::CN_PIXEL_FORMAT_YUV420_NV21:
+      case cnstream::CNDataFormat::CN_PIXEL_FORMAT_YUV420P:
+      case cnstream::CNDataFormat::CN_PIXEL_FORMAT_GRAY8:
+        // planar and luma only frames are packed to NV21 before encoding
         cn_format_ = CNEncoderStream::NV21;
         break;
       default:
@@ -159,11 +162,24 @@ int CNEncoder::Process(CNFrameInfoPtr data) {
   } else if (pre_type_ == "mlu") {
     uint8_t *image_data = nullptr;
     if (!eos) {
-      image_data = new uint8_t[data->frame.GetBytes()];
+      const size_t y_size = data->frame.GetPlaneBytes(0);
+      image_data = new uint8_t[y_size * 3 / 2];
       uint8_t *plane_0 = reinterpret_cast<uint8_t *>(data->frame.data[0]->GetMutableCpuData());
-      uint8_t *plane_1 = reinterpret_cast<uint8_t *>(data->frame.data[1]->GetMutableCpuData());
-      memcpy(image_data, plane_0, data->frame.GetPlaneBytes(0) * sizeof(uint8_t));
-      memcpy(image_data + data->frame.GetPlaneBytes(0), plane_1, data->frame.GetPlaneBytes(1) * sizeof(uint8_t));
+      memcpy(image_data, plane_0, y_size * sizeof(uint8_t));
+      uint8_t *vu = image_data + y_size;
+      if (data->frame.fmt == CNDataFormat::CN_PIXEL_FORMAT_YUV420P) {
+        const uint8_t *u = reinterpret_cast<const uint8_t *>(data->frame.data[1]->GetCpuData());
+        const uint8_t *v = reinterpret_cast<const uint8_t *>(data->frame.data[2]->GetCpuData());
+        for (size_t i = 0; i < y_size / 4; ++i) {
+          *vu++ = v[i];
+          *vu++ = u[i];
+        }
+      } else if (data->frame.fmt == CNDataFormat::CN_PIXEL_FORMAT_GRAY8) {
+        memset(vu, 128, y_size / 2);
+      } else {
+        uint8_t *plane_1 = reinterpret_cast<uint8_t *>(data->frame.data[1]->GetMutableCpuData());
+        memcpy(vu, plane_1, data->frame.GetPlaneBytes(1) * sizeof(uint8_t));
+      }
       data->frame.deAllocator_.reset();
     }
     ctx->stream_->Update(image_data, data->frame.timestamp, eos);
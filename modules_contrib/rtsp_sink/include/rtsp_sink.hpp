@@ -75,6 +75,7 @@ class RtspSink : public Module, public ModuleCreator<RtspSink> {
   * @param paramSet :
   @verbatim
      dump_dir: ouput_dir
+     rendition: optional, the name of the frame rendition to deliver, see CNFrameInfo::GetRendition
   @endverbatim
   *
   * @return if module open succeed
@@ -122,6 +123,7 @@ class RtspSink : public Module, public ModuleCreator<RtspSink> {
   bool is_mosaic_style_ = false;
   float frame_rate_ = 0;
   std::string enc_type;
+  std::string rendition_;
   RTSPSinkJoinStream::PictureFormat format_;
   std::unordered_map<int, RtspSinkContext*> ctxs_;
 };  // class RtspSink
@@ -35,6 +35,7 @@ RtspSink::RtspSink(const std::string &name) : Module(name) {
   param_register_.Register("cols", "Video width.");
   param_register_.Register("rows", "Video height.");
   param_register_.Register("device_id", "Which device will be used. If there is only one device, it might be 0.");
+  param_register_.Register("rendition", "Name of the frame rendition to use (default: full frame).");
   // hasTransmit_.store(1);  // for receive eos
 }
 
@@ -68,7 +69,9 @@ RtspSinkContext *RtspSink::GetRtspSinkContext(CNFrameInfoPtr data) {
       ctx = new RtspSinkContext;
       ctx->stream_ = new RTSPSinkJoinStream;
 
-      if (!ctx->stream_->Open(data->frame.width, data->frame.height, format_, frame_rate_ /* 30000.0f / 1001 */,
+      // the stream is encoded at the size of the delivered rendition
+      cnstream::CNDataFrame *frame = data->GetRendition(rendition_);
+      if (!ctx->stream_->Open(frame->width, frame->height, format_, frame_rate_ /* 30000.0f / 1001 */,
                               udp_port_ + data->channel_idx, http_port_, -1, -1, device_id_,
                               enc_type == "mlu" ? RTSPSinkJoinStream::MLU : RTSPSinkJoinStream::FFMPEG)) {
         LOG(ERROR) << "[RTSPSink] Invalid parameter";
@@ -110,6 +113,11 @@ bool RtspSink::Open(ModuleParamSet paramSet) {
     device_id_ = std::stoi(paramSet["device_id"]);
   }
 
+  rendition_.clear();
+  if (paramSet.find("rendition") != paramSet.end()) {
+    rendition_ = paramSet["rendition"];
+  }
+
   format_ = RTSPSinkJoinStream::NV21;  // BGR24
 
   return true;
@@ -130,7 +138,7 @@ void RtspSink::Close() {
 int RtspSink::Process(CNFrameInfoPtr data) {
   // bool eos = data->frame.flags & CNFrameFlag::CN_FRAME_FLAG_EOS;
   RtspSinkContext *ctx = GetRtspSinkContext(data);
-  cv::Mat image = *data->frame.ImageBGR();
+  cv::Mat image = *data->GetRendition(rendition_)->ImageBGR();
   if (is_mosaic_style_) {
     ctx->stream_->Update(image, data->frame.timestamp, data->channel_idx);
   } else {
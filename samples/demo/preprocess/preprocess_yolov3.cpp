@@ -37,26 +37,27 @@ class PreprocYolov3 : public cnstream::Preproc {
       return -1;
     }
 
-    int width = package->frame.width;
-    int height = package->frame.height;
+    cnstream::CNDataFrame* frame = package->GetRendition(GetRenditionName());
+    int width = frame->width;
+    int height = frame->height;
     int dst_w = input_shapes[0].w;
     int dst_h = input_shapes[0].h;
 
-    uint8_t* img_data = new(std::nothrow) uint8_t[package->frame.GetBytes()];
+    uint8_t* img_data = new(std::nothrow) uint8_t[frame->GetBytes()];
     if (!img_data) {
-      LOG(ERROR) << "Failed to alloc memory, size:" << package->frame.GetBytes();
+      LOG(ERROR) << "Failed to alloc memory, size:" << frame->GetBytes();
       return -1;
     }
     uint8_t* t = img_data;
 
-    for (int i = 0; i < package->frame.GetPlanes(); ++i) {
-      memcpy(t, package->frame.data[i]->GetCpuData(), package->frame.GetPlaneBytes(i));
-      t += package->frame.GetPlaneBytes(i);
+    for (int i = 0; i < frame->GetPlanes(); ++i) {
+      memcpy(t, frame->data[i]->GetCpuData(), frame->GetPlaneBytes(i));
+      t += frame->GetPlaneBytes(i);
     }
 
     // convert color space
     cv::Mat img;
-    switch (package->frame.fmt) {
+    switch (frame->fmt) {
       case cnstream::CNDataFormat::CN_PIXEL_FORMAT_BGR24:
         img = cv::Mat(height, width, CV_8UC3, img_data);
         break;
@@ -76,6 +77,18 @@ class PreprocYolov3 : public cnstream::Preproc {
         cv::cvtColor(img, bgr, cv::COLOR_YUV2BGR_NV21);
         img = bgr;
       } break;
+      case cnstream::CNDataFormat::CN_PIXEL_FORMAT_YUV420P: {
+        img = cv::Mat(height * 3 / 2, width, CV_8UC1, img_data);
+        cv::Mat bgr(height, width, CV_8UC3);
+        cv::cvtColor(img, bgr, cv::COLOR_YUV2BGR_I420);
+        img = bgr;
+      } break;
+      case cnstream::CNDataFormat::CN_PIXEL_FORMAT_GRAY8: {
+        img = cv::Mat(height, width, CV_8UC1, img_data);
+        cv::Mat bgr(height, width, CV_8UC3);
+        cv::cvtColor(img, bgr, cv::COLOR_GRAY2BGR);
+        img = bgr;
+      } break;
       default:
         LOG(WARNING) << "[Encoder] Unsupport pixel format.";
         delete[] img_data;